@@ -0,0 +1,138 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+  Copyright (C) 2011,2012 Alexey Veretennikov (alexey dot veretennikov at gmail.com)
+
+  This file is part of libspmatrix.
+
+  libspmatrix is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  libspmatrix is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with libspmatrix.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _SP_AMG_H_
+#define _SP_AMG_H_
+
+#include "sp_matrix.h"
+#include "sp_precond.h"
+
+/* Smoothers used in the V-cycle */
+typedef enum
+{
+  SP_AMG_JACOBI = 0,            /* damped Jacobi */
+  SP_AMG_GAUSS_SEIDEL,          /* forward Gauss-Seidel before the coarse
+                                 * correction, backward after it */
+  SP_AMG_CHEBYSHEV              /* Chebyshev polynomial, requires only
+                                 * matrix-vector products */
+} sp_amg_smoother_type;
+
+/*
+ * Parameters of the smoothed aggregation AMG
+ * Default values are set by sp_amg_params_init
+ */
+typedef struct
+{
+  double theta;                 /* strength of connection threshold */
+  double omega;                 /* damping factor of the Jacobi smoother */
+  sp_amg_smoother_type smoother;
+  int pre_sweeps;               /* smoothing sweeps before coarse
+                                 * correction */
+  int post_sweeps;              /* smoothing sweeps after coarse
+                                 * correction */
+  int degree;                   /* degree of the Chebyshev smoother */
+  int max_levels;               /* maximum number of levels */
+  int coarse_size;              /* stop coarsening when the level has
+                                 * less unknowns */
+  int block_size;               /* number of unknowns per node, i.e. 2 for
+                                 * the 2d elasticity; unknowns of the node
+                                 * shall be stored one after another */
+  int nullspace_size;           /* number of near-nullspace vectors */
+  double* nullspace;            /* near-nullspace vectors stored one after
+                                 * another, nullspace_size vectors of the
+                                 * size of the matrix; 0 means constant
+                                 * vectors for every unknown of the node.
+                                 * Not copied, shall be valid during
+                                 * the sp_amg_init */
+} sp_amg_params;
+typedef sp_amg_params* sp_amg_params_ptr;
+
+/* One level of the AMG hierarchy */
+typedef struct
+{
+  sp_matrix_yale A;             /* operator of the level in CRS format */
+  sp_matrix_yale P;             /* prolongator to this level from the next
+                                 * (coarser) one in CRS format */
+  sp_matrix_yale R;             /* restriction R = P^T in CRS format */
+  double* diag;                 /* diagonal of A */
+  double* b;                    /* right part of the level */
+  double* x;                    /* solution of the level */
+  double* r;                    /* residual of the level */
+  double rho;                   /* estimated spectral radius of D^{-1}*A,
+                                 * Chebyshev smoother only */
+  double* work;                 /* work vectors of the Chebyshev smoother */
+} sp_amg_level;
+
+/* Smoothed aggregation AMG hierarchy */
+typedef struct
+{
+  sp_amg_params params;
+  int levels_count;
+  sp_amg_level* levels;
+  int coarse_direct;            /* nonzero if the coarsest level is solved
+                                 * by Cholesky decomposition */
+  sp_matrix_yale coarse_L;      /* Cholesky factor of the coarsest level */
+} sp_amg;
+typedef sp_amg* sp_amg_ptr;
+
+/* Sets the default parameters of the AMG */
+void sp_amg_params_init(sp_amg_params_ptr self);
+
+/*
+ * Builds the smoothed aggregation AMG hierarchy for the
+ * symmetric positive-definite matrix A (CRS or CCS format)
+ * params - parameters of the hierarchy, 0 for default parameters
+ * Returns nonzero if successfull
+ */
+int sp_amg_init(sp_amg_ptr self,
+                sp_matrix_yale_ptr A,
+                sp_amg_params_ptr params);
+
+/* Free the AMG hierarchy */
+void sp_amg_free(sp_amg_ptr self);
+
+/*
+ * Applies one V-cycle with zero initial guess: x = M^{-1}*b
+ * b is not modified
+ */
+void sp_amg_vcycle(sp_amg_ptr self, double* b, double* x);
+
+/*
+ * Fills the rigid body modes used as the near-nullspace of the
+ * elasticity problems
+ * dim - dimension of the problem, 2 or 3
+ * nodes_count - number of nodes
+ * coords - coordinates of the nodes, dim values per node
+ * modes - output vectors, 3 (in 2d) or 6 (in 3d) vectors of the size
+ * dim*nodes_count stored one after another
+ * Returns number of modes, 0 if the dimension is not supported
+ */
+int sp_amg_rigid_body_modes(int dim,
+                            int nodes_count,
+                            double* coords,
+                            double* modes);
+
+/*
+ * Initializes the AMG preconditioner with given parameters,
+ * 0 for default parameters. Parameters are copied, the nullspace
+ * vectors shall be valid during the sp_precond_setup
+ */
+void sp_precond_amg_init(sp_precond_ptr self, sp_amg_params_ptr params);
+
+#endif /* _SP_AMG_H_ */
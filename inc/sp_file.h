@@ -20,21 +20,61 @@
 #ifndef _SP_FILE_H_
 #define _SP_FILE_H_
 
+#include <stdio.h>
+
 #include "sp_matrix.h"
+#include "sp_utils.h"
+#include "sp_direct.h"
 
 /*
  * Load the sparse martix from the file.
  * type = CRS or CCS - preferred storage type
  * Currently supported formats:
  * MM (Matrix Market) (*.mtx)
+ * 0-based triplets row, col, value (*.txt), sizes are determined
+ * by the maximum indicies
  * Harwell-Boeing format (*.hb, *.r[su]a)
- * if file is in Harwell-Boeing format, storage type is ignored
+ * native binary format (*.spb), compressed binary format (*.spz)
+ * if file is in Harwell-Boeing or binary format, storage type is ignored
  * Returns nonzero if successfull
  */
 int sp_matrix_yale_load_file(sp_matrix_yale_ptr self,
                              const char* filename,
                              sparse_storage_type type);
 
+/*
+ * Dense vectors coming with the matrix: right-hand sides, initial
+ * guesses and solutions. Every array contains count vectors of the
+ * size rows one after another (column-major rows x count) or is 0
+ * if absent
+ */
+typedef struct
+{
+  int rows;
+  int count;
+  double* rhs;
+  double* guess;
+  double* solution;
+} sp_matrix_vectors;
+typedef sp_matrix_vectors* sp_matrix_vectors_ptr;
+
+/*
+ * Load the sparse matrix together with its vectors, see
+ * sp_matrix_yale_load_file.
+ * Harwell-Boeing files: right-hand sides (full or sparse), initial
+ * guesses and solutions are decoded in the same pass as the matrix.
+ * MM files: right-hand sides and solutions are loaded from the
+ * companion files name_b.mtx and name_x.mtx if exist (array or
+ * coordinate format).
+ * Vectors are freed by sp_matrix_vectors_free
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_load_file_vectors(sp_matrix_yale_ptr self,
+                                     sp_matrix_vectors_ptr vectors,
+                                     const char* filename,
+                                     sparse_storage_type type);
+void sp_matrix_vectors_free(sp_matrix_vectors_ptr self);
+
 /*
  * Save the sparse martix from the file.
  * File format guessed from the extension
@@ -44,15 +84,84 @@ int sp_matrix_yale_load_file(sp_matrix_yale_ptr self,
  * txt, 0-based triplet format, each line is 0-based tripet:
  *  row, col, value
  * dat, octave triplet format(for CCS-stored matricies, converted otherwise)
+ * spb, native binary format: versioned header (storage type, sizes,
+ *  index and value sizes, matrix properties) followed by the offsets,
+ *  indicies and values arrays aligned to 64 bytes, native byte order
+ * spz, compressed binary format: delta-encoded varint indicies per line,
+ *  byte-shuffled values, blocks compressed with the built-in LZ codec
  * Returns 0 if not possible to write(or unknown file format)
  * Side-effect: matrix gets ordered
  */
 int sp_matrix_save_file(sp_matrix_ptr self, const char* filename);
 int sp_matrix_yale_save_file(sp_matrix_yale_ptr self, const char* filename);
 
+/*
+ * Save the sparse matrix with the known properties props
+ * (see sp_matrix_yale_properites) skipping their detection:
+ * symmetric and skew-symmetric matricies are written in MM format
+ * by the lower triangle. Numbers are formatted in parallel by the
+ * short representation reading back to the same values (sp_dtoa)
+ */
+int sp_matrix_yale_save_file_props(sp_matrix_yale_ptr self,
+                                   const char* filename,
+                                   matrix_properties props);
+
+/*
+ * Maps the binary (*.spb) matrix file into memory and points the
+ * arrays of the matrix to the mapped data without copying.
+ * The matrix is read-only and valid until sp_file_view_close(view);
+ * it shall not be freed with sp_matrix_yale_free.
+ * The header and offsets are always checked; indicies are checked
+ * only if validate is nonzero since it reads the whole array.
+ * Unvalidated mappings shall be trusted input: out of range indicies
+ * lead to out of bounds accesses in the matrix operations.
+ * Loading with sp_matrix_yale_load_file always validates
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_map_file(sp_matrix_yale_ptr self,
+                            sp_file_view_ptr view,
+                            int validate,
+                            const char* filename);
+
+/*
+ * Save and load the Cholesky symbolic analysis and the numeric factor L
+ * of the matrix A in the binary format with aligned arrays.
+ * The files keep the pattern hash of A (sp_matrix_yale_pattern_hash),
+ * loading fails if it doesn't match the given A.
+ * Loaded symbolic analysis is freed by sp_matrix_yale_symbolic_free,
+ * loaded L by sp_matrix_yale_free
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_symbolic_save(sp_chol_symbolic_ptr symb,
+                                 sp_matrix_yale_ptr A,
+                                 const char* filename);
+int sp_matrix_yale_symbolic_load(sp_chol_symbolic_ptr symb,
+                                 sp_matrix_yale_ptr A,
+                                 const char* filename);
+int sp_matrix_yale_chol_save(sp_matrix_yale_ptr L,
+                             sp_matrix_yale_ptr A,
+                             const char* filename);
+int sp_matrix_yale_chol_load(sp_matrix_yale_ptr L,
+                             sp_matrix_yale_ptr A,
+                             const char* filename);
+
+/*
+ * Maps the file with the factor L of A into memory without copying,
+ * see sp_matrix_yale_map_file for the validate flag; the pattern hash
+ * covers only A, not the factor itself.
+ * sp_matrix_yale_chol_load always validates
+ */
+int sp_matrix_yale_chol_map(sp_matrix_yale_ptr L,
+                            sp_file_view_ptr view,
+                            sp_matrix_yale_ptr A,
+                            int validate,
+                            const char* filename);
+
 /*
  * Save the vector of size `size` to the file `fname`
- * in order to read by octave, matlab or other tools
+ * in order to read by octave, matlab or other tools.
+ * Files with the extension .spv are written and read in the binary
+ * vector format with the checksum
  */
 void sp_save_int_vector(int* v, int size, const char* fname);
 void sp_save_double_vector(double* v, int size, const char* fname);
@@ -60,4 +169,118 @@ void sp_save_double_vector(double* v, int size, const char* fname);
 int sp_load_int_vector(int** v, int* size, const char* fname);
 int sp_load_double_vector(double** v, int* size, const char* fname);
 
+/* Element types of the binary vector files */
+typedef enum
+{
+  SP_VECTOR_INT = 1,
+  SP_VECTOR_DOUBLE = 2
+} sp_vector_type;
+
+/*
+ * Save count vectors of length elements of the given type stored one
+ * after another (column-major length x count block) to the binary
+ * vector file: header with the type, length and count followed by
+ * the data aligned to 64 bytes, native byte order.
+ * If checksum is nonzero FNV-1a hash of the data is stored
+ * Returns nonzero if successfull
+ */
+int sp_save_vectors(const void* data,
+                    sp_vector_type type,
+                    int length,
+                    int count,
+                    int checksum,
+                    const char* fname);
+
+/*
+ * Load the vectors from the binary vector file to the allocated
+ * array data, the checksum is verified if stored
+ * Returns nonzero if successfull
+ */
+int sp_load_vectors(void** data,
+                    sp_vector_type* type,
+                    int* length,
+                    int* count,
+                    const char* fname);
+
+/*
+ * Map the binary vector file into memory without copying, data points
+ * to the vectors until sp_file_view_close(view). The stored checksum is
+ * verified only if verify is nonzero since it reads all the data
+ * Returns nonzero if successfull
+ */
+int sp_map_vectors(const void** data,
+                   sp_file_view_ptr view,
+                   sp_vector_type* type,
+                   int* length,
+                   int* count,
+                   int verify,
+                   const char* fname);
+
+/* Element of the matrix assembled by sp_matrix_assembler */
+typedef struct
+{
+  int major;                    /* row for CRS, column for CCS */
+  int minor;
+  double value;
+} sp_assembly_element;
+
+/*
+ * File-backed assembly of the matricies larger than the memory.
+ * Elements are collected in the arena of the limited size; when it is
+ * full the elements are sorted and duplicates summed. If it is still
+ * more than half full the arena is spilled as a sorted run to the
+ * scratch file. Finishing maps the scratch file into memory, merges
+ * the runs line by line and writes the matrix to the binary (*.spb)
+ * file, which could be mapped by sp_matrix_yale_map_file
+ */
+typedef struct
+{
+  int rows_count;
+  int cols_count;
+  sparse_storage_type storage_type;
+  size_t capacity;              /* size of the arena in elements */
+  size_t count;                 /* elements in the arena */
+  sp_assembly_element* arena;
+  FILE* scratch;
+  char* scratch_name;
+  int runs_count;
+  size_t* runs;                 /* first elements of the runs in the
+                                 * scratch file, runs_count+1 */
+} sp_matrix_assembler;
+typedef sp_matrix_assembler* sp_matrix_assembler_ptr;
+
+/*
+ * Start the assembly of the rows x cols matrix of the storage type
+ * using at most memory bytes for the arena of the elements. The
+ * scratch file is not limited: it grows with the sorted runs up to
+ * the number of the added elements (without the summed duplicates)
+ * Returns nonzero if successfull
+ */
+int sp_matrix_assembler_init(sp_matrix_assembler_ptr self,
+                             int rows,
+                             int cols,
+                             sparse_storage_type type,
+                             size_t memory,
+                             const char* scratch);
+
+/*
+ * Add the value to the element (i,j), like sp_matrix_element_add
+ * Returns 0 if the arena could not be spilled
+ */
+int sp_matrix_assembler_add(sp_matrix_assembler_ptr self,
+                            int i,
+                            int j,
+                            double value);
+
+/*
+ * Merge the assembled elements to the binary matrix file filename,
+ * the assembler is freed and the scratch file removed
+ * Returns nonzero if successfull
+ */
+int sp_matrix_assembler_finish(sp_matrix_assembler_ptr self,
+                               const char* filename);
+
+/* Free the assembler without saving, the scratch file is removed */
+void sp_matrix_assembler_free(sp_matrix_assembler_ptr self);
+
 #endif /* _SP_FILE_H_ */
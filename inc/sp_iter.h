@@ -22,6 +22,15 @@
 #define _SP_ITER_H_
 
 #include "sp_matrix.h"
+#include "sp_precond.h"
+
+/*
+ * Linear operator hook for matrix-free solvers:
+ * calculates y = A*x
+ * state - operator-specific data passed to the solver
+ * x shall not be modified
+ */
+typedef void (*sp_operator_func)(void* state, double* x, double* y);
 
 /*
  * ILU decomposition of the sparse matrix in Skyline (CSLR) format
@@ -36,6 +45,28 @@ typedef struct
 } sp_matrix_skyline_ilu;
 typedef sp_matrix_skyline_ilu* sp_matrix_skyline_ilu_ptr;
 
+/*
+ * Level schedule of the triangular solves with factors of the
+ * ILU decomposition in Skyline format.
+ * Rows within one level are independent and processed in parallel;
+ * levels are processed one after another
+ */
+typedef struct
+{
+  sp_matrix_skyline_ilu_ptr ilu;
+  int lower_levels;             /* number of levels in L */
+  int* lower_offsets;           /* offsets of levels in lower_rows */
+  int* lower_rows;              /* rows of L ordered by levels */
+  int upper_levels;             /* number of levels in U */
+  int* upper_offsets;           /* offsets of levels in upper_rows */
+  int* upper_rows;              /* rows of U ordered by levels */
+  int* u_offsets;               /* U in row-wise (CRS) format */
+  int* u_indicies;              /* without the diagonal */
+  double* u_values;
+  double* temp;                 /* work vector */
+} sp_matrix_skyline_ilu_sched;
+typedef sp_matrix_skyline_ilu_sched* sp_matrix_skyline_ilu_sched_ptr;
+
 
 /*
  * Conjugate Gradient solver
@@ -55,6 +86,23 @@ void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
                              double* tolerance,
                              double* x);
 
+/*
+ * Conjugate Gradient solver estimating the extreme eigenvalues
+ * of the symmetric positive-definite matrix self at no extra cost
+ * from the CG coefficients (Lanczos connection)
+ * Arguments are the same as in sp_matrix_yale_solve_cg,
+ * lambda_min, lambda_max - output estimates of the smallest and largest
+ * eigenvalues, improving with the number of iterations
+ */
+void sp_matrix_yale_solve_cg_eigs(sp_matrix_yale_ptr self,
+                                  double* b,
+                                  double* x0,
+                                  int* max_iter,
+                                  double* tolerance,
+                                  double* x,
+                                  double* lambda_min,
+                                  double* lambda_max);
+
 /*
  * Preconditioned Conjugate Grade solver
  * Preconditioner in form of the ILU decomposition
@@ -75,6 +123,152 @@ void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
                                   double* tolerance,
                                   double* x);
 
+/*
+ * Preconditioned Conjugate Grade solver
+ * Preconditioner in form of the ILU decomposition applied with
+ * the level-scheduled (parallel) triangular solves
+ * self - matrix in Yale format
+ * sched - level schedule of the ILU decomposition
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_pcg_ilu_sched(sp_matrix_yale_ptr self,
+                                        sp_matrix_skyline_ilu_sched_ptr sched,
+                                        double* b,
+                                        double* x0,
+                                        int* max_iter,
+                                        double* tolerance,
+                                        double* x);
+
+/*
+ * Preconditioned Conjugate Grade solver
+ * Preconditioner in form of the incomplete Cholesky decomposition
+ * M = L*L^T, see sp_matrix_yale_ic0 and sp_matrix_yale_ict
+ * self - symmetric matrix in Yale format
+ * L - lower triangular factor in CCS format, diagonal first in columns
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_pcg_ic(sp_matrix_yale_ptr self,
+                                 sp_matrix_yale_ptr L,
+                                 double* b,
+                                 double* x0,
+                                 int* max_iter,
+                                 double* tolerance,
+                                 double* x);
+
+/*
+ * Preconditioned Conjugate Gradient solver
+ * with the generic preconditioner
+ * self - matrix in Yale format
+ * precond - symmetric positive-definite preconditioner,
+ * 0 if no preconditioner. sp_precond_setup shall be called before
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_pcg_precond(sp_matrix_yale_ptr self,
+                                      sp_precond_ptr precond,
+                                      double* b,
+                                      double* x0,
+                                      int* max_iter,
+                                      double* tolerance,
+                                      double* x);
+
+/*
+ * Preconditioned Conjugate Gradient solver estimating the extreme
+ * eigenvalues of the preconditioned matrix M^{-1}*A from the
+ * CG coefficients, see sp_matrix_yale_solve_cg_eigs
+ */
+void sp_matrix_yale_solve_pcg_eigs(sp_matrix_yale_ptr self,
+                                   sp_precond_ptr precond,
+                                   double* b,
+                                   double* x0,
+                                   int* max_iter,
+                                   double* tolerance,
+                                   double* x,
+                                   double* lambda_min,
+                                   double* lambda_max);
+
+/*
+ * Estimates the extreme eigenvalues of the symmetric matrix
+ * by steps of the Lanczos process without reorthogonalization.
+ * The largest eigenvalue converges fast, the smallest one is
+ * overestimated for the ill-conditioned matrices with few steps
+ * self - symmetric matrix A in Yale format
+ * diag - positive diagonal D of A to estimate the eigenvalues
+ * of D^{-1}*A, 0 to estimate the eigenvalues of A
+ * steps - number of Lanczos steps (matrix-vector products)
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_lanczos(sp_matrix_yale_ptr self,
+                           double* diag,
+                           int steps,
+                           double* lambda_min,
+                           double* lambda_max);
+
+/*
+ * Print the Lanczos estimate of the extreme eigenvalues and the
+ * condition number of the symmetric matrix to the stdout.
+ * Checks the symmetry and performs SP_SPECTRUM_LANCZOS_STEPS
+ * matrix-vector products
+ */
+#define SP_SPECTRUM_LANCZOS_STEPS 50
+void sp_matrix_yale_printf_spectrum(sp_matrix_yale_ptr self);
+
+/*
+ * Block Conjugate Gradient solver for k right-hand sides at once
+ * All active right-hand sides share one pass over the matrix per
+ * iteration; every column has its own CG recurrence and is deflated
+ * from the block as soon as it converges
+ * self - symmetric positive-definite matrix in Yale format
+ * k - number of right-hand sides
+ * b - right-part vectors, k vectors of the size rows_count stored one
+ * after another
+ * x0 - first approximations of the solutions, stored as b
+ * max_iter - array of k maximum numbers of iterations for every
+ * column; will contain numbers of iterations passed
+ * tolerance - array of k desired tolerance values;
+ * will contain norms of the residuals at the end of iteration
+ * x - output vectors, stored as b
+ */
+void sp_matrix_yale_solve_block_cg(sp_matrix_yale_ptr self,
+                                   int k,
+                                   double* b,
+                                   double* x0,
+                                   int* max_iter,
+                                   double* tolerance,
+                                   double* x);
+
+/*
+ * Block Preconditioned Conjugate Gradient solver for k right-hand
+ * sides, see sp_matrix_yale_solve_block_cg
+ * precond - symmetric positive-definite preconditioner applied to
+ * every active column, 0 if no preconditioner
+ */
+void sp_matrix_yale_solve_block_pcg(sp_matrix_yale_ptr self,
+                                    sp_precond_ptr precond,
+                                    int k,
+                                    double* b,
+                                    double* x0,
+                                    int* max_iter,
+                                    double* tolerance,
+                                    double* x);
+
 /*
  * Creates ILU decomposition of the sparse matrix 
  */
@@ -90,6 +284,22 @@ void sp_matrix_create_ilu(sp_matrix_ptr self,sp_matrix_skyline_ilu_ptr ilu);
 void sp_matrix_skyline_ilu_copy_init(sp_matrix_skyline_ilu_ptr self,
                                      sp_matrix_skyline_ptr parent);
 
+/*
+ * Create ILU decomposition of the sparse matrix in skyline format
+ * using the fixed-point iterations (Chow, Patel): every element of
+ * L and U is updated from the equations (L*U)_{ij} = A_{ij} on the
+ * portrait of A; rows are processed in parallel asynchronously.
+ * The first approximation is L = tril(A)*diag(A)^{-1}, U = triu(A)
+ * sweeps - number of the fixed-point sweeps, few sweeps usually
+ * give the preconditioner as good as the exact ILU(0).
+ * Without parallelization one sweep gives the exact ILU(0)
+ * Takes the ownership of the parent matrix as
+ * sp_matrix_skyline_ilu_copy_init does
+ */
+void sp_matrix_skyline_ilu_iter_init(sp_matrix_skyline_ilu_ptr self,
+                                     sp_matrix_skyline_ptr parent,
+                                     int sweeps);
+
 /* Free the sparse matrix skyline & ilu decomposition structure */
 void sp_matrix_skyline_ilu_free(sp_matrix_skyline_ilu_ptr self);
 
@@ -125,6 +335,28 @@ void sp_matrix_skyline_ilu_lower_solve(sp_matrix_skyline_ilu_ptr self,
 void sp_matrix_skyline_ilu_upper_solve(sp_matrix_skyline_ilu_ptr self,
                                        double* b,
                                        double* x);
+/*
+ * Creates the level schedule for the triangular solves by given
+ * ILU decomposition. The decomposition is not copied and shall not
+ * be freed while the schedule is in use
+ * Number of levels (the length of the critical path) is available
+ * in lower_levels and upper_levels fields
+ */
+void sp_matrix_skyline_ilu_sched_init(sp_matrix_skyline_ilu_sched_ptr self,
+                                      sp_matrix_skyline_ilu_ptr ilu);
+
+/* Free the level schedule structure */
+void sp_matrix_skyline_ilu_sched_free(sp_matrix_skyline_ilu_sched_ptr self);
+
+/*
+ * by given level schedule of the ILU decomposition
+ * Solves SLAE L*U*x = b
+ * b is not modified
+ */
+void sp_matrix_skyline_ilu_sched_solve(sp_matrix_skyline_ilu_sched_ptr self,
+                                       double* b,
+                                       double* x);
+
 /*
  * Transpose-Free Quasi-Minimal Residual solver
  * self - matrix in Yale format
@@ -143,6 +375,50 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
                                 double* tolerance,
                                 double* x);
 
+/*
+ * Preconditioned Transpose-Free Quasi-Minimal Residual solver
+ * Preconditioner in form of the incomplete LU decomposition
+ * (see sp_matrix_yale_iluk and sp_matrix_yale_ilut), applied from the right
+ * self - matrix in Yale format
+ * ilu - incomplete LU decomposition of self
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_tfqmr_ilu(sp_matrix_yale_ptr self,
+                                    sp_matrix_yale_ilu_ptr ilu,
+                                    double* b,
+                                    double* x0,
+                                    int* max_iter,
+                                    double* tolerance,
+                                    double* x);
+
+/*
+ * Preconditioned Transpose-Free QMR solver
+ * with the generic preconditioner
+ * self - matrix in Yale format
+ * precond - preconditioner applied from the right,
+ * 0 if no preconditioner. sp_precond_setup shall be called before
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_tfqmr_precond(sp_matrix_yale_ptr self,
+                                        sp_precond_ptr precond,
+                                        double* b,
+                                        double* x0,
+                                        int* max_iter,
+                                        double* tolerance,
+                                        double* x);
+
 /*
  * Conjugate Gradient Squared solver
  * self - matrix in Yale format
@@ -165,5 +441,203 @@ void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
                               double* tolerance,
                               double* x);
 
+/*
+ * Preconditioned Conjugate Gradient Squared solver
+ * Preconditioner in form of the incomplete LU decomposition,
+ * applied from the right
+ * self - matrix in Yale format
+ * ilu - incomplete LU decomposition of self
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_cgs_ilu(sp_matrix_yale_ptr self,
+                                  sp_matrix_yale_ilu_ptr ilu,
+                                  double* b,
+                                  double* x0,
+                                  int* max_iter,
+                                  double* tolerance,
+                                  double* x);
+
+/*
+ * Preconditioned Conjugate Gradient Squared solver
+ * with the generic preconditioner
+ * self - matrix in Yale format
+ * precond - preconditioner applied from the right,
+ * 0 if no preconditioner. sp_precond_setup shall be called before
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_cgs_precond(sp_matrix_yale_ptr self,
+                                      sp_precond_ptr precond,
+                                      double* b,
+                                      double* x0,
+                                      int* max_iter,
+                                      double* tolerance,
+                                      double* x);
+
+/*
+ * Biconjugate Gradient Stabilized solver
+ * self - matrix in Yale format
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_bicgstab(sp_matrix_yale_ptr self,
+                                   double* b,
+                                   double* x0,
+                                   int* max_iter,
+                                   double* tolerance,
+                                   double* x);
+
+/*
+ * Preconditioned Biconjugate Gradient Stabilized solver
+ * Preconditioner in form of the incomplete LU decomposition,
+ * applied from the right
+ * self - matrix in Yale format
+ * ilu - incomplete LU decomposition of self
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_bicgstab_ilu(sp_matrix_yale_ptr self,
+                                       sp_matrix_yale_ilu_ptr ilu,
+                                       double* b,
+                                       double* x0,
+                                       int* max_iter,
+                                       double* tolerance,
+                                       double* x);
+
+/*
+ * Biconjugate Gradient Stabilized solver with preconditioner hook
+ * self - matrix in Yale format
+ * precond - preconditioner applied from the right,
+ * 0 if no preconditioner
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration.
+ * Convergence is confirmed by the true residual norm(b-A*x)
+ * x - output vector
+ */
+void sp_matrix_yale_solve_bicgstab_precond(sp_matrix_yale_ptr self,
+                                           sp_precond_ptr precond,
+                                           double* b,
+                                           double* x0,
+                                           int* max_iter,
+                                           double* tolerance,
+                                           double* x);
+
+/*
+ * BiCGSTAB(l) solver: BiCGSTAB with l-degree minimal residual
+ * polynomials, more robust for matrices with complex spectrum
+ * self - matrix in Yale format
+ * l - degree of the polynomials, l = 1 is equivalent to BiCGSTAB;
+ * usually 2 or 4
+ * precond - preconditioner applied from the right,
+ * 0 if no preconditioner
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of BiCG steps, shall not be zero;
+ * will contain a number of steps passed (multiple of l)
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration.
+ * Convergence is confirmed by the true residual norm(b-A*x)
+ * x - output vector
+ */
+void sp_matrix_yale_solve_bicgstabl(sp_matrix_yale_ptr self,
+                                    int l,
+                                    sp_precond_ptr precond,
+                                    double* b,
+                                    double* x0,
+                                    int* max_iter,
+                                    double* tolerance,
+                                    double* x);
+
+/*
+ * Restarted Generalized Minimal Residual solver GMRES(m)
+ * self - matrix in Yale format
+ * m - restart parameter, dimension of the Krylov subspace
+ * precond - preconditioner applied from the right,
+ * 0 if no preconditioner
+ * b - right-part vector
+ * x0 - first approximation of the solution
+ * max_iter - pointer to maximum number of iterations, shall not be zero;
+ * will contain a number of iterations passed
+ * tolerance - pointer to desired tolerance value;
+ * will contain norm of the residual at the end of iteration
+ * x - output vector
+ */
+void sp_matrix_yale_solve_gmres(sp_matrix_yale_ptr self,
+                                int m,
+                                sp_precond_ptr precond,
+                                double* b,
+                                double* x0,
+                                int* max_iter,
+                                double* tolerance,
+                                double* x);
+
+/*
+ * Flexible GMRES(m) solver. Preconditioner may change from one
+ * iteration to another (for example an inner iterative solver).
+ * Stores m preconditioned vectors in addition to the Krylov basis.
+ * Arguments are the same as in sp_matrix_yale_solve_gmres
+ */
+void sp_matrix_yale_solve_fgmres(sp_matrix_yale_ptr self,
+                                 int m,
+                                 sp_precond_ptr precond,
+                                 double* b,
+                                 double* x0,
+                                 int* max_iter,
+                                 double* tolerance,
+                                 double* x);
+
+/*
+ * Matrix-free variants of GMRES(m) and FGMRES(m)
+ * n - size of the system
+ * op - operator function calculating y = A*x
+ * op_state - operator data passed to the op function
+ * Other arguments are the same as in sp_matrix_yale_solve_gmres
+ */
+void sp_operator_solve_gmres(int n,
+                             sp_operator_func op,
+                             void* op_state,
+                             int m,
+                             sp_precond_ptr precond,
+                             double* b,
+                             double* x0,
+                             int* max_iter,
+                             double* tolerance,
+                             double* x);
+
+void sp_operator_solve_fgmres(int n,
+                              sp_operator_func op,
+                              void* op_state,
+                              int m,
+                              sp_precond_ptr precond,
+                              double* b,
+                              double* x0,
+                              int* max_iter,
+                              double* tolerance,
+                              double* x);
 
 #endif /* _SP_ITER_H_ */
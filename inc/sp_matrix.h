@@ -21,6 +21,7 @@
 #ifndef __SP_MATRIX_H__
 #define __SP_MATRIX_H__
 
+#include <stdint.h>
 #include "sp_cont.h"
 
 typedef enum
@@ -29,6 +30,15 @@ typedef enum
   CCS = 1                       /* Compressed Column Storage */
 } sparse_storage_type;
 
+/* Storage layouts of the dense n x k multi-vectors */
+typedef enum
+{
+  SP_ROW_MAJOR = 0,             /* element (i,c) is X[i*k+c],
+                                 * vectors are interleaved */
+  SP_COL_MAJOR = 1              /* element (i,c) is X[c*n+i],
+                                 * vectors stored one after another */
+} sp_dense_layout;
+
 /* Constants for sp_matrix.ordered field */
 enum
 {
@@ -195,6 +205,25 @@ void sp_matrix_skyline_free(sp_matrix_skyline_ptr self);
 void sp_matrix_yale_init(sp_matrix_yale_ptr self,
                          sp_matrix_ptr mtx);
 
+/*
+ * Creates the sparse matrix in Yale format from the coordinate
+ * (triplet) form: element k is values[k] at (rows[k],cols[k]), 0-based.
+ * Triplets could be in any order, duplicates are summed, indicies
+ * in every row/column of the result are sorted.
+ * Uses counting sort: O(nonzeros + rows_count + cols_count),
+ * parallel for the large matrices
+ * type - storage type of the result, CRS or CCS
+ * Returns nonzero if successfull, 0 if some index is out of range
+ */
+int sp_matrix_yale_init_coo(sp_matrix_yale_ptr self,
+                            sparse_storage_type type,
+                            int rows_count,
+                            int cols_count,
+                            int nonzeros,
+                            const int* rows,
+                            const int* cols,
+                            const double* values);
+
                           
 /*
  * Copy sparse matrix from mtx_from to mtx_to
@@ -258,6 +287,19 @@ void sp_matrix_yale_mvsum(sp_matrix_yale_ptr self,
                           double* x2,
                           double* y);
 
+/*
+ * Sparse matrix - dense multi-vector multiplication Y = A*X
+ * Every element of the matrix is read once for all k vectors
+ * (once per SP_MM_BLOCK vectors for the large k)
+ * k - number of vectors
+ * layout - layout of both X (cols_count x k) and Y (rows_count x k)
+ */
+void sp_matrix_yale_mm(sp_matrix_yale_ptr self,
+                       int k,
+                       sp_dense_layout layout,
+                       double* X,
+                       double* Y);
+
 
 /*
  * Transposes the matrix in Yale format
@@ -280,6 +322,74 @@ int sp_matrix_yale_convert(sp_matrix_yale_ptr from,
 int sp_matrix_yale_convert_inplace(sp_matrix_yale_ptr self,
                                    sparse_storage_type type);
 
+/*
+ * Sparse matrix-matrix product C = A*B, symbolic part:
+ * calculates the portrait of C with sorted indicies, values are zero.
+ * C is in CCS format if both A and B are in CCS format, otherwise
+ * in CRS format.
+ * C shall be uninitialized
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_mult_symbolic(sp_matrix_yale_ptr A,
+                                 sp_matrix_yale_ptr B,
+                                 sp_matrix_yale_ptr C);
+
+/*
+ * Sparse matrix-matrix product C = A*B, numeric part:
+ * calculates the values of C by the portrait found by
+ * sp_matrix_yale_mult_symbolic. A and B shall have the same portraits
+ * as in the symbolic part, only values may differ.
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_mult_numeric(sp_matrix_yale_ptr A,
+                                sp_matrix_yale_ptr B,
+                                sp_matrix_yale_ptr C);
+
+/*
+ * Sparse matrix-matrix product C = A*B,
+ * symbolic and numeric parts together
+ * C shall be uninitialized
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_mult(sp_matrix_yale_ptr A,
+                        sp_matrix_yale_ptr B,
+                        sp_matrix_yale_ptr C);
+
+/*
+ * Sparse matrix sum C = alpha*A + beta*B
+ * Portrait of C is the union of portraits of A and B. Indicies
+ * of A and B shall be sorted, indicies of C are sorted.
+ * C has the storage type of A; B is converted if necessary.
+ * C shall be uninitialized
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_add(double alpha,
+                       sp_matrix_yale_ptr A,
+                       double beta,
+                       sp_matrix_yale_ptr B,
+                       sp_matrix_yale_ptr C);
+
+/*
+ * In-place sparse matrix sum A = alpha*A + beta*B
+ * Portrait of B shall be a subset of the portrait of A,
+ * both in the same storage type with sorted indicies
+ * Returns 0 if B has elements outside the portrait of A,
+ * values of A are undefined in this case
+ */
+int sp_matrix_yale_add_inplace(double alpha,
+                               sp_matrix_yale_ptr A,
+                               double beta,
+                               sp_matrix_yale_ptr B);
+
+/*
+ * Diagonal scaling of the matrix: A = diag(rows)*A*diag(cols)
+ * rows - row scaling factors, 0 if no row scaling
+ * cols - column scaling factors, 0 if no column scaling
+ */
+void sp_matrix_yale_scale(sp_matrix_yale_ptr self,
+                          double* rows,
+                          double* cols);
+
 /*
  * Calculates the permuted matrix C = P*A*Q
  * by given vector of inverse row permutation pinv:
@@ -295,6 +405,13 @@ int sp_matrix_yale_permute(sp_matrix_yale_ptr self,
 /* determines the matrix properties */
 matrix_properties sp_matrix_yale_properites(sp_matrix_yale_ptr self);
 
+/*
+ * 64-bit FNV-1a hash of the matrix portrait: storage type, sizes,
+ * offsets and indicies. Values are not hashed, so the hash identifies
+ * the matrices with the same symbolic factorization
+ */
+uint64_t sp_matrix_yale_pattern_hash(sp_matrix_yale_ptr self);
+
 /* compare 2 matricies in the same format */
 matrix_comparison sp_matrix_yale_cmp(sp_matrix_yale_ptr mtx1,
                                      sp_matrix_yale_ptr mtx2);
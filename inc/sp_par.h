@@ -0,0 +1,47 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+  Copyright (C) 2011,2012 Alexey Veretennikov (alexey dot veretennikov at gmail.com)
+
+  This file is part of libspmatrix.
+
+  libspmatrix is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  libspmatrix is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with libspmatrix.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _SP_PAR_H_
+#define _SP_PAR_H_
+
+/*
+ * Parallelization support. Library is built with OpenMP if the
+ * OPENMP variable is set in Makefile (or CONFIG_OPENMP in tup.config),
+ * otherwise all the pragmas below expand to nothing
+ */
+#ifdef _OPENMP
+#include <omp.h>
+#define SP_PRAGMA(x) _Pragma(#x)
+#define sp_par_max_threads() omp_get_max_threads()
+#define sp_par_thread_num() omp_get_thread_num()
+#else
+#define SP_PRAGMA(x)
+#define sp_par_max_threads() 1
+#define sp_par_thread_num() 0
+#endif
+
+/*
+ * Minimal size of the loop to be executed in parallel,
+ * for smaller loops the threading overhead is bigger than the gain
+ */
+#ifndef SP_PAR_MIN_SIZE
+#define SP_PAR_MIN_SIZE 4096
+#endif
+
+#endif /* _SP_PAR_H_ */
@@ -0,0 +1,263 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+  Copyright (C) 2011,2012 Alexey Veretennikov (alexey dot veretennikov at gmail.com)
+
+  This file is part of libspmatrix.
+
+  libspmatrix is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  libspmatrix is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with libspmatrix.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _SP_PRECOND_H_
+#define _SP_PRECOND_H_
+
+#include "sp_matrix.h"
+#include "sp_direct.h"
+
+/*
+ * Preconditioner hook used by the iterative solvers:
+ * calculates z = M^{-1}*r
+ * state - preconditioner-specific data passed to the solver
+ * r shall not be modified
+ */
+typedef void (*sp_precond_solve_func)(void* state, double* r, double* z);
+
+/*
+ * Preconditioner setup hook: builds the preconditioner for the matrix A
+ * Could be called several times with the different matrices of the
+ * same structure (reusing the state)
+ * Returns nonzero if successfull
+ */
+typedef int (*sp_precond_setup_func)(void* state, sp_matrix_yale_ptr A);
+
+/* Preconditioner hook freeing the state */
+typedef void (*sp_precond_free_func)(void* state);
+
+/*
+ * Generic preconditioner object accepted by all Krylov solvers
+ * setup - setup hook, 0 if no setup needed
+ * apply - z = M^{-1}*r
+ * free - hook to free the state, 0 if the state is owned by the caller
+ * state - opaque preconditioner data
+ */
+typedef struct
+{
+  sp_precond_setup_func setup;
+  sp_precond_solve_func apply;
+  sp_precond_free_func free;
+  void* state;
+} sp_precond;
+typedef sp_precond* sp_precond_ptr;
+
+/*
+ * Incomplete LU decomposition of the general sparse matrix
+ * L and U factors are stored together in one matrix in CRS format:
+ * every row contains strictly lower elements of L (unit diagonal of L
+ * is not stored), diagonal of U and strictly upper elements of U,
+ * with column indicies in ascending order
+ */
+typedef struct
+{
+  sp_matrix_yale lu;            /* L and U factors */
+  int* diag;                    /* positions of diagonal elements in lu */
+} sp_matrix_yale_ilu;
+typedef sp_matrix_yale_ilu* sp_matrix_yale_ilu_ptr;
+
+/*
+ * Incomplete Cholesky decomposition IC(0) of the symmetric
+ * positive-definite matrix self (CCS format, both triangles stored)
+ * L - output lower triangular matrix in CCS format with the same
+ * portrait as the lower triangle of self. Diagonal element is the first
+ * element of every column, so L could be used with
+ * sp_matrix_yale_lower_solve/sp_matrix_yale_lower_trans_solve
+ * Returns nonzero if successfull, 0 in case of breakdown
+ * (nonpositive pivot)
+ */
+int sp_matrix_yale_ic0(sp_matrix_yale_ptr self,
+                       sp_matrix_yale_ptr L);
+
+/*
+ * Threshold incomplete Cholesky decomposition ICT(droptol,fill)
+ * of the symmetric positive-definite matrix self (CCS format)
+ * symb - preliminary calculated symbolic Cholesky decomposition
+ * of self, its portrait of L is used as an upper bound for the
+ * portrait of the incomplete factor
+ * droptol - elements of the row k of L with absolute value less than
+ * droptol*norm2(A(:,k)) are dropped
+ * fill - maximum number of offdiagonal elements kept in every row of L,
+ * 0 means unlimited
+ * L - output lower triangular matrix in the same format as in
+ * sp_matrix_yale_ic0
+ * Returns nonzero if successfull, 0 in case of breakdown
+ */
+int sp_matrix_yale_ict(sp_matrix_yale_ptr self,
+                       sp_chol_symbolic_ptr symb,
+                       double droptol,
+                       int fill,
+                       sp_matrix_yale_ptr L);
+
+/*
+ * Incomplete LU decomposition ILU(k) with the symbolic level of fill
+ * self - matrix in Yale format (CRS or CCS)
+ * level - maximum level of fill, level 0 gives ILU(0) on the
+ * portrait of self
+ * ilu - output decomposition
+ * Returns nonzero if successfull, 0 in case of zero pivot
+ */
+int sp_matrix_yale_iluk(sp_matrix_yale_ptr self,
+                        int level,
+                        sp_matrix_yale_ilu_ptr ilu);
+
+/*
+ * Threshold incomplete LU decomposition ILUT(p,tau)
+ * self - matrix in Yale format (CRS or CCS)
+ * fill - maximum number of elements kept in L and U parts of every row
+ * except the diagonal, 0 means unlimited
+ * droptol - elements of the row i with absolute value less than
+ * droptol*norm2(A(i,:)) are dropped
+ * ilu - output decomposition
+ * Returns nonzero if successfull
+ */
+int sp_matrix_yale_ilut(sp_matrix_yale_ptr self,
+                        int fill,
+                        double droptol,
+                        sp_matrix_yale_ilu_ptr ilu);
+
+/*
+ * Solves the system L*U*x = b by given incomplete LU decomposition
+ * b is not modified
+ */
+void sp_matrix_yale_ilu_solve(sp_matrix_yale_ilu_ptr self,
+                              double* b,
+                              double* x);
+
+/* Free the incomplete LU decomposition structure */
+void sp_matrix_yale_ilu_free(sp_matrix_yale_ilu_ptr self);
+
+/*
+ * Interval [rho/CHEBYSHEV_RATIO, CHEBYSHEV_SAFETY*rho] of the spectrum of
+ * D^{-1}*A damped by the Chebyshev smoothers and preconditioners when
+ * only the estimated spectral radius rho is known
+ */
+#define CHEBYSHEV_RATIO 30.
+#define CHEBYSHEV_SAFETY 1.1
+
+/*
+ * Fills v of the size n with the fixed pseudo-random sequence in
+ * [-0.5,0.5] containing all the modes, used as a start vector
+ * of the spectrum estimations
+ */
+void sp_random_start_vector(double* v, int n);
+
+/*
+ * Estimates the spectral radius of D^{-1}*A by power iterations
+ * self - square matrix A in Yale format (CRS or CCS)
+ * diag - diagonal D of A, rows with zero diagonal are ignored
+ */
+double sp_matrix_yale_jacobi_radius(sp_matrix_yale_ptr self, double* diag);
+
+/*
+ * Chebyshev polynomial approximation of the solution of A*z = r:
+ * z = p(D^{-1}*A)*D^{-1}*r, where p is the Chebyshev polynomial of
+ * the degree degree-1 minimizing the residual on the interval
+ * [lambda_min,lambda_max] containing the spectrum of D^{-1}*A
+ * Requires only matrix-vector products, so parallelizes as well as
+ * sp_matrix_yale_mv
+ * self - square matrix A in Yale format (CRS is recommended)
+ * diag - diagonal D of A, rows with zero diagonal are ignored
+ * work - work array of the size 3*rows_count
+ * r is not modified
+ */
+void sp_matrix_yale_chebyshev(sp_matrix_yale_ptr self,
+                              double* diag,
+                              double lambda_min,
+                              double lambda_max,
+                              int degree,
+                              double* r,
+                              double* z,
+                              double* work);
+
+/*
+ * Initializes the generic preconditioner by the user-defined hooks
+ */
+void sp_precond_init(sp_precond_ptr self,
+                     sp_precond_setup_func setup,
+                     sp_precond_solve_func apply,
+                     sp_precond_free_func free,
+                     void* state);
+
+/*
+ * Initializes the ILU(k) preconditioner of the level level.
+ * sp_precond_setup shall be called before use
+ */
+void sp_precond_iluk_init(sp_precond_ptr self, int level);
+
+/*
+ * Initializes the IC(0) preconditioner, matrix shall be symmetric
+ * positive-definite in CCS format.
+ * sp_precond_setup shall be called before use
+ */
+void sp_precond_ic0_init(sp_precond_ptr self);
+
+/*
+ * Initializes the Jacobi (diagonal) preconditioner M = D
+ * sp_precond_setup shall be called before use
+ */
+void sp_precond_jacobi_init(sp_precond_ptr self);
+
+/*
+ * Initializes the block Jacobi preconditioner: M consists of the
+ * dense diagonal blocks of the size block_size, i.e. the blocks
+ * of the unknowns of one node. Unknowns of the node shall be stored one
+ * after another. sp_precond_setup shall be called before use and fails
+ * if any diagonal block is singular
+ */
+void sp_precond_block_jacobi_init(sp_precond_ptr self, int block_size);
+
+/*
+ * Initializes the SSOR preconditioner with the relaxation factor
+ * omega, 0 < omega < 2:
+ * M = (D/omega + L)*(D/omega)^{-1}*(D/omega + U)*omega/(2-omega)
+ * sp_precond_setup shall be called before use
+ */
+void sp_precond_ssor_init(sp_precond_ptr self, double omega);
+
+/*
+ * Initializes the Chebyshev polynomial preconditioner of the degree
+ * degree (number of matrix-vector products per application is
+ * degree-1), see sp_matrix_yale_chebyshev
+ * lambda_min, lambda_max - bounds of the spectrum of D^{-1}*A;
+ * if lambda_max <= 0 it is estimated by sp_matrix_yale_jacobi_radius
+ * during setup, if lambda_min <= 0 it is set to
+ * lambda_max/CHEBYSHEV_RATIO
+ * Resulting preconditioner is symmetric positive-definite for the
+ * symmetric positive-definite matrix and could be used with PCG
+ * sp_precond_setup shall be called before use
+ */
+void sp_precond_chebyshev_init(sp_precond_ptr self,
+                               int degree,
+                               double lambda_min,
+                               double lambda_max);
+
+/*
+ * Builds the preconditioner for the matrix A
+ * Returns nonzero if successfull
+ */
+int sp_precond_setup(sp_precond_ptr self, sp_matrix_yale_ptr A);
+
+/* Calculates z = M^{-1}*r */
+void sp_precond_apply(sp_precond_ptr self, double* r, double* z);
+
+/* Free the preconditioner state */
+void sp_precond_free(sp_precond_ptr self);
+
+#endif /* _SP_PRECOND_H_ */
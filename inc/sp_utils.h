@@ -22,6 +22,7 @@
 #define _SP_UTILS_H_
 
 #include <string.h>
+#include <stdint.h>
 #include <math.h>
 
 /*
@@ -109,6 +110,66 @@ const char* sp_extract_next_word(const char* line, const char** word);
  */
 char* sp_read_text_file(const char* filename);
 
+/*
+ * Read-only view of the whole file contents
+ */
+typedef struct
+{
+  const char* data;             /* contents, not 0-terminated if mapped */
+  size_t size;                  /* size of the contents in bytes */
+  int mapped;                   /* nonzero if the file is mapped into
+                                 * memory, otherwise data is allocated */
+} sp_file_view;
+typedef sp_file_view* sp_file_view_ptr;
+
+/*
+ * Opens the view of the file: maps the file into memory where supported
+ * (mmap), otherwise reads it by one block
+ * Returns nonzero if successfull
+ */
+int sp_file_view_open(sp_file_view_ptr self, const char* filename);
+
+/* Unmaps or frees the file contents */
+void sp_file_view_close(sp_file_view_ptr self);
+
+/*
+ * Fast parsers of the numbers in the buffer [ptr,end) without sscanf,
+ * the buffer shall not be 0-terminated
+ * Leading spaces and tabs are skipped, the number ends at any character
+ * which could not be part of it.
+ * sp_parse_double accepts also FORTRAN exponents (1.0D+01) and
+ * gives the correctly rounded result. Numbers up to 15 significant
+ * digits with small exponents are converted without strtod, others
+ * (including 16-17 digits full precision output) with strtod
+ * Return the pointer to the first character after the number
+ * or ptr if no number parsed
+ */
+const char* sp_parse_int(const char* ptr, const char* end, int* value);
+const char* sp_parse_double(const char* ptr, const char* end, double* value);
+
+
+/* Size of the buffer enough for any number written by sp_dtoa */
+#define SP_DTOA_SIZE 32
+
+/*
+ * Writes the decimal representation of the value which reads back
+ * (sp_parse_double, strtod) to exactly the same double, 0-terminated.
+ * Uses the Grisu2 algorithm without sprintf: the result is almost
+ * always the shortest one, but not guaranteed to be, e.g. 1e23 is
+ * written as 9.999999999999999e22
+ * Returns the number of characters written
+ */
+int sp_dtoa(double value, char* buffer);
+
+/* Writes the integer to the buffer, returns the number of characters */
+int sp_itoa(int value, char* buffer);
+
+/*
+ * 64-bit FNV-1a hash of size bytes of data continuing from hash;
+ * start with hash = SP_FNV_OFFSET_BASIS
+ */
+#define SP_FNV_OFFSET_BASIS 14695981039346656037ULL
+uint64_t sp_fnv1a(uint64_t hash, const void* data, size_t size);
 
 /* Extracts the integer of size bytes from the buffer from */
 int sp_extract_positional_int(const char* from, size_t size);
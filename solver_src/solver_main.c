@@ -30,6 +30,7 @@
 #include "sp_matrix.h"
 #include "sp_direct.h"
 #include "sp_iter.h"
+#include "sp_amg.h"
 #include "sp_file.h"
 
 
@@ -109,6 +110,8 @@ int main(int argc, char *argv[])
   sp_chol_symbolic symb;
   sp_matrix_skyline m;
   sp_matrix_skyline_ilu ILU;
+  sp_matrix_skyline_ilu_sched sched;
+  sp_precond amg;
   struct timespec t1,t2,t3;
   double* x, *b, *x0;
   double desired_tolerance[3] = {1e-7,1e-12,1e-15};
@@ -121,6 +124,8 @@ int main(int argc, char *argv[])
   {
     printf("Matrix %s statistics:\n",argv[1]);
     sp_matrix_yale_printf2(&mtx);
+    /* condition number estimate for the symmetric matricies */
+    sp_matrix_yale_printf_spectrum(&mtx);
     portable_gettime(&t1);
     if (!sp_matrix_yale_chol_symbolic(&mtx,&symb))
       printf("Unable to create symbolic Cholesky decomposition\n");
@@ -184,6 +189,9 @@ int main(int argc, char *argv[])
         portable_gettime(&t2);
         printf("ILU decomposition total creation time: ");
         print_time_difference(&t1,&t2);
+        sp_matrix_skyline_ilu_sched_init(&sched,&ILU);
+        printf("ILU level schedule: %d levels in L, %d levels in U\n",
+               sched.lower_levels,sched.upper_levels);
         for (i = 0; i < 3; ++ i)
         {
           tolerance = desired_tolerance[i];
@@ -202,6 +210,48 @@ int main(int argc, char *argv[])
           print_error(x0,x,mtx.rows_count);
         }
         for (i = 0; i < 3; ++ i)
+        {
+          tolerance = desired_tolerance[i];
+          iter = max_iter;
+          portable_gettime(&t1);
+          sp_matrix_yale_solve_pcg_ilu_sched(&mtx,&sched,b,b,&iter,&tolerance,x);
+          portable_gettime(&t2);
+          printf("Solving SLAE using level-scheduled PCG-ILU method");
+          printf(" with tolerance %e(iterations: %d) time: ",
+                 tolerance,iter);
+          print_time_difference(&t1,&t2);
+          printf("SLAE using level-scheduled PCG-ILU with tolerance");
+          printf(" %e(iterations: %d) max error: ",desired_tolerance[i],iter);
+          print_error(x0,x,mtx.rows_count);
+        }
+        /* CG with AMG preconditioner */
+        portable_gettime(&t1);
+        sp_precond_amg_init(&amg,0);
+        if (sp_precond_setup(&amg,&mtx))
+        {
+          portable_gettime(&t2);
+          printf("AMG hierarchy creation time: ");
+          print_time_difference(&t1,&t2);
+          for (i = 0; i < 3; ++ i)
+          {
+            tolerance = desired_tolerance[i];
+            iter = max_iter;
+            portable_gettime(&t1);
+            sp_matrix_yale_solve_pcg_precond(&mtx,&amg,b,b,
+                                             &iter,&tolerance,x);
+            portable_gettime(&t2);
+            printf("Solving SLAE using PCG-AMG method");
+            printf(" with tolerance %e(iterations: %d) time: ",
+                   tolerance,iter);
+            print_time_difference(&t1,&t2);
+            printf("SLAE using PCG-AMG with tolerance");
+            printf(" %e(iterations: %d) max error: ",
+                   desired_tolerance[i],iter);
+            print_error(x0,x,mtx.rows_count);
+          }
+        }
+        sp_precond_free(&amg);
+        for (i = 0; i < 3; ++ i)
         {
           tolerance = desired_tolerance[i];
           iter = max_iter;
@@ -237,6 +287,7 @@ int main(int argc, char *argv[])
         }
 
 
+        sp_matrix_skyline_ilu_sched_free(&sched);
         sp_matrix_skyline_ilu_free(&ILU);
         sp_matrix_yale_free(&L);
         free(x0);
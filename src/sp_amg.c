@@ -0,0 +1,778 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+  Copyright (C) 2011,2012 Alexey Veretennikov (alexey dot veretennikov at gmail.com)
+
+  This file is part of libspmatrix.
+
+  libspmatrix is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  libspmatrix is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with libspmatrix.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sp_amg.h"
+#include "sp_direct.h"
+#include "sp_mem.h"
+#include "sp_log.h"
+
+/*
+ * Smoothed aggregation algebraic multigrid
+ * Based on the article:
+ * Vanek P., Mandel J., Brezina M. Algebraic multigrid by smoothed
+ * aggregation for second and fourth order elliptic problems (1996)
+ */
+
+/*
+ * Number of symmetric Gauss-Seidel sweeps on the coarsest level
+ * if it could not be factorized
+ */
+#define COARSE_SWEEPS 20
+
+/* Relative tolerance of the linear dependency in the tentative QR */
+#define QR_DEPENDENCY_TOL 1e-10
+
+void sp_amg_params_init(sp_amg_params_ptr self)
+{
+  self->theta = 0.08;
+  self->omega = 2./3.;
+  self->smoother = SP_AMG_GAUSS_SEIDEL;
+  self->pre_sweeps = 1;
+  self->post_sweeps = 1;
+  self->degree = 3;
+  self->max_levels = 10;
+  self->coarse_size = 100;
+  self->block_size = 1;
+  self->nullspace_size = 0;
+  self->nullspace = 0;
+}
+
+/*
+ * Initializes the matrix in CRS format with given offsets,
+ * offsets array is owned by the matrix
+ */
+static void yale_crs_init(sp_matrix_yale_ptr self,
+                          int rows_count,
+                          int cols_count,
+                          int* offsets)
+{
+  self->storage_type = CRS;
+  self->rows_count = rows_count;
+  self->cols_count = cols_count;
+  self->offsets = offsets;
+  self->nonzeros = offsets[rows_count];
+  self->indicies = spcalloc(self->nonzeros,sizeof(int));
+  self->values = spcalloc(self->nonzeros,sizeof(double));
+}
+
+/*
+ * Inserts unit diagonal elements to the empty rows of the matrix.
+ * Empty rows of the coarse operator correspond to linearly dependent
+ * near-nullspace vectors on the aggregate
+ */
+static void ensure_diagonal(sp_matrix_yale_ptr self)
+{
+  int i,p,q,empty = 0;
+  int n = self->rows_count;
+  int* offsets;
+  int* indicies;
+  double* values;
+  for (i = 0; i < n; ++ i)
+    if (self->offsets[i] == self->offsets[i+1])
+      empty++;
+  if (!empty)
+    return;
+  offsets = spcalloc(n+1,sizeof(int));
+  indicies = spcalloc(self->nonzeros+empty,sizeof(int));
+  values = spcalloc(self->nonzeros+empty,sizeof(double));
+  for (i = 0, q = 0; i < n; ++ i)
+  {
+    offsets[i] = q;
+    if (self->offsets[i] == self->offsets[i+1])
+    {
+      indicies[q] = i;
+      values[q++] = 1;
+    }
+    for (p = self->offsets[i]; p < self->offsets[i+1]; ++ p, ++ q)
+    {
+      indicies[q] = self->indicies[p];
+      values[q] = self->values[p];
+    }
+  }
+  offsets[n] = q;
+  spfree(self->offsets);
+  spfree(self->indicies);
+  spfree(self->values);
+  self->offsets = offsets;
+  self->indicies = indicies;
+  self->values = values;
+  self->nonzeros = q;
+}
+
+/*
+ * Aggregation of the nodes of the matrix A with bs unknowns per node
+ * Nodes I and J are strongly connected if
+ * |A_IJ| >= theta*sqrt(|A_II|*|A_JJ|), where |A_IJ| is the Frobenius
+ * norm of the bs x bs block
+ * strong - output, nonzero for elements of A which belong to the
+ * diagonal block or to the block of strongly connected nodes
+ * aggregates - output, aggregate of every node or -1 for isolated nodes
+ * Returns number of aggregates
+ */
+static int aggregate(sp_matrix_yale_ptr A,
+                     int bs,
+                     double theta,
+                     char* strong,
+                     int* aggregates)
+{
+  int i,p,q,I,J,start,count,nagg = 0;
+  int N = A->rows_count/bs;
+  int* marker = spalloc((N+1)*sizeof(int));
+  int* node_offsets = spcalloc(N+1,sizeof(int));
+  int* node_indicies = spcalloc(A->nonzeros+1,sizeof(int));
+  double* node_values = spcalloc(A->nonzeros+1,sizeof(double));
+  double* diag = spcalloc(N+1,sizeof(double));
+  int joined;
+
+  for (J = 0; J < N; ++ J)
+    marker[J] = -1;
+  /* 1. amalgamated matrix of squared block norms */
+  count = 0;
+  for (I = 0; I < N; ++ I)
+  {
+    start = node_offsets[I] = count;
+    for (i = I*bs; i < (I+1)*bs; ++ i)
+      for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+      {
+        J = A->indicies[p]/bs;
+        if (marker[J] < start)
+        {
+          marker[J] = count;
+          node_indicies[count++] = J;
+        }
+        node_values[marker[J]] += A->values[p]*A->values[p];
+      }
+    node_offsets[I+1] = count;
+    if (marker[I] >= start)
+      diag[I] = sqrt(node_values[marker[I]]);
+  }
+  /* 2. strong connections, stored in place of the amalgamated matrix */
+  count = 0;
+  for (I = 0; I < N; ++ I)
+  {
+    start = count;
+    for (q = node_offsets[I]; q < node_offsets[I+1]; ++ q)
+    {
+      J = node_indicies[q];
+      if (J != I && sqrt(node_values[q]) >= theta*sqrt(diag[I]*diag[J]))
+        node_indicies[count++] = J;
+    }
+    node_offsets[I] = start;
+    /* mark strong neighbours to flag elements of A */
+    for (q = start; q < count; ++ q)
+      marker[node_indicies[q]] = -2 - I;
+    for (i = I*bs; i < (I+1)*bs; ++ i)
+      for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+      {
+        J = A->indicies[p]/bs;
+        strong[p] = J == I || marker[J] == -2 - I;
+      }
+  }
+  node_offsets[N] = count;
+
+  /* 3. aggregation; -1 for isolated nodes, -2 for not aggregated */
+  for (I = 0; I < N; ++ I)
+    aggregates[I] = node_offsets[I] == node_offsets[I+1] ? -1 : -2;
+  /* phase 1: nodes with all neighbours free form new aggregates */
+  for (I = 0; I < N; ++ I)
+  {
+    if (aggregates[I] != -2)
+      continue;
+    for (q = node_offsets[I]; q < node_offsets[I+1]; ++ q)
+      if (aggregates[node_indicies[q]] != -2)
+        break;
+    if (q < node_offsets[I+1])
+      continue;
+    aggregates[I] = nagg;
+    for (q = node_offsets[I]; q < node_offsets[I+1]; ++ q)
+      aggregates[node_indicies[q]] = nagg;
+    nagg++;
+  }
+  /*
+   * phase 2: remaining nodes join the aggregate of the neighbour
+   * aggregated on the phase 1; marked as -3-aggregate until the
+   * end of the phase
+   */
+  for (I = 0; I < N; ++ I)
+  {
+    if (aggregates[I] != -2)
+      continue;
+    for (q = node_offsets[I]; q < node_offsets[I+1]; ++ q)
+      if (aggregates[node_indicies[q]] >= 0)
+      {
+        aggregates[I] = -3 - aggregates[node_indicies[q]];
+        break;
+      }
+  }
+  for (I = 0; I < N; ++ I)
+    if (aggregates[I] <= -3)
+      aggregates[I] = -3 - aggregates[I];
+  /* phase 3: remaining nodes form aggregates with free neighbours */
+  for (I = 0; I < N; ++ I)
+  {
+    if (aggregates[I] != -2)
+      continue;
+    aggregates[I] = nagg;
+    joined = 0;
+    for (q = node_offsets[I]; q < node_offsets[I+1]; ++ q)
+      if (aggregates[node_indicies[q]] == -2)
+      {
+        aggregates[node_indicies[q]] = nagg;
+        joined = 1;
+      }
+    if (!joined)
+    {
+      /* join the neighbouring aggregate instead of the singleton */
+      for (q = node_offsets[I];
+           q < node_offsets[I+1] && aggregates[node_indicies[q]] < 0; ++ q);
+      if (q < node_offsets[I+1])
+      {
+        aggregates[I] = aggregates[node_indicies[q]];
+        continue;
+      }
+    }
+    nagg++;
+  }
+
+  spfree(marker);
+  spfree(node_offsets);
+  spfree(node_indicies);
+  spfree(node_values);
+  spfree(diag);
+  return nagg;
+}
+
+/*
+ * Tentative prolongator T: near-nullspace B (n x k, vectors stored
+ * one after another) restricted to every aggregate is decomposed as
+ * B_a = Q_a*R_a; Q_a forms the block of T, R_a forms the block of the
+ * coarse near-nullspace Bc (nagg*k x k). Columns of Q_a linearly
+ * dependent on previous ones are dropped from T
+ */
+static void tentative_prolongator(int n,
+                                  int bs,
+                                  int k,
+                                  double* B,
+                                  int nagg,
+                                  int* aggregates,
+                                  sp_matrix_yale_ptr T,
+                                  double* Bc)
+{
+  int i,a,c,d,p,t,I;
+  int N = n/bs;
+  int nc = nagg*k;
+  int* agg_offsets = spcalloc(nagg+1,sizeof(int));
+  int* agg_nodes = spcalloc(N+1,sizeof(int));
+  int* offsets = spcalloc(n+1,sizeof(int));
+  char* dependent = spcalloc(nc+1,sizeof(char));
+  double* Q = spcalloc((size_t)n*k+1,sizeof(double));
+  double r,norm0;
+
+  /* nodes of aggregates */
+  for (I = 0; I < N; ++ I)
+    if (aggregates[I] >= 0)
+      agg_offsets[aggregates[I]+1]++;
+  for (a = 0; a < nagg; ++ a)
+    agg_offsets[a+1] += agg_offsets[a];
+  for (I = 0; I < N; ++ I)
+    if (aggregates[I] >= 0)
+      agg_nodes[agg_offsets[aggregates[I]]++] = I;
+  for (a = nagg; a > 0; -- a)
+    agg_offsets[a] = agg_offsets[a-1];
+  agg_offsets[0] = 0;
+
+#define AGG_FOREACH_DOF(a)                                          \
+  for (p = agg_offsets[a]; p < agg_offsets[a+1]; ++ p)              \
+    for (t = 0, i = agg_nodes[p]*bs; t < bs; ++ t, ++ i)
+
+  /* modified Gram-Schmidt QR on every aggregate */
+  for (a = 0; a < nagg; ++ a)
+  {
+    AGG_FOREACH_DOF(a)
+      for (c = 0; c < k; ++ c)
+        Q[i*k+c] = B[(size_t)c*n+i];
+    for (c = 0; c < k; ++ c)
+    {
+      norm0 = 0;
+      AGG_FOREACH_DOF(a)
+        norm0 += Q[i*k+c]*Q[i*k+c];
+      for (d = 0; d < c; ++ d)
+      {
+        if (dependent[a*k+d])
+          continue;
+        r = 0;
+        AGG_FOREACH_DOF(a)
+          r += Q[i*k+d]*Q[i*k+c];
+        AGG_FOREACH_DOF(a)
+          Q[i*k+c] -= r*Q[i*k+d];
+        Bc[(size_t)c*nc+a*k+d] = r;
+      }
+      r = 0;
+      AGG_FOREACH_DOF(a)
+        r += Q[i*k+c]*Q[i*k+c];
+      r = sqrt(r);
+      if (r <= QR_DEPENDENCY_TOL*sqrt(norm0) || r == 0)
+      {
+        dependent[a*k+c] = 1;
+        r = 0;
+      }
+      else
+        AGG_FOREACH_DOF(a)
+          Q[i*k+c] /= r;
+      Bc[(size_t)c*nc+a*k+c] = r;
+    }
+  }
+#undef AGG_FOREACH_DOF
+
+  /* assemble T */
+  for (i = 0; i < n; ++ i)
+  {
+    offsets[i+1] = offsets[i];
+    if ((a = aggregates[i/bs]) >= 0)
+      for (c = 0; c < k; ++ c)
+        offsets[i+1] += !dependent[a*k+c];
+  }
+  yale_crs_init(T,n,nc,offsets);
+  for (i = 0; i < n; ++ i)
+  {
+    p = offsets[i];
+    if ((a = aggregates[i/bs]) >= 0)
+      for (c = 0; c < k; ++ c)
+        if (!dependent[a*k+c])
+        {
+          T->indicies[p] = a*k+c;
+          T->values[p++] = Q[i*k+c];
+        }
+  }
+  spfree(agg_offsets);
+  spfree(agg_nodes);
+  spfree(dependent);
+  spfree(Q);
+}
+
+/*
+ * Smoothed prolongator P = (I - omega*D^{-1}*A_F)*T
+ * with the filtered matrix A_F: weak connections of A are dropped
+ * and added to the diagonal; omega = 4/3/rho(D^{-1}*A_F)
+ */
+static void smooth_prolongator(sp_matrix_yale_ptr A,
+                               char* strong,
+                               sp_matrix_yale_ptr T,
+                               sp_matrix_yale_ptr P)
+{
+  int i,p,q;
+  int n = A->rows_count;
+  int* offsets = spcalloc(n+1,sizeof(int));
+  int* diag_pos = spcalloc(n,sizeof(int));
+  double* diag = spcalloc(n,sizeof(double));
+  double omega,rho;
+  sp_matrix_yale S;
+
+  /* filtered matrix */
+  for (i = 0; i < n; ++ i)
+  {
+    offsets[i+1] = offsets[i];
+    for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+      offsets[i+1] += strong[p] != 0;
+  }
+  yale_crs_init(&S,n,n,offsets);
+  for (i = 0; i < n; ++ i)
+  {
+    q = offsets[i];
+    diag_pos[i] = -1;
+    for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+      if (strong[p])
+      {
+        if (A->indicies[p] == i)
+          diag_pos[i] = q;
+        S.indicies[q] = A->indicies[p];
+        S.values[q++] = A->values[p];
+      }
+      else
+        diag[i] += A->values[p];
+    if (diag_pos[i] >= 0)
+    {
+      S.values[diag_pos[i]] += diag[i];
+      diag[i] = S.values[diag_pos[i]];
+    }
+    else
+      diag[i] = 0;
+  }
+  rho = sp_matrix_yale_jacobi_radius(&S,diag);
+  omega = rho > 0 ? 4./3./rho : 0;
+  /* S = I - omega*D^{-1}*A_F */
+  for (i = 0; i < n; ++ i)
+  {
+    for (p = offsets[i]; p < offsets[i+1]; ++ p)
+      S.values[p] = diag[i] != 0 ? -omega*S.values[p]/diag[i] : 0;
+    if (diag_pos[i] >= 0)
+      S.values[diag_pos[i]] += 1;
+  }
+  sp_matrix_yale_mult(&S,T,P);
+  sp_matrix_yale_free(&S);
+  spfree(diag_pos);
+  spfree(diag);
+}
+
+/*
+ * Allocates the work vectors and extracts the diagonal of the level,
+ * estimates the spectrum of D^{-1}*A for the Chebyshev smoother
+ */
+static void level_init(sp_amg_ptr self, sp_amg_level* level)
+{
+  int i,p;
+  int n = level->A.rows_count;
+  level->diag = spcalloc(n,sizeof(double));
+  level->b = spcalloc(n,sizeof(double));
+  level->x = spcalloc(n,sizeof(double));
+  level->r = spcalloc(n,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    for (p = level->A.offsets[i]; p < level->A.offsets[i+1]; ++ p)
+      if (level->A.indicies[p] == i)
+        level->diag[i] += level->A.values[p];
+  if (self->params.smoother == SP_AMG_CHEBYSHEV)
+  {
+    level->rho = sp_matrix_yale_jacobi_radius(&level->A,level->diag);
+    level->work = spcalloc(4*n+1,sizeof(double));
+  }
+}
+
+int sp_amg_init(sp_amg_ptr self,
+                sp_matrix_yale_ptr A,
+                sp_amg_params_ptr params)
+{
+  sp_amg_params defaults;
+  sp_matrix_yale T,AP,coarse;
+  sp_chol_symbolic symb;
+  sp_amg_level* level;
+  int i,c,n,k,bs,nagg,nc,max_levels;
+  char* strong;
+  int* aggregates;
+  double* B;
+  double* Bc;
+
+  if (!params)
+  {
+    sp_amg_params_init(&defaults);
+    params = &defaults;
+  }
+  memset(self,0,sizeof(sp_amg));
+  memcpy(&self->params,params,sizeof(sp_amg_params));
+  n = A->rows_count;
+  bs = params->block_size > 0 ? params->block_size : 1;
+  k = params->nullspace ? params->nullspace_size : bs;
+  if (A->rows_count != A->cols_count || n % bs || k <= 0)
+  {
+    LOGERROR("AMG: matrix %dx%d, block size %d, nullspace size %d "
+             "are not consistent",A->rows_count,A->cols_count,bs,k);
+    return 0;
+  }
+  max_levels = params->max_levels > 0 ? params->max_levels : 1;
+  self->levels = spcalloc(max_levels,sizeof(sp_amg_level));
+  if (!sp_matrix_yale_convert(A,&self->levels[0].A,CRS))
+    sp_matrix_yale_copy(A,&self->levels[0].A);
+  self->levels_count = 1;
+  /* near-nullspace of the finest level */
+  B = spcalloc((size_t)n*k,sizeof(double));
+  if (params->nullspace)
+    memcpy(B,params->nullspace,(size_t)n*k*sizeof(double));
+  else
+    for (c = 0; c < k; ++ c)
+      for (i = c; i < n; i += bs)
+        B[(size_t)c*n+i] = 1;
+
+  while (self->levels_count < max_levels && n > params->coarse_size)
+  {
+    level = self->levels + self->levels_count - 1;
+    strong = spcalloc(level->A.nonzeros+1,sizeof(char));
+    aggregates = spcalloc(n/bs+1,sizeof(int));
+    nagg = aggregate(&level->A,bs,params->theta,strong,aggregates);
+    nc = nagg*k;
+    if (nagg == 0 || nc >= n)
+    {
+      spfree(strong);
+      spfree(aggregates);
+      break;
+    }
+    Bc = spcalloc((size_t)nc*k,sizeof(double));
+    tentative_prolongator(n,bs,k,B,nagg,aggregates,&T,Bc);
+    smooth_prolongator(&level->A,strong,&T,&level->P);
+    sp_matrix_yale_free(&T);
+    /* Galerkin coarse operator R*A*P */
+    sp_matrix_yale_transpose(&level->P,&level->R);
+    sp_matrix_yale_mult(&level->A,&level->P,&AP);
+    sp_matrix_yale_mult(&level->R,&AP,&self->levels[self->levels_count].A);
+    sp_matrix_yale_free(&AP);
+    ensure_diagonal(&self->levels[self->levels_count].A);
+    LOGINFO("AMG level %d: %d unknowns, %d aggregates",
+            self->levels_count-1,n,nagg);
+    spfree(strong);
+    spfree(aggregates);
+    spfree(B);
+    B = Bc;
+    n = nc;
+    bs = k;
+    self->levels_count++;
+  }
+  spfree(B);
+  for (i = 0; i < self->levels_count; ++ i)
+    level_init(self,self->levels+i);
+
+  /* direct solver on the coarsest level */
+  level = self->levels + self->levels_count - 1;
+  sp_matrix_yale_transpose(&level->A,&coarse);
+  coarse.storage_type = CCS;
+  if (sp_matrix_yale_chol_symbolic(&coarse,&symb))
+  {
+    self->coarse_direct = sp_matrix_yale_chol_numeric(&coarse,&symb,
+                                                      &self->coarse_L);
+    sp_matrix_yale_symbolic_free(&symb);
+  }
+  if (!self->coarse_direct)
+    LOGWARN("AMG: coarse level %d x %d is not factorized, "
+            "using Gauss-Seidel sweeps",n,n);
+  sp_matrix_yale_free(&coarse);
+  return 1;
+}
+
+void sp_amg_free(sp_amg_ptr self)
+{
+  int i;
+  sp_amg_level* level;
+  for (i = 0; i < self->levels_count; ++ i)
+  {
+    level = self->levels + i;
+    sp_matrix_yale_free(&level->A);
+    if (i < self->levels_count - 1)
+    {
+      sp_matrix_yale_free(&level->P);
+      sp_matrix_yale_free(&level->R);
+    }
+    spfree(level->diag);
+    spfree(level->b);
+    spfree(level->x);
+    spfree(level->r);
+    if (level->work)
+      spfree(level->work);
+  }
+  if (self->coarse_direct)
+    sp_matrix_yale_free(&self->coarse_L);
+  if (self->levels)
+    spfree(self->levels);
+  memset(self,0,sizeof(sp_amg));
+}
+
+/* r = b - A*x */
+static void level_residual(sp_amg_level* level, double* b, double* x)
+{
+  int i;
+  int n = level->A.rows_count;
+  sp_matrix_yale_mv(&level->A,x,level->r);
+  for (i = 0; i < n; ++ i)
+    level->r[i] = b[i] - level->r[i];
+}
+
+/* Gauss-Seidel sweep, forward if forward is nonzero */
+static void gauss_seidel(sp_amg_level* level,
+                         double* b,
+                         double* x,
+                         int forward)
+{
+  int i,p;
+  int n = level->A.rows_count;
+  int* offsets = level->A.offsets;
+  int* indicies = level->A.indicies;
+  double* values = level->A.values;
+  double sum;
+  for (i = forward ? 0 : n - 1; i >= 0 && i < n; i += forward ? 1 : -1)
+  {
+    if (level->diag[i] == 0)
+      continue;
+    sum = b[i];
+    for (p = offsets[i]; p < offsets[i+1]; ++ p)
+      if (indicies[p] != i)
+        sum -= values[p]*x[indicies[p]];
+    x[i] = sum/level->diag[i];
+  }
+}
+
+static void smooth(sp_amg_ptr self,
+                   sp_amg_level* level,
+                   double* b,
+                   double* x,
+                   int sweeps,
+                   int forward)
+{
+  int i,j;
+  int n = level->A.rows_count;
+  for (j = 0; j < sweeps; ++ j)
+  {
+    if (self->params.smoother == SP_AMG_GAUSS_SEIDEL)
+      gauss_seidel(level,b,x,forward);
+    else if (self->params.smoother == SP_AMG_CHEBYSHEV)
+    {
+      /* x = x + p(D^{-1}*A)*D^{-1}*(b - A*x) */
+      level_residual(level,b,x);
+      sp_matrix_yale_chebyshev(&level->A,level->diag,
+                               level->rho/CHEBYSHEV_RATIO,
+                               CHEBYSHEV_SAFETY*level->rho,
+                               self->params.degree,
+                               level->r,level->work,level->work+n);
+      for (i = 0; i < n; ++ i)
+        x[i] += level->work[i];
+    }
+    else
+    {
+      level_residual(level,b,x);
+      for (i = 0; i < n; ++ i)
+        if (level->diag[i] != 0)
+          x[i] += self->params.omega*level->r[i]/level->diag[i];
+    }
+  }
+}
+
+static void vcycle(sp_amg_ptr self, int l, double* b, double* x)
+{
+  int i,j;
+  sp_amg_level* level = self->levels + l;
+  sp_amg_level* next;
+  int n = level->A.rows_count;
+
+  memset(x,0,n*sizeof(double));
+  if (l == self->levels_count - 1)
+  {
+    /* coarsest level */
+    if (self->coarse_direct)
+      sp_matrix_yale_chol_numeric_solve(&self->coarse_L,b,x);
+    else
+      for (j = 0; j < COARSE_SWEEPS; ++ j)
+      {
+        gauss_seidel(level,b,x,1);
+        gauss_seidel(level,b,x,0);
+      }
+    return;
+  }
+  next = self->levels + l + 1;
+  /* presmoothing */
+  smooth(self,level,b,x,self->params.pre_sweeps,1);
+  /* restriction of the residual */
+  level_residual(level,b,x);
+  sp_matrix_yale_mv(&level->R,level->r,next->b);
+  /* coarse correction */
+  vcycle(self,l+1,next->b,next->x);
+  sp_matrix_yale_mv(&level->P,next->x,level->r);
+  for (i = 0; i < n; ++ i)
+    x[i] += level->r[i];
+  /* postsmoothing */
+  smooth(self,level,b,x,self->params.post_sweeps,0);
+}
+
+void sp_amg_vcycle(sp_amg_ptr self, double* b, double* x)
+{
+  vcycle(self,0,b,x);
+}
+
+int sp_amg_rigid_body_modes(int dim,
+                            int nodes_count,
+                            double* coords,
+                            double* modes)
+{
+  int i,c,k;
+  int n = dim*nodes_count;
+  double x,y,z;
+  if (dim == 2)
+    k = 3;
+  else if (dim == 3)
+    k = 6;
+  else
+    return 0;
+  memset(modes,0,(size_t)n*k*sizeof(double));
+  for (i = 0; i < nodes_count; ++ i)
+  {
+    /* translations */
+    for (c = 0; c < dim; ++ c)
+      modes[(size_t)c*n+i*dim+c] = 1;
+    /* rotations */
+    x = coords[i*dim];
+    y = coords[i*dim+1];
+    if (dim == 2)
+    {
+      modes[(size_t)2*n+i*2] = -y;
+      modes[(size_t)2*n+i*2+1] = x;
+    }
+    else
+    {
+      z = coords[i*dim+2];
+      modes[(size_t)3*n+i*3] = -y;
+      modes[(size_t)3*n+i*3+1] = x;
+      modes[(size_t)4*n+i*3+1] = -z;
+      modes[(size_t)4*n+i*3+2] = y;
+      modes[(size_t)5*n+i*3] = z;
+      modes[(size_t)5*n+i*3+2] = -x;
+    }
+  }
+  return k;
+}
+
+/* AMG preconditioner */
+
+typedef struct
+{
+  sp_amg_params params;
+  int ready;
+  sp_amg amg;
+} amg_precond_state;
+
+static int amg_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  amg_precond_state* s = (amg_precond_state*)state;
+  if (s->ready)
+    sp_amg_free(&s->amg);
+  s->ready = sp_amg_init(&s->amg,A,&s->params);
+  return s->ready;
+}
+
+static void amg_precond_apply(void* state, double* r, double* z)
+{
+  sp_amg_vcycle(&((amg_precond_state*)state)->amg,r,z);
+}
+
+static void amg_precond_free(void* state)
+{
+  amg_precond_state* s = (amg_precond_state*)state;
+  if (s->ready)
+    sp_amg_free(&s->amg);
+  spfree(s);
+}
+
+void sp_precond_amg_init(sp_precond_ptr self, sp_amg_params_ptr params)
+{
+  amg_precond_state* s = spcalloc(1,sizeof(amg_precond_state));
+  if (params)
+    memcpy(&s->params,params,sizeof(sp_amg_params));
+  else
+    sp_amg_params_init(&s->params);
+  sp_precond_init(self,amg_precond_setup,amg_precond_apply,
+                  amg_precond_free,s);
+}
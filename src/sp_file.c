@@ -19,6 +19,9 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <assert.h>
 
 #include "sp_file.h"
@@ -26,6 +29,7 @@
 #include "sp_utils.h"
 #include "sp_log.h"
 #include "sp_cont.h"
+#include "sp_par.h"
 
 /*
  * Enum - supported export formats
@@ -35,6 +39,8 @@ typedef enum
   FMT_MM,
   FMT_TXT,
   FMT_DAT,
+  FMT_SPB,
+  FMT_SPZ,
   FMT_UNSUPPORTED
 } supported_format;
 /*
@@ -52,6 +58,80 @@ const char* DAT_HEADER_FORMAT = "# name: %s\n"
 "# rows: %d\n"
 "# columns: %d\n";
 
+/*
+ * Native binary format (*.spb): the header followed by the arrays
+ * offsets, indicies and values as they are stored in memory, every
+ * array aligned to SPB_ALIGNMENT bytes from the beginning of the file
+ */
+#define SPB_MAGIC "SPMATRIX"
+#define SPB_VERSION 1
+/* written in the native byte order, detects files from other platforms */
+#define SPB_BYTE_ORDER 0x01020304u
+#define SPB_ALIGNMENT 64
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t storage_type;        /* CRS or CCS */
+  uint32_t index_size;          /* size of offsets and indicies elements */
+  uint32_t value_size;          /* size of values elements */
+  uint32_t properties;          /* matrix_properties */
+  int64_t rows_count;
+  int64_t cols_count;
+  int64_t nonzeros;
+  int64_t offsets_pos;          /* positions of the arrays in the file */
+  int64_t indicies_pos;
+  int64_t values_pos;
+} spb_header;
+
+/*
+ * Binary files of the Cholesky decomposition: the header followed by
+ * the arrays aligned as in the binary matrix format. The fingerprint is
+ * the pattern hash of the matrix A the decomposition was computed for
+ */
+#define SPC_MAGIC_SYMBOLIC "SPCHOLSY"
+#define SPC_MAGIC_FACTOR "SPCHOLNL"
+#define SPC_VERSION 1
+#define SPC_MAX_ARRAYS 8
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t index_size;
+  uint32_t value_size;
+  uint32_t arrays_count;
+  uint32_t reserved;
+  int64_t rows_count;
+  int64_t nonzeros;
+  uint64_t fingerprint;
+  int64_t positions[SPC_MAX_ARRAYS];
+  int64_t sizes[SPC_MAX_ARRAYS];   /* sizes of the arrays in bytes */
+} spc_header;
+
+/*
+ * Binary vector files (*.spv): the header followed by the vectors one
+ * after another, aligned to SPB_ALIGNMENT
+ */
+#define SPV_MAGIC "SPVECTOR"
+#define SPV_VERSION 1
+#define SPV_CHECKSUM 1          /* flag: checksum of the data is stored */
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t type;                /* sp_vector_type */
+  uint32_t flags;
+  int64_t length;               /* size of every vector */
+  int64_t count;                /* number of vectors */
+  uint64_t checksum;            /* FNV-1a of the data */
+} spv_header;
+
 /*
  * length of the HB file line is 80, but sometimes it can be more
  * possibly because some bugs in export software
@@ -191,153 +271,680 @@ static int mm_validate_header(mm_header* header)
   return 1;
 }
 
+/* Returns pointer to the beginning of the next line */
+static const char* mm_next_line(const char* ptr, const char* end)
+{
+  while (ptr < end && *ptr != '\n')
+    ptr++;
+  return ptr < end ? ptr + 1 : end;
+}
+
+/* Skips whitespaces, empty lines and comment lines */
+static const char* mm_skip_comments(const char* ptr, const char* end)
+{
+  while (ptr < end)
+  {
+    if (*ptr == ' ' || *ptr == '\t' || *ptr == '\r' || *ptr == '\n')
+      ptr++;
+    else if (*ptr == '%')
+      ptr = mm_next_line(ptr,end);
+    else
+      break;
+  }
+  return ptr;
+}
+
+/* Minimal size of the part of the file parsed by one thread */
+#define MIN_CHUNK_SIZE (1 << 20)
+
+/* Elements parsed from one newline-aligned part of the file */
+typedef struct
+{
+  const char* begin;
+  const char* end;
+  size_t lines;                 /* upper bound of the elements count */
+  int entries;                  /* number of lines with elements */
+  int count;                    /* number of elements including mirrored */
+  int max_row;                  /* maximum 0-based indicies */
+  int max_col;
+  int error;                    /* nonzero if the entry is not parsed */
+  int* rows;
+  int* cols;
+  double* values;
+} triplet_chunk;
+
+/*
+ * Counts the lines of the chunk, every line holds at most one entry
+ * (two if mirrored by the symmetry)
+ */
+static void count_triplet_chunk(triplet_chunk* chunk, int portrait)
+{
+  const char* next;
+  size_t lines = 1;
+  for (next = chunk->begin; next < chunk->end &&
+         (next = memchr(next,'\n',chunk->end - next)); ++ next)
+    lines++;
+  if (portrait == MM_SYMMETRIC || portrait == MM_SKEW_SYMMETRIC)
+    lines *= 2;
+  chunk->lines = lines;
+}
+
+/*
+ * Parses the lines "row col [value]" of the chunk to the buffers
+ * allocated for chunk->lines elements
+ * base - index base of the file, 1 for MM and 0 for triplets
+ * elements, portrait - MM header fields
+ */
+static void parse_triplet_chunk(triplet_chunk* chunk,
+                                int base,
+                                int elements,
+                                int portrait)
+{
+  const char* ptr = chunk->begin;
+  const char* next;
+  int i,j;
+  double value = 1;
+  int symmetric = portrait == MM_SYMMETRIC || portrait == MM_SKEW_SYMMETRIC;
+  chunk->max_row = chunk->max_col = -1;
+  while (1)
+  {
+    ptr = mm_skip_comments(ptr,chunk->end);
+    if (ptr == chunk->end)
+      break;
+    if ((next = sp_parse_int(ptr,chunk->end,&i)) == ptr ||
+        (ptr = sp_parse_int(next,chunk->end,&j)) == next ||
+        (elements != MM_PATTERN &&
+         (next = sp_parse_double(ptr,chunk->end,&value)) == ptr))
+    {
+      chunk->error = 1;
+      break;
+    }
+    i -= base;
+    j -= base;
+    chunk->rows[chunk->count] = i;
+    chunk->cols[chunk->count] = j;
+    chunk->values[chunk->count++] = value;
+    /* handle symmetry property */
+    if ( i != j && symmetric )
+    {
+      chunk->rows[chunk->count] = j;
+      chunk->cols[chunk->count] = i;
+      chunk->values[chunk->count++] =
+        portrait == MM_SYMMETRIC ? value : -value;
+    }
+    chunk->max_row = i > chunk->max_row ? i : chunk->max_row;
+    chunk->max_col = j > chunk->max_col ? j : chunk->max_col;
+    chunk->entries++;
+    ptr = mm_next_line(ptr,chunk->end);
+  }
+}
+
+/*
+ * Loads the triplets from the text [begin,end) to the matrix.
+ * The text is split to the newline-aligned chunks parsed in parallel,
+ * the elements are merged by the (parallel) counting sort
+ * rows, cols - matrix sizes, if 0 determined by the maximum indicies
+ * nonzeros - expected number of entries, not checked if negative
+ */
+static int load_triplets(sp_matrix_yale_ptr self,
+                         const char* begin,
+                         const char* end,
+                         int base,
+                         int elements,
+                         int portrait,
+                         int rows,
+                         int cols,
+                         int nonzeros,
+                         sparse_storage_type type)
+{
+  int result = 0;
+  int k,chunks_count = sp_par_max_threads();
+  int entries = 0, count = 0, max_row = -1, max_col = -1;
+  size_t size = (size_t)(end - begin);
+  triplet_chunk* chunks;
+  int* offsets;
+  int* row_idx;
+  int* col_idx;
+  double* values;
+
+  if (size/MIN_CHUNK_SIZE < (size_t)chunks_count)
+    chunks_count = size/MIN_CHUNK_SIZE > 1 ? (int)(size/MIN_CHUNK_SIZE) : 1;
+  chunks = spcalloc(chunks_count,sizeof(triplet_chunk));
+  offsets = spcalloc(chunks_count+1,sizeof(int));
+  /* the line belongs to the chunk where it starts */
+  chunks[0].begin = begin;
+  for (k = 1; k < chunks_count; ++ k)
+    chunks[k].begin = mm_next_line(begin + size/chunks_count*k - 1,end);
+  for (k = 0; k < chunks_count; ++ k)
+    chunks[k].end = k < chunks_count - 1 ? chunks[k+1].begin : end;
+  SP_PRAGMA(omp parallel for schedule(static,1))
+  for (k = 0; k < chunks_count; ++ k)
+    count_triplet_chunk(chunks + k,portrait);
+  /* spalloc is not thread-safe, allocate outside of the parallel regions */
+  for (k = 0; k < chunks_count; ++ k)
+  {
+    chunks[k].rows = spalloc(chunks[k].lines*sizeof(int));
+    chunks[k].cols = spalloc(chunks[k].lines*sizeof(int));
+    chunks[k].values = spalloc(chunks[k].lines*sizeof(double));
+  }
+  SP_PRAGMA(omp parallel for schedule(static,1))
+  for (k = 0; k < chunks_count; ++ k)
+    parse_triplet_chunk(chunks + k,base,elements,portrait);
+  for (k = 0; k < chunks_count; ++ k)
+  {
+    if (chunks[k].error)
+    {
+      LOGERROR("Unable to parse element %d",entries + chunks[k].entries + 1);
+      break;
+    }
+    entries += chunks[k].entries;
+    offsets[k+1] = offsets[k] + chunks[k].count;
+    max_row = chunks[k].max_row > max_row ? chunks[k].max_row : max_row;
+    max_col = chunks[k].max_col > max_col ? chunks[k].max_col : max_col;
+  }
+  if (k == chunks_count)
+  {
+    count = offsets[chunks_count];
+    if (nonzeros >= 0 && entries != nonzeros)
+    {
+      LOGERROR("Error loading matrix, expected %d nonzeros, parsed %d",
+               nonzeros, entries);
+    }
+    else
+    {
+      row_idx = spalloc((count+1)*sizeof(int));
+      col_idx = spalloc((count+1)*sizeof(int));
+      values = spalloc((count+1)*sizeof(double));
+      SP_PRAGMA(omp parallel for schedule(static,1))
+      for (k = 0; k < chunks_count; ++ k)
+      {
+        memcpy(row_idx + offsets[k],chunks[k].rows,
+               chunks[k].count*sizeof(int));
+        memcpy(col_idx + offsets[k],chunks[k].cols,
+               chunks[k].count*sizeof(int));
+        memcpy(values + offsets[k],chunks[k].values,
+               chunks[k].count*sizeof(double));
+      }
+      result = sp_matrix_yale_init_coo(self,type,
+                                       rows ? rows : max_row + 1,
+                                       cols ? cols : max_col + 1,
+                                       count,row_idx,col_idx,values);
+      spfree(row_idx);
+      spfree(col_idx);
+      spfree(values);
+    }
+  }
+  for (k = 0; k < chunks_count; ++ k)
+  {
+    spfree(chunks[k].rows);
+    spfree(chunks[k].cols);
+    spfree(chunks[k].values);
+  }
+  spfree(chunks);
+  spfree(offsets);
+  return result;
+}
+
 /*
  * Load matrix in MatrixMarket format
+ * The file is mapped into memory and parsed in place by several threads,
+ * elements are collected in the coordinate form and converted by
+ * counting sort
  */
 static int sp_matrix_yale_load_file_mm(sp_matrix_yale_ptr self,
                                        const char* filename,
                                        sparse_storage_type type)
 {
-  int result = 0;
-  sp_matrix mtx;
+  int result;
+  sp_file_view file;
   mm_header header;
   const char* ptr;
-  const char* line;
-  int block_number = 0;
+  const char* end;
+  const char* next;
+  char* line;
   int rows, cols, nonzeros = 0;
-  int element_number = -1;
-  int i,j;
-  double value;
-  char* contents;
   /* clear the structures */
-  memset(&mtx,0,sizeof(mtx));
   memset(&header,0,sizeof(header));
-  /* read the file contents  */
-  contents = sp_read_text_file(filename);
-  if (!contents)
+  /* map the file contents  */
+  if (!sp_file_view_open(&file,filename))
+    return 0;
+  ptr = file.data;
+  end = ptr + file.size;
+
+  /* header */
+  next = mm_next_line(ptr,end);
+  line = sp_strndup(ptr,next - ptr);
+  ptr = mm_read_header(line, &header);
+  if (ptr == line || !mm_validate_header(&header))
+  {
+    LOGERROR("Not supported matrix type");
+    spfree(line);
+    sp_file_view_close(&file);
+    return 0;
+  }
+  spfree(line);
+  /* sizes */
+  ptr = mm_skip_comments(next,end);
+  if ((next = sp_parse_int(ptr,end,&rows)) == ptr ||
+      (ptr = sp_parse_int(next,end,&cols)) == next ||
+      (next = sp_parse_int(ptr,end,&nonzeros)) == ptr ||
+      rows <= 0 || cols <= 0 || nonzeros < 0)
+  {
+    LOGERROR("Unable to parse sizes");
+    sp_file_view_close(&file);
+    return 0;
+  }
+  /* data */
+  result = load_triplets(self,mm_next_line(next,end),end,1,
+                         header.elements,header.portrait,
+                         rows,cols,nonzeros,type);
+  sp_file_view_close(&file);
+  return result;
+}
+
+/*
+ * Loads the dense vectors of the size rows from the mapped Matrix Market
+ * file in the array (column-major) or coordinate format to the
+ * allocated column-major array values, count is the number of vectors
+ * Returns nonzero if successfull
+ */
+static int mm_load_dense(const sp_file_view* file,
+                         const char* filename,
+                         int rows,
+                         int* count,
+                         double** values)
+{
+  mm_header header;
+  const char* ptr = file->data;
+  const char* end = ptr + file->size;
+  const char* next;
+  char* line;
+  int i,j,k,m,n,nonzeros = 0,size,result;
+  double value;
+  memset(&header,0,sizeof(header));
+  next = mm_next_line(ptr,end);
+  line = sp_strndup(ptr,next - ptr);
+  result = mm_read_header(line, &header) != line;
+  spfree(line);
+  if (!result || header.object != MM_MATRIX ||
+      header.portrait != MM_GENERAL ||
+      (header.elements != MM_REAL && header.elements != MM_INTEGER))
+  {
+    LOGERROR("File %s: vectors shall be real general matricies",filename);
+    return 0;
+  }
+  ptr = mm_skip_comments(next,end);
+  if ((next = sp_parse_int(ptr,end,&m)) == ptr ||
+      (ptr = sp_parse_int(next,end,&n)) == next)
+    result = 0;
+  else if (header.storage == MM_COORDINATE)
+    result = sp_parse_int(ptr,end,&nonzeros) != ptr;
+  if (!result || m != rows || n < 0 || n > INT_MAX/rows || nonzeros < 0)
+  {
+    LOGERROR("File %s: expected vectors of size %d",filename,rows);
+    return 0;
+  }
+  size = m*n;
+  *count = n;
+  *values = spcalloc(size+1,sizeof(double));
+  ptr = mm_next_line(ptr,end);
+  if (header.storage == MM_ARRAY)
+  {
+    for (k = 0; k < size && result; ++ k)
+    {
+      next = mm_skip_comments(ptr,end);
+      result = (ptr = sp_parse_double(next,end,*values + k)) != next;
+    }
+  }
+  else
+  {
+    for (k = 0; k < nonzeros && result; ++ k)
+    {
+      next = mm_skip_comments(ptr,end);
+      result = (ptr = sp_parse_int(next,end,&i)) != next &&
+        (next = sp_parse_int(ptr,end,&j)) != ptr &&
+        (ptr = sp_parse_double(next,end,&value)) != next &&
+        i >= 1 && i <= m && j >= 1 && j <= n;
+      if (result)
+        (*values)[(j-1)*m + i-1] = value;
+    }
+  }
+  if (!result)
+  {
+    LOGERROR("File %s: unable to parse element %d",filename,k);
+    spfree(*values);
+    *values = 0;
+  }
+  return result;
+}
+
+/*
+ * Loads the vectors for the Matrix Market file filename from the
+ * companion file with the suffix (like "_b" for name_b.mtx), if exists.
+ * The number of vectors shall be the same in all companion files
+ * Returns nonzero if successfull or the file is absent
+ */
+static int mm_load_companion(sp_matrix_vectors_ptr vectors,
+                             const char* filename,
+                             const char* suffix,
+                             double** values)
+{
+  sp_file_view file;
+  FILE* probe;
+  const char* ext = sp_parse_file_extension(filename);
+  size_t length = (size_t)(ext - filename) - 1;
+  char* name = spalloc(length + strlen(suffix) + 5);
+  int count = 0,result = 1;
+  memcpy(name,filename,length);
+  strcpy(name + length,suffix);
+  strcat(name,".mtx");
+  /* check quietly if the file exists, the view logs an error otherwise */
+  if ((probe = fopen(name,"rb")))
+  {
+    fclose(probe);
+    result = sp_file_view_open(&file,name);
+  }
+  if (probe && result)
+  {
+    result = mm_load_dense(&file,name,vectors->rows,&count,values);
+    sp_file_view_close(&file);
+    if (result && vectors->count && count != vectors->count)
+    {
+      LOGERROR("File %s: expected %d vectors, found %d",
+               name,vectors->count,count);
+      spfree(*values);
+      *values = 0;
+      result = 0;
+    }
+    vectors->count = count;
+  }
+  spfree(name);
+  return result;
+}
+
+/*
+ * Load matrix in 0-based triplet format "row col value" without header,
+ * as written by sp_matrix_yale_save_file; sizes are determined by
+ * the maximum indicies
+ */
+static int sp_matrix_yale_load_file_txt(sp_matrix_yale_ptr self,
+                                        const char* filename,
+                                        sparse_storage_type type)
+{
+  int result;
+  sp_file_view file;
+  if (!sp_file_view_open(&file,filename))
+    return 0;
+  result = load_triplets(self,file.data,file.data + file.size,0,
+                         MM_REAL,MM_GENERAL,0,0,-1,type);
+  sp_file_view_close(&file);
+  return result;
+}
+
+/* Maximum width of the number in the fixed-width field */
+#define HB_FIELD_SIZE 64
+
+/*
+ * Copies the line starting at ptr to buf of HB_LINE_SIZE+1 characters
+ * without the end of line, returns the beginning of the next line
+ */
+static const char* hb_read_line(const char* ptr, const char* end, char* buf)
+{
+  const char* next = mm_next_line(ptr,end);
+  size_t size = (size_t)(next - ptr);
+  while (size && (ptr[size-1] == '\n' || ptr[size-1] == '\r'))
+    size--;
+  size = size < HB_LINE_SIZE ? size : HB_LINE_SIZE;
+  memcpy(buf,ptr,size);
+  buf[size] = '\0';
+  return next;
+}
+
+/*
+ * Integer in the fixed-width header field starting at the position pos
+ * of the line; blank or absent field gives 0
+ */
+static int hb_header_int(const char* line, int pos, int width)
+{
+  int value = 0;
+  size_t length = strlen(line);
+  if ((size_t)pos < length)
+    sp_parse_int(line + pos,line + (length < (size_t)(pos + width) ?
+                                    length : (size_t)(pos + width)),&value);
+  return value;
+}
+
+/* Parses the FORTRAN format in the fixed-width field of the line */
+static int hb_header_format(const char* line, int pos, int width,
+                            fortran_io_format* fmt)
+{
+  char buf[HB_LINE_SIZE+1];
+  size_t length = strlen(line);
+  if ((size_t)pos >= length)
+    return 0;
+  length = length - pos < (size_t)width ? length - pos : (size_t)width;
+  memcpy(buf,line + pos,length);
+  buf[length] = '\0';
+  return sp_parse_fortran_format(buf,fmt);
+}
+
+/* Skips the spaces in [ptr,end) */
+static const char* hb_skip_blanks(const char* ptr, const char* end)
+{
+  while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+    ptr++;
+  return ptr;
+}
+
+/*
+ * Parses the real number in the fixed-width field [ptr,end).
+ * Besides E and D exponents handles the FORTRAN form without the
+ * exponent letter, like 0.5-100
+ */
+static int hb_field_double(const char* ptr, const char* end, double* value)
+{
+  char buf[HB_FIELD_SIZE+2];
+  char* buf_end;
+  const char* next = sp_parse_double(ptr,end,value);
+  const char* mantissa_end;
+  size_t length;
+  if (next == ptr)
     return 0;
+  if (next < end && (*next == '+' || *next == '-'))
+  {
+    /* copy inserting the exponent letter */
+    mantissa_end = next;
+    ptr = hb_skip_blanks(ptr,end);
+    while (next < end && *next != ' ')
+      next++;
+    length = (size_t)(next - ptr);
+    if (length > HB_FIELD_SIZE)
+      return 0;
+    memcpy(buf,ptr,mantissa_end - ptr);
+    buf[mantissa_end - ptr] = 'E';
+    memcpy(buf + (mantissa_end - ptr) + 1,mantissa_end,next - mantissa_end);
+    buf[length+1] = '\0';
+    *value = strtod(buf,&buf_end);
+    if (buf_end != buf + length + 1)
+      return 0;
+  }
+  return hb_skip_blanks(next,end) == end;
+}
 
-  /* split by lines */
-  line = strtok(contents,"\n");
-  while (line)
+/*
+ * Decodes count numbers in the format fmt from the lines [*ptr,end),
+ * at most fmt->repeat fields of fmt->width characters in every line,
+ * to ints (I format) or reals. Numbers are parsed in place without
+ * copying. *ptr is advanced after the lines
+ * Returns nonzero if successfull
+ */
+static int hb_decode_fields(const char** ptr,
+                            const char* end,
+                            int lines,
+                            const fortran_io_format* fmt,
+                            int count,
+                            int* ints,
+                            double* reals)
+{
+  const char* line = *ptr;
+  const char* line_end;
+  const char* field;
+  const char* field_end;
+  int k,decoded = 0;
+  if (fmt->width <= 0 || fmt->width > HB_FIELD_SIZE || fmt->repeat <= 0)
+    return 0;
+  for (; lines > 0 && line < end; -- lines)
   {
-    if (block_number == 0)      /* header */
+    *ptr = mm_next_line(line,end);
+    line_end = *ptr;
+    while (line_end > line && (line_end[-1] == '\n' || line_end[-1] == '\r'))
+      line_end--;
+    for (k = 0; k < fmt->repeat && decoded < count; ++ k)
     {
-      ptr = mm_read_header(line, &header);
-      if (ptr == line)          /* error */
+      field = line + k*fmt->width;
+      if (field >= line_end)
         break;
-      if (!mm_validate_header(&header))
+      field_end = line_end - field > fmt->width ? field + fmt->width :
+        line_end;
+      if (hb_skip_blanks(field,field_end) == field_end)
+        break;                  /* blank rest of the last line */
+      if (fmt->type == 'I')
       {
-        LOGERROR("Not supported matrix type");
-        break;
+        if (sp_parse_int(field,field_end,ints + decoded) == field)
+          return 0;
       }
-      /* goto next step - parse sizes */
-      block_number++;
+      else if (!hb_field_double(field,field_end,reals + decoded))
+        return 0;
+      decoded++;
     }
-    else if (block_number == 1) /* sizes */
+    line = *ptr;
+  }
+  return decoded == count && !lines;
+}
+
+/*
+ * Decodes the right-hand sides, initial guesses and solutions section
+ * of the HB file to the dense arrays of vectors. RHSTYP is given in
+ * rhstyp: 'F' for the full or 'M' for the sparse right-hand sides in
+ * the format of the matrix, followed by 'G' and 'X' if guesses and
+ * solutions are present; every block starts from the new line
+ * Returns nonzero if successfull
+ */
+static int hb_decode_vectors(const char** ptr,
+                             const char* end,
+                             const char* rhstyp,
+                             int nrhs,
+                             int nrhsix,
+                             const fortran_io_format* ptrfmt,
+                             const fortran_io_format* indfmt,
+                             const fortran_io_format* rhsfmt,
+                             sp_matrix_vectors_ptr vectors)
+{
+  int j,p,size,result = 1;
+  int* rhsptr;
+  int* rhsind;
+  double* rhsval;
+  if (rhsfmt->repeat <= 0 || rhsfmt->type == 'I' ||
+      (rhstyp[0] != 'F' && rhstyp[0] != 'M') ||
+      nrhs < 0 || nrhs > INT_MAX/vectors->rows || nrhsix < 0)
+  {
+    LOGERROR("Unsupported right-hand sides: %.3s, %d vectors",rhstyp,nrhs);
+    return 0;
+  }
+  vectors->count = nrhs;
+  size = vectors->rows*nrhs;
+  if (rhstyp[0] == 'F')
+  {
+    vectors->rhs = spalloc((size+1)*sizeof(double));
+    if (!hb_decode_fields(ptr,end,(size + rhsfmt->repeat - 1)/rhsfmt->repeat,
+                          rhsfmt,size,0,vectors->rhs))
     {
-      ptr = sp_skip_whitespaces(line);
-      if (*ptr && *ptr != '%')  /* not empty line and not comment */
-      {
-        /* read sizes */
-        if (sscanf(line, "%d %d %d", &rows, &cols, &nonzeros) != 3)
-        {
-          LOGERROR("Unable to parse sizes");
-          break;
-        }
-        sp_matrix_init(&mtx,rows,cols,nonzeros/rows + 1,type);
-        element_number = 0;     /* start with first element */
-        block_number++;
-      }
+      LOGERROR("Unable to parse right-hand sides: expected %d", size);
+      return 0;
     }
-    else if (block_number == 2) /* data */
+  }
+  else
+  {
+    /* sparse right-hand sides: pointers, row indicies, values */
+    vectors->rhs = spcalloc(size+1,sizeof(double));
+    rhsptr = spalloc((nrhs+1)*sizeof(int));
+    rhsind = spalloc((nrhsix+1)*sizeof(int));
+    rhsval = spalloc((nrhsix+1)*sizeof(double));
+    if (!hb_decode_fields(ptr,end,(nrhs + ptrfmt->repeat)/ptrfmt->repeat,
+                          ptrfmt,nrhs+1,rhsptr,0) ||
+        !hb_decode_fields(ptr,end,
+                          (nrhsix + indfmt->repeat - 1)/indfmt->repeat,
+                          indfmt,nrhsix,rhsind,0) ||
+        !hb_decode_fields(ptr,end,
+                          (nrhsix + rhsfmt->repeat - 1)/rhsfmt->repeat,
+                          rhsfmt,nrhsix,0,rhsval) ||
+        rhsptr[0] != 1 || rhsptr[nrhs] != nrhsix + 1)
     {
-      ptr = sp_skip_whitespaces(line);
-      if (*ptr && *ptr != '%')  /* not empty line and not comment */
+      LOGERROR("Unable to parse sparse right-hand sides: expected %d",
+               nrhsix);
+      result = 0;
+    }
+    for (j = 0; j < nrhs && result; ++ j)
+      for (p = rhsptr[j] - 1; p < rhsptr[j+1] - 1 && result; ++ p)
       {
-        if ( header.elements == MM_PATTERN)
+        if (p < 0 || p >= nrhsix ||
+            rhsind[p] < 1 || rhsind[p] > vectors->rows)
         {
-          if (sscanf(line, "%d %d", &i, &j) != 2)
-          {
-            LOGERROR("Unable to parse line %s",line);
-            break;
-          }
-          value = 1;
+          LOGERROR("Wrong pointers or row indicies in right-hand side %d",
+                   j+1);
+          result = 0;
         }
         else
-        {
-          if (sscanf(line, "%d %d %lg", &i, &j, &value) != 3)
-          {
-            LOGERROR("Unable to parse line %s",line);
-            break;
-          }
-
-        }
-        sp_matrix_element_add(&mtx,i-1,j-1,value);
-        /* handle symmetry property */
-        if ( i != j )
-        {
-          if ( header.portrait == MM_SYMMETRIC )
-            sp_matrix_element_add(&mtx,j-1,i-1,value);
-          else if (header.portrait == MM_SKEW_SYMMETRIC)
-            sp_matrix_element_add(&mtx,j-1,i-1,-value);
-        }
-        ++ element_number;
+          vectors->rhs[j*vectors->rows + rhsind[p] - 1] = rhsval[p];
       }
-    }
-    line = strtok(NULL,"\n");
-  }
-
-  /* free resources */
-  spfree(contents);
-  /* check for error */
-  if ( element_number != nonzeros)
-  {
-    LOGERROR("Error loading matrix, expected %d nonzeros, parsed %d",
-             nonzeros, element_number);
-    sp_matrix_free(&mtx);
+    spfree(rhsptr);
+    spfree(rhsind);
+    spfree(rhsval);
+    if (!result)
+      return 0;
   }
-  else
+  if (rhstyp[1] == 'G')
   {
-    sp_matrix_yale_init(self,&mtx);
-    sp_matrix_free(&mtx);
-    result = 1;
+    vectors->guess = spalloc((size+1)*sizeof(double));
+    if (!hb_decode_fields(ptr,end,(size + rhsfmt->repeat - 1)/rhsfmt->repeat,
+                          rhsfmt,size,0,vectors->guess))
+    {
+      LOGERROR("Unable to parse initial guesses: expected %d", size);
+      return 0;
+    }
   }
-  return result;
-}
-
-static int hb_extract_positional_format(const char* from, int size,
-                                        fortran_io_format* fmt)
-{
-  int result = 0;
-  char* buf = spalloc(size+1);
-  char* ptr = buf;
-  int i = 0;
-  while (i < size && *from)
+  if (rhstyp[2] == 'X')
   {
-    *ptr++ = *from++;
-    ++i;
+    vectors->solution = spalloc((size+1)*sizeof(double));
+    if (!hb_decode_fields(ptr,end,(size + rhsfmt->repeat - 1)/rhsfmt->repeat,
+                          rhsfmt,size,0,vectors->solution))
+    {
+      LOGERROR("Unable to parse solutions: expected %d", size);
+      return 0;
+    }
   }
-  buf[size] = '\0';
-  result = sp_parse_fortran_format(buf,fmt);
-  spfree(buf);
-  return result;
+  return 1;
 }
 
 /*
  * Load matrix in Harwell Boeing format
+ * The file is mapped into memory, the fixed-width fields are parsed
+ * in place and the CCS arrays are built directly from colptr/rowind.
+ * If vectors is not 0 the right-hand sides, guesses and solutions
+ * are decoded in the same pass
  */
 static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
+                                       sp_matrix_vectors_ptr vectors,
                                        const char* filename)
 {
-  int i,j,p,n;
-  sp_matrix mtx;
+  int i,p,sorted = 1,count = 0,result = 0;
   matrix_properties props = PROP_GENERAL;
-  /* 1 for '\n' */
-
+  sp_file_view file;
+  const char* ptr;
+  const char* end;
   /* HB format line limitation 80 chars */
   char buf[HB_LINE_SIZE+1];
-  char* ptr;
+  char rhstyp[4] = "   ";
   /* constants from HB format */
   /* for line 2 */
   int totcrd, ptrcrd, indcrd, valcrd, rhscrd;
@@ -345,12 +952,16 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
   int nrow, ncol, nnzero;
   /* for line 4 */
   fortran_io_format ptrfmt, indfmt, valfmt, rhsfmt;
-  /* temporary exctracted values */
-  fortran_number* fortran_numbers;
+  /* for line 5 */
+  int nrhs = 0, nrhsix = 0;
   /* data in column-wise triplet form */
   int* colptr    = 0;                /* location of first entry */
   int* rowind    = 0;                /* row indicies */
   double* values = 0;                /* numerical valus */
+  /* expanded coordinate form */
+  int* rows;
+  int* cols;
+  double* coo_values;
   /* example: */
   /*
    * 1. -3.  0. -1.  0.
@@ -366,26 +977,20 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
    * rowind     | 1   3   5   1   4   2   5   1   4    2   5
    * values     | 1.  2.  5. -3.  4. -2. -5. -1. -4.   3.  6.
    */
-  
-  /*
-   * temporary variables - counter of extracted by sp_extract_fortran_numbers
-   * numbers and  number of column indicies (colptr array)
-   */
-  int extracted;
 
-  FILE* file = fopen(filename,"rt");
-  if (!file)
-  {
-    LOGERROR("Unable to open file %s for reading",filename);
+  if (vectors)
+    memset(vectors,0,sizeof(sp_matrix_vectors));
+  if (!sp_file_view_open(&file,filename))
     return 0;
-  }
+  ptr = file.data;
+  end = ptr + file.size;
 
   /*
    * Line 1.
    * TITLE, (72 characters)
    * KEY, (8 characters)
    */
-  fgets(buf,HB_LINE_SIZE,file);
+  ptr = mm_next_line(ptr,end);
   /* skip them */
 
   /*
@@ -399,25 +1004,19 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
    * RHSCRD, integer, number of data lines for right hand side vectors,
    *    starting guesses, and solutions, (14 characters)
    */
-  fgets(buf,HB_LINE_SIZE,file);
-  ptr = buf;
-  totcrd = sp_extract_positional_int(ptr,14);
-  ptr += 14;
-  ptrcrd = sp_extract_positional_int(ptr,14);
-  ptr += 14;
-  indcrd = sp_extract_positional_int(ptr,14);
-  ptr += 14;
-  valcrd = sp_extract_positional_int(ptr,14);
-  ptr += 14;
-  rhscrd = sp_extract_positional_int(ptr,14);
+  ptr = hb_read_line(ptr,end,buf);
+  totcrd = hb_header_int(buf,0,14);
+  ptrcrd = hb_header_int(buf,14,14);
+  indcrd = hb_header_int(buf,28,14);
+  valcrd = hb_header_int(buf,42,14);
+  rhscrd = hb_header_int(buf,56,14);
   if (totcrd != ptrcrd + indcrd + valcrd + rhscrd)
   {
     LOGERROR("Load file in HB format: total number of data lines %d not equal to %d+%d+%d+%d = %d",
              totcrd, ptrcrd, indcrd, valcrd, rhscrd, ptrcrd + indcrd + valcrd + rhscrd);
+    sp_file_view_close(&file);
     return 0;
   }
-  if (rhscrd)
-    LOGWARN("Right-part vector is not supported, ignoring");
   /*
    * Line 3.
    * MXTYPE, matrix type (see table), (3 characters)
@@ -429,24 +1028,24 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
    * NELTVL, integer, number of elemental matrix entries. For "assembled"
    *   matrices, this is 0. (14 characters)
    */
-  fgets(buf,HB_LINE_SIZE,file);
+  ptr = hb_read_line(ptr,end,buf);
   /* we support only real matrix */
   if (buf[0] != 'R')
   {
     LOGERROR("Complex or Pattern matrix not supported");
-    fclose(file);
+    sp_file_view_close(&file);
     return 0;
   }
   if (buf[1] == 'H')
   {
     LOGERROR("Complex Hermitian matrix not supported");
-    fclose(file);
+    sp_file_view_close(&file);
     return 0;
   }
   if (buf[2] == 'E')
   {
     LOGERROR("Elemental matrix not supported");
-    fclose(file);
+    sp_file_view_close(&file);
     return 0;
   }
   switch(buf[1])
@@ -455,12 +1054,17 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
   case 'Z': props = PROP_SKEW_SYMMETRIC; break;
   default:  props = PROP_GENERAL; break;
   }
-  ptr = buf + 14;
-  nrow = sp_extract_positional_int(ptr,14);
-  ptr += 14;
-  ncol = sp_extract_positional_int(ptr,14);
-  ptr += 14;
-  nnzero = sp_extract_positional_int(ptr,14);
+  nrow = hb_header_int(buf,14,14);
+  ncol = hb_header_int(buf,28,14);
+  nnzero = hb_header_int(buf,42,14);
+  if (nrow <= 0 || ncol <= 0 || nnzero < 0 ||
+      (props != PROP_GENERAL && nrow != ncol))
+  {
+    LOGERROR("Load file in HB format: wrong sizes %d x %d, %d nonzeros",
+             nrow, ncol, nnzero);
+    sp_file_view_close(&file);
+    return 0;
+  }
   /*
    * Line 4.
    * PTRFMT, FORTRAN I/O format for pointers, (16 characters)
@@ -469,38 +1073,22 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
    * RHSFMT, FORTRAN I/O format for right hand sides, initial guesses, and
    *   solutions, (20 characters)
    */
-  fgets(buf,HB_LINE_SIZE,file);
-  ptr = buf;
-  if (!hb_extract_positional_format(ptr,16,&ptrfmt))
-  {
-    LOGERROR("Unknown format: %s",ptr);
-    fclose(file);
-    return 0;
-  }
-  ptr += 16;
-  if (!hb_extract_positional_format(ptr,16,&indfmt))
+  ptr = hb_read_line(ptr,end,buf);
+  if (!hb_header_format(buf,0,16,&ptrfmt) ||
+      !hb_header_format(buf,16,16,&indfmt) ||
+      !hb_header_format(buf,32,20,&valfmt) ||
+      ptrfmt.type != 'I' || indfmt.type != 'I' || valfmt.type == 'I')
   {
-    LOGERROR("Unknown format: %s",ptr);
-    fclose(file);
+    LOGERROR("Unknown format: %s",buf);
+    sp_file_view_close(&file);
     return 0;
   }
-  ptr += 16;
-  if (!hb_extract_positional_format(ptr,20,&valfmt))
+  if (rhscrd && vectors && !hb_header_format(buf,52,20,&rhsfmt))
   {
-    LOGERROR("Unknown format: %s",ptr);
-    fclose(file);
+    LOGERROR("Unknown right-hand sides format: %s",buf);
+    sp_file_view_close(&file);
     return 0;
   }
-  if (rhscrd)
-  {
-    ptr += 20;
-    if (!hb_extract_positional_format(ptr,20,&rhsfmt))
-    {
-      LOGERROR("Unknown format: %s",ptr);
-      fclose(file);
-      return 0;
-    }
-  }
   /*
    * Line 5: (only present if 0 <RHSCRD!)
    * RHSTYP, describes the right hand side information, (3 characters)
@@ -509,178 +1097,1081 @@ static int sp_matrix_yale_load_file_hb(sp_matrix_yale_ptr self,
    * NRHSIX, integer, number of row indices, (14 characters)
    */
   if ( rhscrd )
-    fgets(buf,HB_LINE_SIZE,file);
-
-  /* header parsing done, parsing the data */
-  
-  /* Section 1. pointers */
-  fortran_numbers = spcalloc(ptrfmt.repeat,sizeof(fortran_number));
-  n = 0;
-  while (ptrcrd --)
-  {
-    fgets(buf,HB_LINE_SIZE,file);
-    ptr = (char*)sp_extract_fortran_numbers(buf,
-                                            &ptrfmt,
-                                            fortran_numbers,
-                                            &extracted);
-    if (ptr == &buf[0])
-    {
-      LOGERROR("Unable to parse pointers: %s", buf);
-      fclose(file);
-      spfree(fortran_numbers);
-      spfree(colptr);
-      return 0;
-    }
-    colptr = colptr ? sprealloc(colptr, (n+extracted)*sizeof(int)) :
-      spcalloc(n+extracted,sizeof(int));
-    for (i = n; i < n + extracted; ++ i) 
-      colptr[i] = fortran_numbers[i-n].integer;
-    n += extracted;
-  }
-  spfree(fortran_numbers);
-  if ( n != nrow + 1 || !colptr)
   {
-    LOGERROR("Unable to parse row indicies: parsed = %d != "
-             "%d nonzeros", n, nnzero);
-    fclose(file);
-    spfree(colptr);
-    spfree(rowind);
-    return 0;
+    ptr = hb_read_line(ptr,end,buf);
+    memcpy(rhstyp,buf,strlen(buf) < 3 ? strlen(buf) : 3);
+    nrhs = hb_header_int(buf,14,14);
+    nrhsix = hb_header_int(buf,28,14);
   }
 
-  if (colptr[nrow] != nnzero+1)
+  /* header parsing done, parsing the data */
+  colptr = spalloc((ncol+1)*sizeof(int));
+  rowind = spalloc((nnzero+1)*sizeof(int));
+  values = spalloc((nnzero+1)*sizeof(double));
+  do
   {
-    LOGERROR("Unable to parse row indicies: last index = %d != "
-             "%d nonzeros", colptr[nrow], nnzero);
-    fclose(file);
-    spfree(colptr);
-    spfree(rowind);
-    return 0;
+    /* Section 1. pointers */
+    if (!hb_decode_fields(&ptr,end,ptrcrd,&ptrfmt,ncol+1,colptr,0))
+    {
+      LOGERROR("Unable to parse pointers: expected %d", ncol+1);
+      break;
+    }
+    if (colptr[0] != 1 || colptr[ncol] != nnzero+1)
+    {
+      LOGERROR("Unable to parse pointers: last index = %d != "
+               "%d nonzeros", colptr[ncol], nnzero);
+      break;
+    }
+    /* Section 2. rows */
+    if (!hb_decode_fields(&ptr,end,indcrd,&indfmt,nnzero,rowind,0))
+    {
+      LOGERROR("Unable to parse row indicies: expected %d", nnzero);
+      break;
+    }
+    /* Section 3. values */
+    if (!hb_decode_fields(&ptr,end,valcrd,&valfmt,nnzero,0,values))
+    {
+      LOGERROR("Unable to parse values: expected %d", nnzero);
+      break;
+    }
+    /* all indicies are 1 based in HB format */
+    for ( i = 0; i < ncol; ++ i)
+    {
+      colptr[i]--;
+      if (colptr[i] > colptr[i+1] - 1)
+        break;
+      for (p = colptr[i]; p < colptr[i+1] - 1; ++ p)
+      {
+        if (--rowind[p] < 0 || rowind[p] >= nrow)
+          break;
+        sorted = sorted && (p == colptr[i] || rowind[p-1] < rowind[p]);
+        count += props != PROP_GENERAL && rowind[p] != i ? 2 : 1;
+      }
+      if (p < colptr[i+1] - 1)
+        break;
+    }
+    if (i < ncol)
+    {
+      LOGERROR("Wrong pointers or row indicies in column %d", i+1);
+      break;
+    }
+    colptr[ncol]--;
+    /* Section 4. right-hand sides, guesses and solutions */
+    if (vectors)
+    {
+      vectors->rows = nrow;
+      if (rhscrd &&
+          !hb_decode_vectors(&ptr,end,rhstyp,nrhs,nrhsix,
+                             &ptrfmt,&indfmt,&rhsfmt,vectors))
+      {
+        sp_matrix_vectors_free(vectors);
+        break;
+      }
+    }
+    result = 1;
+  } while(0);
+  sp_file_view_close(&file);
+  if (!result)
+  {
+    spfree(colptr);
+    spfree(rowind);
+    spfree(values);
+    return 0;
+  }
+  if (props == PROP_GENERAL && sorted)
+  {
+    self->rows_count = nrow;
+    self->cols_count = ncol;
+    self->nonzeros   = nnzero;
+    self->storage_type = CCS;
+    self->offsets = colptr;
+    self->indicies = rowind;
+    self->values = values;
+    return 1;
+  }
+  /*
+   * for the symmetric and skew-symmetric matricies only one half of
+   * elements stored, expand them to the coordinate form; unsorted
+   * columns are sorted by the same conversion
+   */
+  rows = spalloc((count+1)*sizeof(int));
+  cols = spalloc((count+1)*sizeof(int));
+  coo_values = spalloc((count+1)*sizeof(double));
+  count = 0;
+  for (i = 0; i < ncol; ++ i)
+    for (p = colptr[i]; p < colptr[i+1]; ++ p)
+    {
+      rows[count] = rowind[p];
+      cols[count] = i;
+      coo_values[count++] = values[p];
+      if (props != PROP_GENERAL && rowind[p] != i)
+      {
+        rows[count] = i;
+        cols[count] = rowind[p];
+        coo_values[count++] =
+          props == PROP_SYMMETRIC ? values[p] : -values[p];
+      }
+    }
+  result = sp_matrix_yale_init_coo(self,CCS,nrow,ncol,count,
+                                   rows,cols,coo_values);
+  spfree(rows);
+  spfree(cols);
+  spfree(coo_values);
+  spfree(colptr);
+  spfree(rowind);
+  spfree(values);
+  return result;
+}
+
+/* Rounds the position in the binary file up to SPB_ALIGNMENT */
+static int64_t spb_align(int64_t pos)
+{
+  return (pos + SPB_ALIGNMENT - 1)/SPB_ALIGNMENT*SPB_ALIGNMENT;
+}
+
+/* Writes zeros to the file up to the position pos */
+static int spb_pad(FILE* file, int64_t written, int64_t pos)
+{
+  static const char zeros[SPB_ALIGNMENT] = {0};
+  return fwrite(zeros,1,(size_t)(pos - written),file) ==
+    (size_t)(pos - written);
+}
+
+/* Fills the header of the binary file and the positions of the arrays */
+static void spb_init_header(spb_header* header,
+                            sparse_storage_type type,
+                            int rows,
+                            int cols,
+                            int nonzeros,
+                            matrix_properties props)
+{
+  int n = type == CRS ? rows : cols;
+  memset(header,0,sizeof(spb_header));
+  memcpy(header->magic,SPB_MAGIC,sizeof(header->magic));
+  header->version = SPB_VERSION;
+  header->byte_order = SPB_BYTE_ORDER;
+  header->storage_type = type;
+  header->index_size = sizeof(int);
+  header->value_size = sizeof(double);
+  header->properties = props;
+  header->rows_count = rows;
+  header->cols_count = cols;
+  header->nonzeros = nonzeros;
+  header->offsets_pos = spb_align(sizeof(spb_header));
+  header->indicies_pos = spb_align(header->offsets_pos +
+                                   (n+1)*(int64_t)sizeof(int));
+  header->values_pos = spb_align(header->indicies_pos +
+                                 nonzeros*(int64_t)sizeof(int));
+}
+
+/*
+ * Checks the Yale arrays read from the file: offsets of n lines shall
+ * start from 0, not decrease and end with nonzeros; if check_indicies
+ * is nonzero indicies shall be in [0,m)
+ * Returns nonzero if the arrays are valid
+ */
+static int yale_arrays_valid(const int* offsets,
+                             const int* indicies,
+                             int n,
+                             int m,
+                             int nonzeros,
+                             int check_indicies)
+{
+  int i,p;
+  if (offsets[0] != 0 || offsets[n] != nonzeros)
+    return 0;
+  for (i = 0; i < n; ++ i)
+    if (offsets[i] > offsets[i+1])
+      return 0;
+  if (check_indicies)
+    for (p = 0; p < nonzeros; ++ p)
+      if (indicies[p] < 0 || indicies[p] >= m)
+        return 0;
+  return 1;
+}
+
+/*
+ * Validates the binary file contents and points the matrix arrays
+ * to the data inside the view; no copies are made
+ */
+static int spb_attach(sp_matrix_yale_ptr self,
+                      sp_file_view_ptr view,
+                      int validate,
+                      const char* filename)
+{
+  spb_header header;
+  int n,m;
+  int* offsets;
+  int* indicies;
+  if (view->size < sizeof(spb_header))
+  {
+    LOGERROR("File %s is too short",filename);
+    return 0;
+  }
+  memcpy(&header,view->data,sizeof(spb_header));
+  if (memcmp(header.magic,SPB_MAGIC,sizeof(header.magic)))
+  {
+    LOGERROR("File %s is not a binary matrix file",filename);
+    return 0;
+  }
+  if (header.version != SPB_VERSION ||
+      header.byte_order != SPB_BYTE_ORDER ||
+      header.index_size != sizeof(int) ||
+      header.value_size != sizeof(double))
+  {
+    LOGERROR("Binary matrix file %s: unsupported version %u, "
+             "byte order or data sizes",filename,header.version);
+    return 0;
+  }
+  if ((header.storage_type != CRS && header.storage_type != CCS) ||
+      header.rows_count < 0 || header.rows_count > INT_MAX ||
+      header.cols_count < 0 || header.cols_count > INT_MAX ||
+      header.nonzeros < 0 || header.nonzeros > INT_MAX)
+  {
+    LOGERROR("Binary matrix file %s: wrong header",filename);
+    return 0;
+  }
+  n = (int)(header.storage_type == CRS ? header.rows_count :
+            header.cols_count);
+  m = (int)(header.storage_type == CRS ? header.cols_count :
+            header.rows_count);
+  if (header.offsets_pos % SPB_ALIGNMENT ||
+      header.indicies_pos % SPB_ALIGNMENT ||
+      header.values_pos % SPB_ALIGNMENT ||
+      header.offsets_pos < (int64_t)sizeof(spb_header) ||
+      header.indicies_pos < header.offsets_pos + (n+1)*(int64_t)sizeof(int) ||
+      header.values_pos < header.indicies_pos +
+      header.nonzeros*(int64_t)sizeof(int) ||
+      (int64_t)view->size < header.values_pos +
+      header.nonzeros*(int64_t)sizeof(double))
+  {
+    LOGERROR("Binary matrix file %s is truncated or corrupted",filename);
+    return 0;
+  }
+  /* the view is read-only, the matrix is not modified through these */
+  offsets = (int*)(view->data + header.offsets_pos);
+  indicies = (int*)(view->data + header.indicies_pos);
+  if (!yale_arrays_valid(offsets,indicies,n,m,(int)header.nonzeros,
+                         validate))
+  {
+    LOGERROR("Binary matrix file %s: wrong offsets or indicies",filename);
+    return 0;
   }
+  self->storage_type = (sparse_storage_type)header.storage_type;
+  self->rows_count = (int)header.rows_count;
+  self->cols_count = (int)header.cols_count;
+  self->nonzeros = (int)header.nonzeros;
+  self->offsets = offsets;
+  self->indicies = indicies;
+  self->values = (double*)(view->data + header.values_pos);
+  return 1;
+}
 
+int sp_matrix_yale_map_file(sp_matrix_yale_ptr self,
+                            sp_file_view_ptr view,
+                            int validate,
+                            const char* filename)
+{
+  memset(self,0,sizeof(sp_matrix_yale));
+  if (!sp_file_view_open(view,filename))
+    return 0;
+  if (!spb_attach(self,view,validate,filename))
+  {
+    sp_file_view_close(view);
+    return 0;
+  }
+  return 1;
+}
 
-  /* Section 2. rows */
-  fortran_numbers  = spcalloc(indfmt.repeat, sizeof(fortran_number));
-  n = 0;
-  while (indcrd --)
+/*
+ * Writes the Cholesky decomposition file with the arrays
+ * arrays[0..count) of sizes[0..count) bytes
+ */
+static int spc_write(const char* filename,
+                     const char* magic,
+                     sp_matrix_yale_ptr A,
+                     int nonzeros,
+                     int count,
+                     const void** arrays,
+                     const int64_t* sizes)
+{
+  int i,result;
+  int64_t pos;
+  spc_header header;
+  FILE* file = fopen(filename,"wb");
+  if (!file)
+  {
+    LOGERROR("Error opening file %s for writing",filename);
+    return 0;
+  }
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,magic,sizeof(header.magic));
+  header.version = SPC_VERSION;
+  header.byte_order = SPB_BYTE_ORDER;
+  header.index_size = sizeof(int);
+  header.value_size = sizeof(double);
+  header.arrays_count = count;
+  header.rows_count = A->rows_count;
+  header.nonzeros = nonzeros;
+  header.fingerprint = sp_matrix_yale_pattern_hash(A);
+  pos = sizeof(header);
+  for (i = 0; i < count; ++ i)
+  {
+    header.positions[i] = spb_align(pos);
+    header.sizes[i] = sizes[i];
+    pos = header.positions[i] + sizes[i];
+  }
+  result = fwrite(&header,sizeof(header),1,file) == 1;
+  pos = sizeof(header);
+  for (i = 0; i < count && result; ++ i)
+  {
+    result = spb_pad(file,pos,header.positions[i]) &&
+      fwrite(arrays[i],1,(size_t)sizes[i],file) == (size_t)sizes[i];
+    pos = header.positions[i] + sizes[i];
+  }
+  if (fclose(file) || !result)
+  {
+    LOGERROR("Cannot save file %s",filename);
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Opens the Cholesky decomposition file and checks it was computed
+ * for the matrix A; the arrays shall have the sizes[0..count) bytes.
+ * On success arrays point to the data inside the view
+ */
+static int spc_open(sp_file_view_ptr view,
+                    const char* filename,
+                    const char* magic,
+                    sp_matrix_yale_ptr A,
+                    int* nonzeros,
+                    int count,
+                    const char** arrays,
+                    int64_t* sizes)
+{
+  int i;
+  int n = A->rows_count;
+  spc_header header;
+  if (!sp_file_view_open(view,filename))
+    return 0;
+  if (view->size < sizeof(spc_header) ||
+      memcmp(view->data,magic,sizeof(header.magic)))
   {
-    fgets(buf,HB_LINE_SIZE,file);
-    ptr = (char*)sp_extract_fortran_numbers(buf,
-                                            &indfmt,
-                                            fortran_numbers,
-                                            &extracted);
-    if (ptr == &buf[0])
+    LOGERROR("File %s is not a Cholesky decomposition file",filename);
+    sp_file_view_close(view);
+    return 0;
+  }
+  memcpy(&header,view->data,sizeof(spc_header));
+  if (header.version != SPC_VERSION ||
+      header.byte_order != SPB_BYTE_ORDER ||
+      header.index_size != sizeof(int) ||
+      header.value_size != sizeof(double) ||
+      header.arrays_count != (uint32_t)count ||
+      header.nonzeros < 0 || header.nonzeros > INT_MAX)
+  {
+    LOGERROR("Cholesky decomposition file %s: unsupported version %u, "
+             "byte order or data sizes",filename,header.version);
+    sp_file_view_close(view);
+    return 0;
+  }
+  if (header.rows_count != n ||
+      header.fingerprint != sp_matrix_yale_pattern_hash(A))
+  {
+    LOGERROR("Cholesky decomposition file %s was computed for "
+             "another matrix",filename);
+    sp_file_view_close(view);
+    return 0;
+  }
+  *nonzeros = (int)header.nonzeros;
+  /* sizes depending on nonzeros given as negative element sizes */
+  for (i = 0; i < count; ++ i)
+  {
+    if (sizes[i] < 0)
+      sizes[i] = -sizes[i]*header.nonzeros;
+    if (header.sizes[i] != sizes[i] ||
+        header.positions[i] % SPB_ALIGNMENT ||
+        header.positions[i] < (int64_t)sizeof(spc_header) ||
+        header.positions[i] + sizes[i] > (int64_t)view->size)
     {
-      LOGERROR("Unable to parse row indicies: %s", buf);
-      fclose(file);
-      spfree(fortran_numbers);
-      spfree(colptr);
-      spfree(rowind);
+      LOGERROR("Cholesky decomposition file %s is truncated or corrupted",
+               filename);
+      sp_file_view_close(view);
       return 0;
     }
-    
-    rowind = rowind ? sprealloc(rowind, (n+extracted)*sizeof(int)) :
-      spcalloc(n+extracted, sizeof(int));
-    for (i = n; i < n + extracted; ++ i) 
-      rowind[i] = fortran_numbers[i-n].integer;
-    n += extracted;
-  }
-  spfree(fortran_numbers);
-  if ( n != nnzero)
-  {
-    LOGERROR("Unable to parse row indicies: parsed = %d != "
-             "%d nonzeros", n, nnzero);
-    fclose(file);
-    spfree(colptr);
-    spfree(rowind);
+    arrays[i] = view->data + header.positions[i];
+  }
+  return 1;
+}
+
+int sp_matrix_yale_symbolic_save(sp_chol_symbolic_ptr symb,
+                                 sp_matrix_yale_ptr A,
+                                 const char* filename)
+{
+  int n = A->rows_count;
+  const void* arrays[8];
+  int64_t sizes[8];
+  arrays[0] = symb->etree;        sizes[0] = n*(int64_t)sizeof(int);
+  arrays[1] = symb->post;         sizes[1] = n*(int64_t)sizeof(int);
+  arrays[2] = symb->rowcounts;    sizes[2] = n*(int64_t)sizeof(int);
+  arrays[3] = symb->colcounts;    sizes[3] = n*(int64_t)sizeof(int);
+  arrays[4] = symb->crs_offsets;  sizes[4] = (n+1)*(int64_t)sizeof(int);
+  arrays[5] = symb->crs_indicies;
+  sizes[5] = symb->nonzeros*(int64_t)sizeof(int);
+  arrays[6] = symb->ccs_offsets;  sizes[6] = (n+1)*(int64_t)sizeof(int);
+  arrays[7] = symb->ccs_indicies;
+  sizes[7] = symb->nonzeros*(int64_t)sizeof(int);
+  return spc_write(filename,SPC_MAGIC_SYMBOLIC,A,symb->nonzeros,
+                   8,arrays,sizes);
+}
+
+/*
+ * Checks the symbolic factorization arrays read from the file:
+ * etree parents shall be in [-1,n), post shall be a permutation
+ * of [0,n), the CRS and CCS patterns shall be valid
+ * Returns nonzero if the arrays are valid
+ */
+static int symbolic_arrays_valid(const char** arrays, int n, int nonzeros)
+{
+  const int* etree = (const int*)arrays[0];
+  const int* post = (const int*)arrays[1];
+  char* seen;
+  int i,result = 1;
+  if (!yale_arrays_valid((const int*)arrays[4],(const int*)arrays[5],
+                         n,n,nonzeros,1) ||
+      !yale_arrays_valid((const int*)arrays[6],(const int*)arrays[7],
+                         n,n,nonzeros,1))
+    return 0;
+  seen = spcalloc(n+1,1);
+  for (i = 0; i < n && result; ++ i)
+  {
+    if (etree[i] < -1 || etree[i] >= n ||
+        post[i] < 0 || post[i] >= n || seen[post[i]])
+      result = 0;
+    else
+      seen[post[i]] = 1;
+  }
+  spfree(seen);
+  return result;
+}
+
+int sp_matrix_yale_symbolic_load(sp_chol_symbolic_ptr symb,
+                                 sp_matrix_yale_ptr A,
+                                 const char* filename)
+{
+  int i,n = A->rows_count;
+  sp_file_view view;
+  const char* arrays[8];
+  int64_t sizes[8];
+  int** fields[8];
+  for (i = 0; i < 4; ++ i)
+    sizes[i] = n*(int64_t)sizeof(int);
+  sizes[4] = sizes[6] = (n+1)*(int64_t)sizeof(int);
+  sizes[5] = sizes[7] = -(int64_t)sizeof(int);
+  memset(symb,0,sizeof(sp_chol_symbolic));
+  if (!spc_open(&view,filename,SPC_MAGIC_SYMBOLIC,A,&symb->nonzeros,
+                8,arrays,sizes))
+    return 0;
+  if (!symbolic_arrays_valid(arrays,n,symb->nonzeros))
+  {
+    LOGERROR("Symbolic factorization file %s: wrong elimination tree, "
+             "postorder or pattern",filename);
+    sp_file_view_close(&view);
+    memset(symb,0,sizeof(sp_chol_symbolic));
+    return 0;
+  }
+  fields[0] = &symb->etree;
+  fields[1] = &symb->post;
+  fields[2] = &symb->rowcounts;
+  fields[3] = &symb->colcounts;
+  fields[4] = &symb->crs_offsets;
+  fields[5] = &symb->crs_indicies;
+  fields[6] = &symb->ccs_offsets;
+  fields[7] = &symb->ccs_indicies;
+  for (i = 0; i < 8; ++ i)
+  {
+    *fields[i] = spalloc((size_t)sizes[i]+1);
+    memcpy(*fields[i],arrays[i],(size_t)sizes[i]);
+  }
+  sp_file_view_close(&view);
+  return 1;
+}
+
+int sp_matrix_yale_chol_save(sp_matrix_yale_ptr L,
+                             sp_matrix_yale_ptr A,
+                             const char* filename)
+{
+  const void* arrays[3];
+  int64_t sizes[3];
+  if (L->storage_type != CCS || L->rows_count != A->rows_count)
+  {
+    LOGERROR("Not a Cholesky factor of the matrix");
     return 0;
   }
+  arrays[0] = L->offsets;  sizes[0] = (L->cols_count+1)*(int64_t)sizeof(int);
+  arrays[1] = L->indicies; sizes[1] = L->nonzeros*(int64_t)sizeof(int);
+  arrays[2] = L->values;   sizes[2] = L->nonzeros*(int64_t)sizeof(double);
+  return spc_write(filename,SPC_MAGIC_FACTOR,A,L->nonzeros,3,arrays,sizes);
+}
 
-  /* Section 3. values */
-  fortran_numbers  = spcalloc(valfmt.repeat, sizeof(fortran_number));
-  n = 0;
-  while (valcrd --)
+int sp_matrix_yale_chol_map(sp_matrix_yale_ptr L,
+                            sp_file_view_ptr view,
+                            sp_matrix_yale_ptr A,
+                            int validate,
+                            const char* filename)
+{
+  int n = A->rows_count;
+  const char* arrays[3];
+  int64_t sizes[3];
+  sizes[0] = (n+1)*(int64_t)sizeof(int);
+  sizes[1] = -(int64_t)sizeof(int);
+  sizes[2] = -(int64_t)sizeof(double);
+  memset(L,0,sizeof(sp_matrix_yale));
+  if (!spc_open(view,filename,SPC_MAGIC_FACTOR,A,&L->nonzeros,
+                3,arrays,sizes))
+    return 0;
+  /* the view is read-only, the factor is not modified through these */
+  L->storage_type = CCS;
+  L->rows_count = n;
+  L->cols_count = n;
+  L->offsets = (int*)arrays[0];
+  L->indicies = (int*)arrays[1];
+  L->values = (double*)arrays[2];
+  if (!yale_arrays_valid(L->offsets,L->indicies,n,n,L->nonzeros,validate))
   {
-    fgets(buf,HB_LINE_SIZE,file);
-    ptr = (char*)sp_extract_fortran_numbers(buf,
-                                            &valfmt,
-                                            fortran_numbers,
-                                            &extracted);
-    if (ptr == &buf[0])
+    LOGERROR("Cholesky decomposition file %s: wrong offsets or indicies",
+             filename);
+    sp_file_view_close(view);
+    memset(L,0,sizeof(sp_matrix_yale));
+    return 0;
+  }
+  return 1;
+}
+
+int sp_matrix_yale_chol_load(sp_matrix_yale_ptr L,
+                             sp_matrix_yale_ptr A,
+                             const char* filename)
+{
+  sp_file_view view;
+  sp_matrix_yale mapped;
+  if (!sp_matrix_yale_chol_map(&mapped,&view,A,1,filename))
+    return 0;
+  memcpy(L,&mapped,sizeof(sp_matrix_yale));
+  L->offsets = memdup(mapped.offsets,(mapped.cols_count+1)*sizeof(int));
+  L->indicies = spalloc((mapped.nonzeros+1)*sizeof(int));
+  L->values = spalloc((mapped.nonzeros+1)*sizeof(double));
+  memcpy(L->indicies,mapped.indicies,mapped.nonzeros*sizeof(int));
+  memcpy(L->values,mapped.values,mapped.nonzeros*sizeof(double));
+  sp_file_view_close(&view);
+  return 1;
+}
+
+/*
+ * Load the matrix from the binary file to the allocated arrays
+ * Storage type of the file is kept
+ */
+static int sp_matrix_yale_load_file_spb(sp_matrix_yale_ptr self,
+                                        const char* filename)
+{
+  sp_file_view view;
+  sp_matrix_yale mapped;
+  int n;
+  if (!sp_matrix_yale_map_file(&mapped,&view,1,filename))
+    return 0;
+  n = mapped.storage_type == CRS ? mapped.rows_count : mapped.cols_count;
+  memcpy(self,&mapped,sizeof(sp_matrix_yale));
+  self->offsets = spalloc((n+1)*sizeof(int));
+  self->indicies = spalloc((mapped.nonzeros+1)*sizeof(int));
+  self->values = spalloc((mapped.nonzeros+1)*sizeof(double));
+  memcpy(self->offsets,mapped.offsets,(n+1)*sizeof(int));
+  memcpy(self->indicies,mapped.indicies,mapped.nonzeros*sizeof(int));
+  memcpy(self->values,mapped.values,mapped.nonzeros*sizeof(double));
+  sp_file_view_close(&view);
+  return 1;
+}
+
+/*
+ * Compressed binary format (*.spz): the header followed by the chunks.
+ * Index chunks hold whole lines: for every line its length and the
+ * zigzag-encoded deltas idx - prev - 1 of its indicies as LEB128
+ * varints. Value chunks hold up to SPZ_BLOCK_VALUES values with the bytes
+ * shuffled (all first bytes, then all second bytes...). Every chunk is
+ * compressed with the LZ codec below, or stored as is if not smaller
+ */
+#define SPZ_MAGIC "SPMATRXZ"
+#define SPZ_VERSION 1
+#define SPZ_INDICIES 1
+#define SPZ_VALUES 2
+/* raw size of the index chunk before it is written */
+#define SPZ_BLOCK_SIZE (1 << 19)
+#define SPZ_BLOCK_VALUES (SPZ_BLOCK_SIZE/sizeof(double))
+/* maximum size of one varint-encoded int */
+#define VARINT_MAX 5
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t storage_type;
+  uint32_t properties;
+  int64_t rows_count;
+  int64_t cols_count;
+  int64_t nonzeros;
+} spz_header;
+
+typedef struct
+{
+  uint32_t kind;                /* SPZ_INDICIES or SPZ_VALUES */
+  uint32_t count;               /* number of lines or values */
+  uint32_t raw_size;            /* size of the decoded data */
+  uint32_t stored_size;         /* size in file, raw_size if stored as is */
+} spz_chunk;
+
+/*
+ * LZ77 codec in the spirit of LZ4: sequences of the token byte
+ * (literals count << 4 | match length - LZ_MIN_MATCH), extra literal
+ * count bytes, literals, 2-byte offset and extra match length bytes.
+ * Counts of 15 in the token continue by the bytes until one is < 255.
+ * The last sequence has literals only
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_MAX_OFFSET 65535
+/* one compressed byte decodes to at most this number of bytes */
+#define LZ_MAX_EXPANSION 255
+
+static uint32_t lz_hash(const unsigned char* p)
+{
+  uint32_t v;
+  memcpy(&v,p,sizeof(v));
+  return (v*2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static unsigned char* lz_put_count(unsigned char* out, size_t count)
+{
+  for (; count >= 255; count -= 255)
+    *out++ = 255;
+  *out++ = (unsigned char)count;
+  return out;
+}
+
+/*
+ * Writes literals [anchor,ip) and the match (offset,length) if length
+ * is nonzero. Returns the new output pointer or 0 if out of capacity
+ */
+static unsigned char* lz_put_sequence(unsigned char* op,
+                                      unsigned char* op_end,
+                                      const unsigned char* anchor,
+                                      const unsigned char* ip,
+                                      size_t offset,
+                                      size_t length)
+{
+  size_t literals = (size_t)(ip - anchor);
+  size_t match = length ? length - LZ_MIN_MATCH : 0;
+  if ((size_t)(op_end - op) < 1 + literals + literals/255 + 1 + 2 +
+      match/255 + 1)
+    return 0;
+  *op++ = (unsigned char)(((literals < 15 ? literals : 15) << 4) |
+                          (match < 15 ? match : 15));
+  if (literals >= 15)
+    op = lz_put_count(op,literals - 15);
+  memcpy(op,anchor,literals);
+  op += literals;
+  if (length)
+  {
+    *op++ = (unsigned char)(offset & 0xff);
+    *op++ = (unsigned char)(offset >> 8);
+    if (match >= 15)
+      op = lz_put_count(op,match - 15);
+  }
+  return op;
+}
+
+/*
+ * Compresses size bytes of src to dst
+ * Returns the compressed size or 0 if it doesn't fit to capacity
+ */
+static size_t lz_compress(const unsigned char* src,
+                          size_t size,
+                          unsigned char* dst,
+                          size_t capacity)
+{
+  const unsigned char* ip = src;
+  const unsigned char* anchor = src;
+  const unsigned char* end = src + size;
+  const unsigned char* ref;
+  unsigned char* op = dst;
+  size_t length;
+  uint32_t h;
+  size_t* table = spcalloc((size_t)1 << LZ_HASH_BITS,sizeof(size_t));
+  while (op && ip + LZ_MIN_MATCH <= end)
+  {
+    h = lz_hash(ip);
+    ref = table[h] ? src + table[h] - 1 : 0;
+    table[h] = (size_t)(ip - src) + 1;
+    if (!ref || ip - ref > LZ_MAX_OFFSET || memcmp(ref,ip,LZ_MIN_MATCH))
     {
-      LOGERROR("Unable to parse values: %s", buf);
-      fclose(file);
-      spfree(fortran_numbers);
-      spfree(colptr);
-      spfree(rowind);
-      spfree(values);
+      ip++;
+      continue;
+    }
+    for (length = LZ_MIN_MATCH; ip + length < end && ref[length] == ip[length];
+         ++ length);
+    op = lz_put_sequence(op,dst + capacity,anchor,ip,ip - ref,length);
+    ip += length;
+    anchor = ip;
+  }
+  if (op)
+    op = lz_put_sequence(op,dst + capacity,anchor,end,0,0);
+  spfree(table);
+  return op ? (size_t)(op - dst) : 0;
+}
+
+/* Reads the count continued after the token, returns 0 on error */
+static const unsigned char* lz_get_count(const unsigned char* ip,
+                                         const unsigned char* end,
+                                         size_t* count)
+{
+  unsigned char b;
+  do
+  {
+    if (ip == end)
+      return 0;
+    b = *ip++;
+    *count += b;
+  } while (b == 255);
+  return ip;
+}
+
+/*
+ * Decompresses size bytes of src to exactly raw bytes of dst
+ * Returns nonzero if successfull
+ */
+static int lz_decompress(const unsigned char* src,
+                         size_t size,
+                         unsigned char* dst,
+                         size_t raw)
+{
+  const unsigned char* ip = src;
+  const unsigned char* end = src + size;
+  unsigned char* op = dst;
+  unsigned char* op_end = dst + raw;
+  size_t literals,length,offset,i;
+  unsigned char token;
+  while (ip < end)
+  {
+    token = *ip++;
+    literals = token >> 4;
+    if (literals == 15 && !(ip = lz_get_count(ip,end,&literals)))
+      return 0;
+    if (literals > (size_t)(end - ip) || literals > (size_t)(op_end - op))
+      return 0;
+    memcpy(op,ip,literals);
+    op += literals;
+    ip += literals;
+    if (ip == end)
+      break;                    /* last sequence */
+    if (end - ip < 2)
       return 0;
+    offset = ip[0] | (size_t)ip[1] << 8;
+    ip += 2;
+    length = token & 15;
+    if (length == 15 && !(ip = lz_get_count(ip,end,&length)))
+      return 0;
+    length += LZ_MIN_MATCH;
+    if (!offset || offset > (size_t)(op - dst) ||
+        length > (size_t)(op_end - op))
+      return 0;
+    if (offset >= length)
+      memcpy(op,op - offset,length);
+    else                        /* overlapping match repeats the pattern */
+      for (i = 0; i < length; ++ i)
+        op[i] = op[i - offset];
+    op += length;
+  }
+  return op == op_end;
+}
+
+static unsigned char* varint_put(unsigned char* out, uint32_t v)
+{
+  for (; v >= 0x80; v >>= 7)
+    *out++ = (unsigned char)(v | 0x80);
+  *out++ = (unsigned char)v;
+  return out;
+}
+
+/* Returns the pointer after the varint or 0 on error */
+static const unsigned char* varint_get(const unsigned char* in,
+                                       const unsigned char* end,
+                                       uint32_t* v)
+{
+  int shift;
+  *v = 0;
+  for (shift = 0; in < end && shift < 7*VARINT_MAX; shift += 7)
+  {
+    *v |= (uint32_t)(*in & 0x7f) << shift;
+    if (!(*in++ & 0x80))
+      return in;
+  }
+  return 0;
+}
+
+/*
+ * Writes the chunk of raw_size bytes of data compressing it if possible;
+ * buffer - work array of raw_size bytes
+ */
+static int spz_put_chunk(FILE* file,
+                         uint32_t kind,
+                         uint32_t count,
+                         const unsigned char* data,
+                         size_t raw_size,
+                         unsigned char* buffer)
+{
+  spz_chunk chunk;
+  size_t stored = raw_size > 1 ? lz_compress(data,raw_size,buffer,
+                                             raw_size - 1) : 0;
+  chunk.kind = kind;
+  chunk.count = count;
+  chunk.raw_size = (uint32_t)raw_size;
+  chunk.stored_size = (uint32_t)(stored ? stored : raw_size);
+  return fwrite(&chunk,sizeof(chunk),1,file) == 1 &&
+    fwrite(stored ? buffer : data,1,chunk.stored_size,file) ==
+    chunk.stored_size;
+}
+
+static
+int sp_matrix_yale_save_file_spz(sp_matrix_yale_ptr self,
+                                 const char* filename,
+                                 matrix_properties props)
+{
+  int i,p,lines = 0,prev,result = 1;
+  uint32_t delta;
+  int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  size_t size = 0,capacity = SPZ_BLOCK_SIZE,b,k;
+  unsigned char* raw = spalloc(capacity);
+  unsigned char* buffer = spalloc(capacity);
+  spz_header header;
+  FILE* file = fopen(filename,"wb");
+  if (!file)
+  {
+    LOGERROR("Error opening file %s for writing",filename);
+    spfree(raw);
+    spfree(buffer);
+    return 0;
+  }
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,SPZ_MAGIC,sizeof(header.magic));
+  header.version = SPZ_VERSION;
+  header.byte_order = SPB_BYTE_ORDER;
+  header.storage_type = self->storage_type;
+  header.properties = props;
+  header.rows_count = self->rows_count;
+  header.cols_count = self->cols_count;
+  header.nonzeros = self->nonzeros;
+  result = fwrite(&header,sizeof(header),1,file) == 1;
+  /* indicies, by the whole lines */
+  for (i = 0; i < n && result; ++ i)
+  {
+    k = (size_t)(self->offsets[i+1] - self->offsets[i] + 1)*VARINT_MAX;
+    if (size + k > capacity)
+    {
+      capacity = size + k > 2*capacity ? size + k : 2*capacity;
+      raw = sprealloc(raw,capacity);
+      buffer = sprealloc(buffer,capacity);
     }
-    
-    values = values ? sprealloc(values, (n+extracted)*sizeof(double)) :
-      spcalloc(n+extracted, sizeof(double));
-    for (i = n; i < n + extracted; ++ i) 
-      values[i] = fortran_numbers[i-n].real;
-    n += extracted;
-  }
-  spfree(fortran_numbers);
-  fclose(file);
-  if ( n != nnzero)
+    size = varint_put(raw + size,self->offsets[i+1] - self->offsets[i]) - raw;
+    for (p = self->offsets[i], prev = -1; p < self->offsets[i+1]; ++ p)
+    {
+      /* zigzag keeps unsorted lines encodable */
+      delta = (uint32_t)(self->indicies[p] - prev - 1);
+      delta = (delta << 1) ^ (uint32_t)-(int32_t)(delta >> 31);
+      size = varint_put(raw + size,delta) - raw;
+      prev = self->indicies[p];
+    }
+    lines++;
+    if (size >= SPZ_BLOCK_SIZE || i == n - 1)
+    {
+      result = spz_put_chunk(file,SPZ_INDICIES,lines,raw,size,buffer);
+      size = 0;
+      lines = 0;
+    }
+  }
+  /* values, byte-shuffled */
+  for (p = 0; p < self->nonzeros && result; p += SPZ_BLOCK_VALUES)
   {
-    LOGERROR("Unable to parse values: parsed = %d != "
-            "%d nonzeros", n, nnzero);
-    spfree(colptr);
-    spfree(rowind);
-    spfree(values);
+    k = self->nonzeros - p < (int)SPZ_BLOCK_VALUES ?
+      (size_t)(self->nonzeros - p) : SPZ_BLOCK_VALUES;
+    for (b = 0; b < sizeof(double); ++ b)
+      for (i = 0; i < (int)k; ++ i)
+        raw[b*k + i] = ((const unsigned char*)(self->values + p + i))[b];
+    result = spz_put_chunk(file,SPZ_VALUES,(uint32_t)k,raw,
+                           k*sizeof(double),buffer);
+  }
+  spfree(raw);
+  spfree(buffer);
+  if (fclose(file) || !result)
+  {
+    LOGERROR("Cannot save file %s",filename);
     return 0;
   }
-  LOGINFO("So far HB file %s parsed successfully",filename);
-  /* all indicies are 1 based in HB format */
-  for ( i = 0; i < ncol+1; ++ i)
-    colptr[i]--;
-  for ( i = 0; i < nnzero; ++ i)
+  return 1;
+}
+
+/*
+ * Decodes the index chunk to the matrix
+ * line, pos - current line and index position, updated
+ */
+static int spz_decode_indicies(sp_matrix_yale_ptr self,
+                               int n,
+                               const unsigned char* in,
+                               const unsigned char* end,
+                               uint32_t count,
+                               int* line,
+                               int* pos)
+{
+  uint32_t length,delta,k,l;
+  int prev;
+  int m = self->storage_type == CRS ? self->cols_count : self->rows_count;
+  if (count > (uint32_t)(n - *line))
+    return 0;
+  for (l = 0; l < count; ++ l)
   {
-    rowind[i]--;
-    assert(rowind[i] < nrow);
+    if (!(in = varint_get(in,end,&length)) ||
+        length > (uint32_t)(self->nonzeros - *pos))
+      return 0;
+    for (k = 0, prev = -1; k < length; ++ k)
+    {
+      if (!(in = varint_get(in,end,&delta)))
+        return 0;
+      delta = (delta >> 1) ^ (uint32_t)-(int32_t)(delta & 1);
+      prev = (int)((uint32_t)prev + delta + 1);
+      if (prev < 0 || prev >= m)
+        return 0;
+      self->indicies[(*pos)++] = prev;
+    }
+    self->offsets[++(*line)] = *pos;
   }
+  return in == end;
+}
 
-  if (props == PROP_GENERAL)
+/*
+ * Load the matrix from the compressed binary file, the chunks are
+ * read and decoded one by one straight to the matrix arrays
+ * Storage type of the file is kept
+ */
+static int sp_matrix_yale_load_file_spz(sp_matrix_yale_ptr self,
+                                        const char* filename)
+{
+  int n, result = 1, line = 0, pos = 0, values = 0;
+  size_t b,i,capacity = SPZ_BLOCK_SIZE;
+  long size;
+  spz_header header;
+  spz_chunk chunk;
+  unsigned char* stored;
+  unsigned char* raw;
+  unsigned char* data;
+  FILE* file = fopen(filename,"rb");
+  if (!file)
   {
-    self->rows_count = nrow;
-    self->cols_count = ncol;
-    self->nonzeros   = nnzero;
-    self->storage_type = CCS;
-    self->offsets = colptr;
-    self->indicies = rowind;
-    self->values = values;
+    LOGERROR("Cannot read file %s", filename);
+    return 0;
+  }
+  if (fread(&header,sizeof(header),1,file) != 1 ||
+      memcmp(header.magic,SPZ_MAGIC,sizeof(header.magic)) ||
+      header.version != SPZ_VERSION || header.byte_order != SPB_BYTE_ORDER ||
+      (header.storage_type != CRS && header.storage_type != CCS) ||
+      header.rows_count < 0 || header.rows_count > INT_MAX ||
+      header.cols_count < 0 || header.cols_count > INT_MAX ||
+      header.nonzeros < 0 || header.nonzeros > INT_MAX)
+  {
+    LOGERROR("File %s is not a supported compressed matrix file",filename);
+    fclose(file);
+    return 0;
   }
-  else                          /* symmetric and skew-symmetic */
+  if (fseek(file,0,SEEK_END) || (size = ftell(file)) < 0 ||
+      fseek(file,sizeof(header),SEEK_SET))
   {
-    /* easiest way is to construct the new matrix, since for
-     * the symmetric and skew-symmetric matricies only one half of
-     * elements stored
-     */
-    /* bandwidth */
-    n = nnzero/ncol + 1;
-    sp_matrix_init(&mtx,nrow,ncol,n+1,CCS);
-    for (i = 0; i < ncol; ++ i)
+    LOGERROR("Cannot determine size of the file %s", filename);
+    fclose(file);
+    return 0;
+  }
+  /*
+   * every line and index takes at least one byte and every value 8 bytes
+   * decoded, don't allocate more than the rest of the file can hold
+   */
+  if ((uint64_t)(header.storage_type == CRS ?
+                 header.rows_count : header.cols_count) +
+      (sizeof(double)+1)*(uint64_t)header.nonzeros >
+      (uint64_t)(size - (long)sizeof(header))*LZ_MAX_EXPANSION)
+  {
+    LOGERROR("Compressed matrix file %s is truncated or corrupted",filename);
+    fclose(file);
+    return 0;
+  }
+  memset(self,0,sizeof(sp_matrix_yale));
+  self->storage_type = (sparse_storage_type)header.storage_type;
+  self->rows_count = (int)header.rows_count;
+  self->cols_count = (int)header.cols_count;
+  self->nonzeros = (int)header.nonzeros;
+  n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  self->offsets = spcalloc(n+1,sizeof(int));
+  self->indicies = spalloc((self->nonzeros+1)*sizeof(int));
+  self->values = spalloc((self->nonzeros+1)*sizeof(double));
+  stored = spalloc(capacity);
+  raw = spalloc(capacity);
+  while (result && (line < n || values < self->nonzeros))
+  {
+    if (fread(&chunk,sizeof(chunk),1,file) != 1 ||
+        chunk.stored_size > chunk.raw_size ||
+        chunk.raw_size > (size_t)VARINT_MAX*(n + self->nonzeros) +
+        sizeof(double)*SPZ_BLOCK_VALUES)
+    {
+      result = 0;
+      break;
+    }
+    if (chunk.raw_size > capacity)
+    {
+      capacity = chunk.raw_size;
+      stored = sprealloc(stored,capacity);
+      raw = sprealloc(raw,capacity);
+    }
+    if (fread(stored,1,chunk.stored_size,file) != chunk.stored_size)
+    {
+      result = 0;
+      break;
+    }
+    data = stored;
+    if (chunk.stored_size < chunk.raw_size)
+    {
+      result = lz_decompress(stored,chunk.stored_size,raw,chunk.raw_size);
+      data = raw;
+    }
+    if (result && chunk.kind == SPZ_INDICIES)
+      result = spz_decode_indicies(self,n,data,data + chunk.raw_size,
+                                   chunk.count,&line,&pos);
+    else if (result && chunk.kind == SPZ_VALUES &&
+             chunk.count <= (uint32_t)(self->nonzeros - values) &&
+             chunk.raw_size == chunk.count*sizeof(double))
     {
-      for (p = colptr[i]; p < colptr[i+1]; ++ p)
-      {
-        j = rowind[p];
-        assert(j < nrow);
-        MTX(&mtx,j,i,values[p]);
-        if (i != j)
-          MTX(&mtx,i,j,(props == PROP_SYMMETRIC ? values[p] : -values[p]));
-      }
+      for (b = 0; b < sizeof(double); ++ b)
+        for (i = 0; i < chunk.count; ++ i)
+          ((unsigned char*)(self->values + values + i))[b] =
+            data[b*chunk.count + i];
+      values += chunk.count;
     }
-    sp_matrix_yale_init(self,&mtx);
-    sp_matrix_free(&mtx);
-    spfree(colptr);
-    spfree(rowind);
-    spfree(values);
+    else
+      result = 0;
+  }
+  fclose(file);
+  spfree(stored);
+  spfree(raw);
+  if (!result || pos != self->nonzeros)
+  {
+    LOGERROR("Compressed matrix file %s is truncated or corrupted",filename);
+    sp_matrix_yale_free(self);
+    return 0;
   }
-  /*  */
   return 1;
 }
 
@@ -697,12 +2188,18 @@ int sp_matrix_yale_load_file(sp_matrix_yale_ptr self,
   }
   if ( !sp_istrcmp(ext,"mtx") )
     return sp_matrix_yale_load_file_mm(self, filename,type);
+  else if ( !sp_istrcmp(ext,"txt") )
+    return sp_matrix_yale_load_file_txt(self, filename,type);
+  else if ( !sp_istrcmp(ext,"spb") )
+    return sp_matrix_yale_load_file_spb(self, filename);
+  else if ( !sp_istrcmp(ext,"spz") )
+    return sp_matrix_yale_load_file_spz(self, filename);
   else if (!sp_istrcmp(ext,"hb") ||
            !sp_istrcmp(ext,"rua") ||
            !sp_istrcmp(ext,"rsa") ||
            !sp_istrcmp(ext,"rza") ||
            !sp_istrcmp(ext,"rra"))
-    return sp_matrix_yale_load_file_hb(self, filename);
+    return sp_matrix_yale_load_file_hb(self, 0, filename);
   else
     LOGERROR("File type is not supported: *.%s", ext);
 
@@ -710,6 +2207,44 @@ int sp_matrix_yale_load_file(sp_matrix_yale_ptr self,
 }
 
 
+int sp_matrix_yale_load_file_vectors(sp_matrix_yale_ptr self,
+                                     sp_matrix_vectors_ptr vectors,
+                                     const char* filename,
+                                     sparse_storage_type type)
+{
+  const char* ext = sp_parse_file_extension(filename);
+  memset(vectors,0,sizeof(sp_matrix_vectors));
+  if (ext && (!sp_istrcmp(ext,"hb") ||
+              !sp_istrcmp(ext,"rua") ||
+              !sp_istrcmp(ext,"rsa") ||
+              !sp_istrcmp(ext,"rza") ||
+              !sp_istrcmp(ext,"rra")))
+    return sp_matrix_yale_load_file_hb(self,vectors,filename);
+  if (!sp_matrix_yale_load_file(self,filename,type))
+    return 0;
+  vectors->rows = self->rows_count;
+  if (!sp_istrcmp(ext,"mtx") &&
+      (!mm_load_companion(vectors,filename,"_b",&vectors->rhs) ||
+       !mm_load_companion(vectors,filename,"_x",&vectors->solution)))
+  {
+    sp_matrix_vectors_free(vectors);
+    sp_matrix_yale_free(self);
+    return 0;
+  }
+  return 1;
+}
+
+void sp_matrix_vectors_free(sp_matrix_vectors_ptr self)
+{
+  if (self->rhs)
+    spfree(self->rhs);
+  if (self->guess)
+    spfree(self->guess);
+  if (self->solution)
+    spfree(self->solution);
+  memset(self,0,sizeof(sp_matrix_vectors));
+}
+
 static int sp_matrix_save_file_triplet(sp_matrix_ptr self,
                                        FILE* file,
                                        int matrix_type,
@@ -913,9 +2448,23 @@ static supported_format guess_export_format(const char* filename)
     return FMT_TXT;
   else if ( !sp_istrcmp(ext, "dat") )
     return FMT_DAT;
+  else if ( !sp_istrcmp(ext, "spb") )
+    return FMT_SPB;
+  else if ( !sp_istrcmp(ext, "spz") )
+    return FMT_SPZ;
   return FMT_UNSUPPORTED;
 }
 
+/* Binary formats keep the compressed arrays, so convert first */
+static int sp_matrix_save_file_yale(sp_matrix_ptr self, const char* filename)
+{
+  int result;
+  sp_matrix_yale yale;
+  sp_matrix_yale_init(&yale,self);
+  result = sp_matrix_yale_save_file(&yale,filename);
+  sp_matrix_yale_free(&yale);
+  return result;
+}
 
 int sp_matrix_save_file(sp_matrix_ptr self, const char* filename)
 {
@@ -925,6 +2474,8 @@ int sp_matrix_save_file(sp_matrix_ptr self, const char* filename)
   case FMT_MM:  return sp_matrix_save_file_mm(self,filename);
   case FMT_TXT: return sp_matrix_save_file_txt(self,filename);
   case FMT_DAT: return sp_matrix_save_file_dat(self,filename);
+  case FMT_SPB:
+  case FMT_SPZ: return sp_matrix_save_file_yale(self,filename);
   case FMT_UNSUPPORTED:
   default:
     break;
@@ -932,59 +2483,126 @@ int sp_matrix_save_file(sp_matrix_ptr self, const char* filename)
   return 0;
 }
 
-static int sp_matrix_yale_save_file_triplet(sp_matrix_yale_ptr self,
-                                            FILE* file,
-                                            int matrix_type,
-                                            int base)
+/* Number of elements formatted by one task of the triplet writer */
+#define WRITE_CHUNK_SIZE 65536
+/* Maximum length of the triplet line: 2 integers, value, separators */
+#define TRIPLET_LINE_SIZE (2*12 + SP_DTOA_SIZE + 3)
+
+/*
+ * Formats the elements of the lines [begin,end) of the matrix as
+ * triplets "row col value", returns the number of characters written
+ */
+static size_t format_triplets(sp_matrix_yale_ptr self,
+                              int begin,
+                              int end,
+                              int matrix_type,
+                              int base,
+                              char* out)
 {
-  int result = 1;
-  int i,p,n,size;
+  char* ptr = out;
+  int i,p,row,col;
   double value;
-  char buf[64];
-  
-  n = self->storage_type == CRS ? self->rows_count : self->cols_count;
-  
-  /* write elements */
-  for ( i = 0; i < n; ++ i)
+  for (i = begin; i < end; ++ i)
   {
-    for ( p = self->offsets[i]; p < self->offsets[i+1]; ++ p )
+    for (p = self->offsets[i]; p < self->offsets[i+1]; ++ p)
     {
       if (matrix_type != MM_GENERAL && self->indicies[p] > i)
-      {
         break;
-      }
-      if (self->storage_type == CRS)
-        size = sprintf(buf,"%d %d %.16e\n",i+base,
-                       self->indicies[p]+base,
-                       self->values[p]);
-      else                      /* CCS */
+      row = i;
+      col = self->indicies[p];
+      value = self->values[p];
+      if (self->storage_type == CCS)
       {
-        value = self->values[p];
         /* lower triangle = -upper triangle for skew symmetic matix */
         if (matrix_type == MM_SKEW_SYMMETRIC)
           value = -value;
         if (matrix_type == MM_GENERAL)
-          size = sprintf(buf,"%d %d %.16e\n",self->indicies[p]+base,
-                         i+base,
-                         value);
-        else                    /* transposed */
-          size = sprintf(buf,"%d %d %.16e\n",i+base,
-                         self->indicies[p]+base,
-                         value);
+        {
+          row = self->indicies[p];
+          col = i;
+        }
+      }
+      ptr += sp_itoa(row+base,ptr);
+      *ptr++ = ' ';
+      ptr += sp_itoa(col+base,ptr);
+      *ptr++ = ' ';
+      ptr += sp_dtoa(value,ptr);
+      *ptr++ = '\n';
+    }
+  }
+  return (size_t)(ptr - out);
+}
+
+/*
+ * Writes the elements as triplets. The lines are split to the chunks
+ * of about WRITE_CHUNK_SIZE elements formatted in parallel to own
+ * buffers, the buffers are written in order
+ */
+static int sp_matrix_yale_save_file_triplet(sp_matrix_yale_ptr self,
+                                            FILE* file,
+                                            int matrix_type,
+                                            int base)
+{
+  int result = 1;
+  int i,k,c,last,chunks = 0,count = 0;
+  int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  int batch = sp_par_max_threads();
+  int* bounds = spalloc((self->nonzeros/WRITE_CHUNK_SIZE + 2)*sizeof(int));
+  char** buffers = spcalloc(batch,sizeof(char*));
+  size_t* capacities = spcalloc(batch,sizeof(size_t));
+  size_t* sizes = spcalloc(batch,sizeof(size_t));
+  size_t need;
+
+  bounds[0] = 0;
+  for (i = 0; i < n; ++ i)
+  {
+    count += self->offsets[i+1] - self->offsets[i];
+    if (count >= WRITE_CHUNK_SIZE || i == n - 1)
+    {
+      bounds[++chunks] = i + 1;
+      count = 0;
+    }
+  }
+  for (c = 0; c < chunks && result; c += batch)
+  {
+    last = c + batch < chunks ? c + batch : chunks;
+    for (k = c; k < last; ++ k)
+    {
+      need = (size_t)(self->offsets[bounds[k+1]] - self->offsets[bounds[k]])*
+        TRIPLET_LINE_SIZE + 1;
+      if (need > capacities[k-c])
+      {
+        if (buffers[k-c])
+          spfree(buffers[k-c]);
+        buffers[k-c] = spalloc(need);
+        capacities[k-c] = need;
       }
-      fwrite(buf,1,size,file);
     }
+    SP_PRAGMA(omp parallel for schedule(dynamic,1))
+    for (k = c; k < last; ++ k)
+      sizes[k-c] = format_triplets(self,bounds[k],bounds[k+1],
+                                   matrix_type,base,buffers[k-c]);
+    for (k = c; k < last && result; ++ k)
+      result = fwrite(buffers[k-c],1,sizes[k-c],file) == sizes[k-c];
   }
+  for (k = 0; k < batch; ++ k)
+    if (buffers[k])
+      spfree(buffers[k]);
+  spfree(buffers);
+  spfree(capacities);
+  spfree(sizes);
+  spfree(bounds);
   return result;
 }
 
 static
-int sp_matrix_yale_save_file_mm(sp_matrix_yale_ptr self,const char* filename)
+int sp_matrix_yale_save_file_mm(sp_matrix_yale_ptr self,
+                                const char* filename,
+                                matrix_properties props)
 {
   int result = 1;
   FILE* file = fopen(filename,"wt+");
   int matrix_type;
-  matrix_properties props;
   int i,j,p,n,nonzeros;
   int size;
   /* MM format limitation for the line is 1024 characters */
@@ -997,7 +2615,6 @@ int sp_matrix_yale_save_file_mm(sp_matrix_yale_ptr self,const char* filename)
 
   n = self->storage_type == CRS ? self->rows_count : self->cols_count;
   
-  props = sp_matrix_yale_properites(self);
   switch (props)
   {
   case PROP_SYMMETRIC:
@@ -1120,14 +2737,64 @@ int sp_matrix_yale_save_file_dat(sp_matrix_yale_ptr self,const char* filename)
   return result;
 }
 
+static
+int sp_matrix_yale_save_file_spb(sp_matrix_yale_ptr self,
+                                 const char* filename,
+                                 matrix_properties props)
+{
+  int result;
+  int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  spb_header header;
+  FILE* file = fopen(filename,"wb");
+  if (!file)
+  {
+    LOGERROR("Error opening file %s for writing",filename);
+    return 0;
+  }
+  spb_init_header(&header,self->storage_type,self->rows_count,
+                  self->cols_count,self->nonzeros,props);
+  result =
+    fwrite(&header,sizeof(header),1,file) == 1 &&
+    spb_pad(file,sizeof(header),header.offsets_pos) &&
+    fwrite(self->offsets,sizeof(int),n+1,file) == (size_t)(n+1) &&
+    spb_pad(file,header.offsets_pos + (n+1)*(int64_t)sizeof(int),
+            header.indicies_pos) &&
+    fwrite(self->indicies,sizeof(int),self->nonzeros,file) ==
+    (size_t)self->nonzeros &&
+    spb_pad(file,header.indicies_pos + self->nonzeros*(int64_t)sizeof(int),
+            header.values_pos) &&
+    fwrite(self->values,sizeof(double),self->nonzeros,file) ==
+    (size_t)self->nonzeros;
+  if (fclose(file) || !result)
+  {
+    LOGERROR("Cannot save file %s",filename);
+    return 0;
+  }
+  return 1;
+}
+
 int sp_matrix_yale_save_file(sp_matrix_yale_ptr self, const char* filename)
+{
+  supported_format fmt = guess_export_format(filename);
+  /* triplet formats without header don't need the properties */
+  if (fmt == FMT_TXT || fmt == FMT_DAT)
+    return sp_matrix_yale_save_file_props(self,filename,PROP_GENERAL);
+  return sp_matrix_yale_save_file_props(self,filename,
+                                        sp_matrix_yale_properites(self));
+}
+
+int sp_matrix_yale_save_file_props(sp_matrix_yale_ptr self,
+                                   const char* filename,
+                                   matrix_properties props)
 {
   supported_format fmt = guess_export_format(filename);
   switch(fmt)
   {
-  case FMT_MM:  return sp_matrix_yale_save_file_mm(self,filename);
+  case FMT_MM:  return sp_matrix_yale_save_file_mm(self,filename,props);
   case FMT_TXT: return sp_matrix_yale_save_file_txt(self,filename);
   case FMT_DAT: return sp_matrix_yale_save_file_dat(self,filename);
+  case FMT_SPB: return sp_matrix_yale_save_file_spb(self,filename,props);
+  case FMT_SPZ: return sp_matrix_yale_save_file_spz(self,filename,props);
   case FMT_UNSUPPORTED:
   default:
     break;
@@ -1135,10 +2802,180 @@ int sp_matrix_yale_save_file(sp_matrix_yale_ptr self, const char* filename)
   return 0;
 }
 
+/* Element sizes of the vector types */
+static size_t spv_type_size(sp_vector_type type)
+{
+  switch (type)
+  {
+  case SP_VECTOR_INT: return sizeof(int);
+  case SP_VECTOR_DOUBLE: return sizeof(double);
+  default: break;
+  }
+  return 0;
+}
+
+int sp_save_vectors(const void* data,
+                    sp_vector_type type,
+                    int length,
+                    int count,
+                    int checksum,
+                    const char* fname)
+{
+  int result;
+  spv_header header;
+  size_t size;
+  FILE* file;
+  if (!spv_type_size(type) || length < 0 || count < 0 ||
+      (length > 0 && (size_t)count > SIZE_MAX/spv_type_size(type)/length))
+  {
+    LOGERROR("Wrong vector type or sizes");
+    return 0;
+  }
+  size = (size_t)length*count*spv_type_size(type);
+  file = fopen(fname,"wb");
+  if (!file)
+  {
+    LOGERROR("Error opening file %s for writing",fname);
+    return 0;
+  }
+  memset(&header,0,sizeof(header));
+  memcpy(header.magic,SPV_MAGIC,sizeof(header.magic));
+  header.version = SPV_VERSION;
+  header.byte_order = SPB_BYTE_ORDER;
+  header.type = type;
+  header.flags = checksum ? SPV_CHECKSUM : 0;
+  header.length = length;
+  header.count = count;
+  header.checksum = checksum ? sp_fnv1a(SP_FNV_OFFSET_BASIS,data,size) : 0;
+  result = fwrite(&header,sizeof(header),1,file) == 1 &&
+    spb_pad(file,sizeof(header),spb_align(sizeof(header))) &&
+    fwrite(data,1,size,file) == size;
+  if (fclose(file) || !result)
+  {
+    LOGERROR("Cannot save file %s",fname);
+    return 0;
+  }
+  return 1;
+}
+
+int sp_map_vectors(const void** data,
+                   sp_file_view_ptr view,
+                   sp_vector_type* type,
+                   int* length,
+                   int* count,
+                   int verify,
+                   const char* fname)
+{
+  spv_header header;
+  int64_t size;
+  if (!sp_file_view_open(view,fname))
+    return 0;
+  if (view->size < sizeof(header) ||
+      memcmp(view->data,SPV_MAGIC,sizeof(header.magic)))
+  {
+    LOGERROR("File %s is not a binary vector file",fname);
+    sp_file_view_close(view);
+    return 0;
+  }
+  memcpy(&header,view->data,sizeof(header));
+  if (header.version != SPV_VERSION || header.byte_order != SPB_BYTE_ORDER ||
+      !spv_type_size((sp_vector_type)header.type) ||
+      header.length < 0 || header.length > INT_MAX ||
+      header.count < 0 || header.count > INT_MAX ||
+      (header.length > 0 && header.count >
+       (int64_t)(INT64_MAX/spv_type_size((sp_vector_type)header.type))/
+       header.length))
+  {
+    LOGERROR("Binary vector file %s: unsupported version %u, "
+             "byte order, type or sizes",fname,header.version);
+    sp_file_view_close(view);
+    return 0;
+  }
+  size = header.length*header.count*
+    (int64_t)spv_type_size((sp_vector_type)header.type);
+  if (size > (int64_t)view->size - spb_align(sizeof(header)))
+  {
+    LOGERROR("Binary vector file %s is truncated",fname);
+    sp_file_view_close(view);
+    return 0;
+  }
+  *data = view->data + spb_align(sizeof(header));
+  if (verify && (header.flags & SPV_CHECKSUM) &&
+      sp_fnv1a(SP_FNV_OFFSET_BASIS,*data,(size_t)size) != header.checksum)
+  {
+    LOGERROR("Binary vector file %s: checksum mismatch",fname);
+    sp_file_view_close(view);
+    return 0;
+  }
+  *type = (sp_vector_type)header.type;
+  *length = (int)header.length;
+  *count = (int)header.count;
+  return 1;
+}
+
+int sp_load_vectors(void** data,
+                    sp_vector_type* type,
+                    int* length,
+                    int* count,
+                    const char* fname)
+{
+  sp_file_view view;
+  const void* mapped;
+  size_t size;
+  if (!sp_map_vectors(&mapped,&view,type,length,count,1,fname))
+    return 0;
+  size = (size_t)*length*(*count)*spv_type_size(*type);
+  *data = spalloc(size+1);
+  memcpy(*data,mapped,size);
+  sp_file_view_close(&view);
+  return 1;
+}
+
+/* Checks if the vector file name has the binary vector extension */
+static int spv_is_binary(const char* fname)
+{
+  const char* ext = sp_parse_file_extension(fname);
+  return ext && !sp_istrcmp(ext,"spv");
+}
+
+/* Loads the vector(s) of the given type from the binary file */
+static int spv_load_typed(void** v,
+                          sp_vector_type type,
+                          int* size,
+                          const char* fname)
+{
+  sp_vector_type loaded;
+  int length,count;
+  if (!sp_load_vectors(v,&loaded,&length,&count,fname))
+    return 0;
+  if (loaded != type)
+  {
+    LOGERROR("Binary vector file %s has another element type",fname);
+    spfree(*v);
+    *v = 0;
+    return 0;
+  }
+  if (length > 0 && count > INT_MAX/length)
+  {
+    LOGERROR("Binary vector file %s is too large for one vector",fname);
+    spfree(*v);
+    *v = 0;
+    return 0;
+  }
+  *size = length*count;
+  return 1;
+}
+
 void sp_save_int_vector(int* v, int size, const char* fname)
 {
   int i = 0;
-  FILE *f = fopen(fname,"wt+");
+  FILE *f;
+  if (spv_is_binary(fname))
+  {
+    sp_save_vectors(v,SP_VECTOR_INT,size,1,1,fname);
+    return;
+  }
+  f = fopen(fname,"wt+");
   if (f)
   {
     for (; i < size; ++ i)
@@ -1149,12 +2986,24 @@ void sp_save_int_vector(int* v, int size, const char* fname)
 
 void sp_save_double_vector(double* v, int size, const char* fname)
 {
-  int i = 0;
-  FILE *f = fopen(fname,"wt+");
+  int i = 0,length;
+  char buf[SP_DTOA_SIZE];
+  FILE *f;
+  if (spv_is_binary(fname))
+  {
+    sp_save_vectors(v,SP_VECTOR_DOUBLE,size,1,1,fname);
+    return;
+  }
+  f = fopen(fname,"wt+");
   if (f)
   {
+    /* short representation which reads back to the same value */
     for (; i < size; ++ i)
-      fprintf(f,"%e\n", v[i]);
+    {
+      length = sp_dtoa(v[i],buf);
+      buf[length++] = '\n';
+      fwrite(buf,1,length,f);
+    }
     fclose(f);
   }
 }
@@ -1164,8 +3013,11 @@ int sp_load_int_vector(int** v, int* size, const char* fname)
   int result = 0;
   int i = 0;
   int x;
-  FILE *f = fopen(fname,"rt");
+  FILE *f;
   int_array arr;
+  if (spv_is_binary(fname))
+    return spv_load_typed((void**)v,SP_VECTOR_INT,size,fname);
+  f = fopen(fname,"rt");
   if (f)
   {
     int_array_init(&arr, 10, 10);
@@ -1185,10 +3037,39 @@ int sp_load_int_vector(int** v, int* size, const char* fname)
 
 int sp_load_double_vector(double** v, int* size, const char* fname)
 {
-  (void)v;
-  (void)size;
-  (void)fname;
-  return 0;
+  sp_file_view file;
+  const char* ptr;
+  const char* end;
+  const char* next;
+  int capacity = 16;
+  if (spv_is_binary(fname))
+    return spv_load_typed((void**)v,SP_VECTOR_DOUBLE,size,fname);
+  if (!sp_file_view_open(&file,fname))
+    return 0;
+  ptr = file.data;
+  end = ptr + file.size;
+  *size = 0;
+  *v = spalloc(capacity*sizeof(double));
+  while ((ptr = mm_skip_comments(ptr,end)) < end)
+  {
+    if (*size == capacity)
+    {
+      capacity *= 2;
+      *v = sprealloc(*v,capacity*sizeof(double));
+    }
+    if ((next = sp_parse_double(ptr,end,*v + *size)) == ptr)
+    {
+      LOGERROR("Unable to parse element %d of %s",*size+1,fname);
+      spfree(*v);
+      *v = 0;
+      sp_file_view_close(&file);
+      return 0;
+    }
+    (*size)++;
+    ptr = next;
+  }
+  sp_file_view_close(&file);
+  return 1;
 }
 
 
@@ -1200,3 +3081,301 @@ int sp_load_double_vector(double** v, int* size, const char* fname)
 
 
 
+
+/* Orders the assembly elements by lines and then by indicies in lines */
+static int assembly_element_cmp(const void* a, const void* b)
+{
+  const sp_assembly_element* x = (const sp_assembly_element*)a;
+  const sp_assembly_element* y = (const sp_assembly_element*)b;
+  if (x->major != y->major)
+    return x->major < y->major ? -1 : 1;
+  return x->minor < y->minor ? -1 : x->minor > y->minor;
+}
+
+/*
+ * Sorts the elements and sums the duplicates in place
+ * Returns the number of the remaining elements
+ */
+static size_t assembly_sort(sp_assembly_element* elements, size_t count)
+{
+  size_t i,k = 0;
+  if (!count)
+    return 0;
+  qsort(elements,count,sizeof(sp_assembly_element),assembly_element_cmp);
+  for (i = 1; i < count; ++ i)
+  {
+    if (elements[i].major == elements[k].major &&
+        elements[i].minor == elements[k].minor)
+      elements[k].value += elements[i].value;
+    else
+      elements[++k] = elements[i];
+  }
+  return k + 1;
+}
+
+int sp_matrix_assembler_init(sp_matrix_assembler_ptr self,
+                             int rows,
+                             int cols,
+                             sparse_storage_type type,
+                             size_t memory,
+                             const char* scratch)
+{
+  memset(self,0,sizeof(sp_matrix_assembler));
+  self->scratch = fopen(scratch,"w+b");
+  if (!self->scratch)
+  {
+    LOGERROR("Error opening scratch file %s",scratch);
+    return 0;
+  }
+  self->rows_count = rows;
+  self->cols_count = cols;
+  self->storage_type = type;
+  self->capacity = memory/sizeof(sp_assembly_element);
+  self->capacity = self->capacity ? self->capacity : 1;
+  self->arena = spalloc(self->capacity*sizeof(sp_assembly_element));
+  self->scratch_name = sp_strndup(scratch,strlen(scratch));
+  self->runs = spalloc(sizeof(size_t));
+  self->runs[0] = 0;
+  return 1;
+}
+
+/*
+ * Sorts the arena and keeps it in memory if it is mostly duplicates,
+ * otherwise writes it as the next sorted run to the scratch file
+ */
+static int assembler_spill(sp_matrix_assembler_ptr self, int force)
+{
+  self->count = assembly_sort(self->arena,self->count);
+  if (!self->count || (!force && self->count <= self->capacity/2))
+    return 1;
+  if (fwrite(self->arena,sizeof(sp_assembly_element),self->count,
+             self->scratch) != self->count)
+  {
+    LOGERROR("Cannot write scratch file %s",self->scratch_name);
+    return 0;
+  }
+  self->runs = sprealloc(self->runs,(self->runs_count+2)*sizeof(size_t));
+  self->runs[self->runs_count+1] = self->runs[self->runs_count] + self->count;
+  self->runs_count++;
+  self->count = 0;
+  return 1;
+}
+
+int sp_matrix_assembler_add(sp_matrix_assembler_ptr self,
+                            int i,
+                            int j,
+                            double value)
+{
+  sp_assembly_element* element;
+  assert(i >= 0 && i < self->rows_count);
+  assert(j >= 0 && j < self->cols_count);
+  if (self->count == self->capacity && !assembler_spill(self,0))
+    return 0;
+  element = self->arena + self->count++;
+  element->major = self->storage_type == CRS ? i : j;
+  element->minor = self->storage_type == CRS ? j : i;
+  element->value = value;
+  return 1;
+}
+
+/*
+ * Merges the line of the sorted runs starting at cursors to buffer
+ * with summed duplicates, advances cursors
+ * Returns the number of the elements in the line
+ */
+static size_t assembler_merge_line(const sp_assembly_element* elements,
+                                   const size_t* runs,
+                                   size_t* cursors,
+                                   int runs_count,
+                                   int line,
+                                   sp_assembly_element** buffer,
+                                   size_t* buffer_size)
+{
+  size_t count = 0,size;
+  int k,sources = 0;
+  for (k = 0; k < runs_count; ++ k)
+  {
+    for (size = 0; cursors[k] + size < runs[k+1] &&
+           elements[cursors[k] + size].major == line; ++ size);
+    if (!size)
+      continue;
+    if (count + size > *buffer_size)
+    {
+      *buffer_size = (count + size)*2;
+      *buffer = *buffer ?
+        sprealloc(*buffer,*buffer_size*sizeof(sp_assembly_element)) :
+        spalloc(*buffer_size*sizeof(sp_assembly_element));
+    }
+    memcpy(*buffer + count,elements + cursors[k],
+           size*sizeof(sp_assembly_element));
+    count += size;
+    cursors[k] += size;
+    sources++;
+  }
+  /* the line from one run is already sorted without duplicates */
+  return sources > 1 ? assembly_sort(*buffer,count) : count;
+}
+
+/*
+ * Merges all the lines of the runs and writes to the file either
+ * indicies (offsets is not 0, filled with the sizes of the lines) or
+ * values, sequentially
+ * Returns nonzero if successfull
+ */
+static int assembler_write_pass(sp_matrix_assembler_ptr self,
+                                const sp_assembly_element* elements,
+                                FILE* file,
+                                int* offsets)
+{
+  int i,result = 1;
+  int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  size_t p,count,buffer_size = 0,line_size = 0;
+  size_t* cursors = spalloc((self->runs_count+1)*sizeof(size_t));
+  sp_assembly_element* buffer = 0;
+  int* line_indicies = 0;
+  double* line_values = 0;
+  memcpy(cursors,self->runs,self->runs_count*sizeof(size_t));
+  for (i = 0; i < n && result; ++ i)
+  {
+    count = assembler_merge_line(elements,self->runs,cursors,
+                                 self->runs_count,i,&buffer,&buffer_size);
+    if (offsets)
+    {
+      if (count > (size_t)(INT_MAX - offsets[i]))
+      {
+        LOGERROR("Too many nonzeros in the assembled matrix");
+        result = 0;
+        break;
+      }
+      offsets[i+1] = offsets[i] + (int)count;
+    }
+    if (count > line_size)
+    {
+      if (line_size)
+      {
+        spfree(line_indicies);
+        spfree(line_values);
+      }
+      line_size = buffer_size;
+      line_indicies = spalloc(line_size*sizeof(int));
+      line_values = spalloc(line_size*sizeof(double));
+    }
+    for (p = 0; p < count; ++ p)
+    {
+      line_indicies[p] = buffer[p].minor;
+      line_values[p] = buffer[p].value;
+    }
+    if (count)
+      result = offsets ?
+        fwrite(line_indicies,sizeof(int),count,file) == count :
+        fwrite(line_values,sizeof(double),count,file) == count;
+  }
+  if (buffer)
+  {
+    spfree(buffer);
+    if (line_size)
+    {
+      spfree(line_indicies);
+      spfree(line_values);
+    }
+  }
+  spfree(cursors);
+  return result;
+}
+
+int sp_matrix_assembler_finish(sp_matrix_assembler_ptr self,
+                               const char* filename)
+{
+  int n,result;
+  int* offsets;
+  const sp_assembly_element* elements;
+  sp_file_view view;
+  spb_header header;
+  FILE* file;
+  n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  /* the arena is the last run; free it before the merge */
+  result = assembler_spill(self,1);
+  if (fclose(self->scratch) || !result)
+  {
+    self->scratch = 0;
+    sp_matrix_assembler_free(self);
+    return 0;
+  }
+  self->scratch = 0;
+  spfree(self->arena);
+  self->arena = 0;
+  memset(&view,0,sizeof(view));
+  if (self->runs[self->runs_count] &&
+      !sp_file_view_open(&view,self->scratch_name))
+  {
+    LOGERROR("Cannot map scratch file %s",self->scratch_name);
+    sp_matrix_assembler_free(self);
+    return 0;
+  }
+  elements = (const sp_assembly_element*)view.data;
+  file = fopen(filename,"wb");
+  if (!file)
+  {
+    LOGERROR("Error opening file %s for writing",filename);
+    if (view.data)
+      sp_file_view_close(&view);
+    sp_matrix_assembler_free(self);
+    return 0;
+  }
+  /*
+   * Everything is written sequentially: positions of offsets and
+   * indicies don't depend on the number of nonzeros, the header and
+   * offsets are rewritten at the beginning of the file when known.
+   * Pass 1 writes the indicies, pass 2 merges the runs again and
+   * writes the values
+   */
+  offsets = spcalloc(n+1,sizeof(int));
+  spb_init_header(&header,self->storage_type,self->rows_count,
+                  self->cols_count,0,PROP_GENERAL);
+  result = fwrite(&header,sizeof(header),1,file) == 1 &&
+    spb_pad(file,sizeof(header),header.offsets_pos) &&
+    fwrite(offsets,sizeof(int),n+1,file) == (size_t)(n+1) &&
+    spb_pad(file,header.offsets_pos + (n+1)*(int64_t)sizeof(int),
+            header.indicies_pos) &&
+    assembler_write_pass(self,elements,file,offsets);
+  if (result)
+  {
+    spb_init_header(&header,self->storage_type,self->rows_count,
+                    self->cols_count,offsets[n],PROP_GENERAL);
+    result =
+      spb_pad(file,header.indicies_pos + offsets[n]*(int64_t)sizeof(int),
+              header.values_pos) &&
+      assembler_write_pass(self,elements,file,0) &&
+      fseek(file,0,SEEK_SET) == 0 &&
+      fwrite(&header,sizeof(header),1,file) == 1 &&
+      fseek(file,(long)header.offsets_pos,SEEK_SET) == 0 &&
+      fwrite(offsets,sizeof(int),n+1,file) == (size_t)(n+1);
+  }
+  if (fclose(file) || !result)
+  {
+    LOGERROR("Cannot save file %s",filename);
+    remove(filename);
+    result = 0;
+  }
+  if (view.data)
+    sp_file_view_close(&view);
+  spfree(offsets);
+  sp_matrix_assembler_free(self);
+  return result;
+}
+
+void sp_matrix_assembler_free(sp_matrix_assembler_ptr self)
+{
+  if (self->scratch)
+    fclose(self->scratch);
+  if (self->scratch_name)
+  {
+    remove(self->scratch_name);
+    spfree(self->scratch_name);
+  }
+  if (self->arena)
+    spfree(self->arena);
+  if (self->runs)
+    spfree(self->runs);
+  memset(self,0,sizeof(sp_matrix_assembler));
+}
@@ -19,11 +19,14 @@
 */
 
 /* #include <stdlib.h> */
+#include <stdio.h>
 #include <memory.h>
 #include <math.h>
+#include <float.h>
 
 #include "sp_iter.h"
 #include "sp_mem.h"
+#include "sp_par.h"
 
 /*
  * Scalar product x*y
@@ -49,13 +52,235 @@ inline static double norm2(double* x, int size)
   return sqrt(r);
 }
 
+/*
+ * Calculates the true residual r = b - A*x
+ * Returns norm2(r)
+ */
+static double true_residual(sp_matrix_yale_ptr self,
+                            double* b,
+                            double* x,
+                            double* r)
+{
+  int i;
+  sp_matrix_yale_mv(self,x,r);
+  for (i = 0; i < self->rows_count; ++ i)
+    r[i] = b[i] - r[i];
+  return norm2(r,self->rows_count);
+}
 
-void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
-                             double* b,
-                             double* x0,
-                             int* max_iter,
-                             double* tolerance,
-                             double* x)
+
+/* Number of bisection steps in the tridiagonal eigenvalue search */
+#define BISECTION_STEPS 128
+
+/*
+ * Number of eigenvalues less than x of the symmetric tridiagonal
+ * matrix with the diagonal d and offdiagonal e (Sturm sequence count)
+ */
+static int tridiag_count(int n, double* d, double* e, double x)
+{
+  int i,count = 0;
+  double q = 1;
+  for (i = 0; i < n; ++ i)
+  {
+    q = d[i] - x - (i ? e[i-1]*e[i-1]/q : 0);
+    if (q == 0)
+      q = -DBL_EPSILON*(fabs(x) + 1);
+    if (q < 0)
+      count++;
+  }
+  return count;
+}
+
+/*
+ * Smallest and largest eigenvalues of the symmetric tridiagonal matrix
+ * with the diagonal d and offdiagonal e by bisection
+ */
+static void tridiag_extreme_eigs(int n,
+                                 double* d,
+                                 double* e,
+                                 double* lambda_min,
+                                 double* lambda_max)
+{
+  int i,k;
+  double lo,hi,mid,radius,bounds[2];
+  /* Gershgorin bounds */
+  lo = d[0]; hi = d[0];
+  for (i = 0; i < n; ++ i)
+  {
+    radius = (i ? fabs(e[i-1]) : 0) + (i < n - 1 ? fabs(e[i]) : 0);
+    lo = d[i] - radius < lo ? d[i] - radius : lo;
+    hi = d[i] + radius > hi ? d[i] + radius : hi;
+  }
+  bounds[0] = lo; bounds[1] = hi;
+  /* k = 0: smallest eigenvalue, first one below mid;
+   * k = 1: largest, all n eigenvalues below mid */
+  for (k = 0; k < 2; ++ k)
+  {
+    lo = bounds[0]; hi = bounds[1];
+    for (i = 0; i < BISECTION_STEPS; ++ i)
+    {
+      mid = (lo + hi)/2;
+      if (mid <= lo || mid >= hi)
+        break;
+      if (tridiag_count(n,d,e,mid) >= (k ? n : 1))
+        hi = mid;
+      else
+        lo = mid;
+    }
+    if (k)
+      *lambda_max = (lo + hi)/2;
+    else
+      *lambda_min = (lo + hi)/2;
+  }
+}
+
+/*
+ * Extreme eigenvalues of the Lanczos tridiagonal matrix built from the
+ * CG coefficients alpha_j, beta_j, j < count (Saad, page 192):
+ * T(j,j) = 1/alpha_j + beta_{j-1}/alpha_{j-1}
+ * T(j,j+1) = sqrt(beta_j)/alpha_j
+ */
+static void cg_extreme_eigs(int count,
+                            double* alphas,
+                            double* betas,
+                            double* lambda_min,
+                            double* lambda_max)
+{
+  int j;
+  double* d;
+  double* e;
+  *lambda_min = 0;
+  *lambda_max = 0;
+  if (count <= 0)
+    return;
+  d = spcalloc(count,sizeof(double));
+  e = spcalloc(count,sizeof(double));
+  for (j = 0; j < count; ++ j)
+  {
+    d[j] = 1/alphas[j] + (j ? betas[j-1]/alphas[j-1] : 0);
+    e[j] = sqrt(fabs(betas[j]))/alphas[j];
+  }
+  tridiag_extreme_eigs(count,d,e,lambda_min,lambda_max);
+  spfree(d);
+  spfree(e);
+}
+
+int sp_matrix_yale_lanczos(sp_matrix_yale_ptr self,
+                           double* diag,
+                           int steps,
+                           double* lambda_min,
+                           double* lambda_max)
+{
+  int i,k,count = 0;
+  int n = self->rows_count;
+  double norm;
+  double* alpha;
+  double* beta;
+  double* v;
+  double* v_prev;
+  double* w;
+  double* scale = 0;
+  double* u = 0;
+
+  if (self->rows_count != self->cols_count || n == 0 || steps <= 0)
+    return 0;
+  if (diag)
+  {
+    /* D^{-1/2}*A*D^{-1/2} has the same eigenvalues as D^{-1}*A */
+    scale = spcalloc(n,sizeof(double));
+    for (i = 0; i < n; ++ i)
+    {
+      if (diag[i] <= 0)
+      {
+        spfree(scale);
+        return 0;
+      }
+      scale[i] = 1/sqrt(diag[i]);
+    }
+    u = spcalloc(n,sizeof(double));
+  }
+  steps = steps < n ? steps : n;
+  alpha = spcalloc(steps,sizeof(double));
+  beta = spcalloc(steps,sizeof(double));
+  v = spcalloc(n,sizeof(double));
+  v_prev = spcalloc(n,sizeof(double));
+  w = spcalloc(n,sizeof(double));
+  sp_random_start_vector(v,n);
+  norm = norm2(v,n);
+  for (i = 0; i < n; ++ i)
+    v[i] /= norm;
+  for (k = 0; k < steps; ++ k)
+  {
+    if (diag)
+    {
+      for (i = 0; i < n; ++ i)
+        u[i] = scale[i]*v[i];
+      sp_matrix_yale_mv(self,u,w);
+      for (i = 0; i < n; ++ i)
+        w[i] *= scale[i];
+    }
+    else
+      sp_matrix_yale_mv(self,v,w);
+    /* w = A*v_k - alpha_k*v_k - beta_{k-1}*v_{k-1} */
+    alpha[k] = prod(w,v,n);
+    for (i = 0; i < n; ++ i)
+      w[i] -= alpha[k]*v[i] + (k ? beta[k-1]*v_prev[i] : 0);
+    beta[k] = norm2(w,n);
+    count++;
+    /* invariant subspace found, eigenvalues of T are exact */
+    if (beta[k] <= DBL_EPSILON*fabs(alpha[k]))
+      break;
+    for (i = 0; i < n; ++ i)
+    {
+      v_prev[i] = v[i];
+      v[i] = w[i]/beta[k];
+    }
+  }
+  tridiag_extreme_eigs(count,alpha,beta,lambda_min,lambda_max);
+  spfree(alpha);
+  spfree(beta);
+  spfree(v);
+  spfree(v_prev);
+  spfree(w);
+  if (diag)
+  {
+    spfree(scale);
+    spfree(u);
+  }
+  return 1;
+}
+
+void sp_matrix_yale_printf_spectrum(sp_matrix_yale_ptr self)
+{
+  double lambda_min,lambda_max;
+  if (sp_matrix_yale_properites(self) != PROP_SYMMETRIC)
+  {
+    printf("Eigenvalues estimate: matrix is not symmetric\n");
+    return;
+  }
+  if (!sp_matrix_yale_lanczos(self,0,SP_SPECTRUM_LANCZOS_STEPS,
+                              &lambda_min,&lambda_max))
+    return;
+  printf("Eigenvalues estimate: [%e, %e]\n",lambda_min,lambda_max);
+  if (lambda_min > 0)
+    printf("Condition number estimate: %e\n",lambda_max/lambda_min);
+  else
+    printf("Condition number estimate: matrix is not "
+           "positive-definite\n");
+}
+
+/*
+ * Conjugate Gradient kernel, estimates the extreme eigenvalues of A
+ * from the CG coefficients if lambda_min is not 0
+ */
+static void cg(sp_matrix_yale_ptr self,
+               double* b,
+               double* x0,
+               int* max_iter,
+               double* tolerance,
+               double* x,
+               double* lambda_min,
+               double* lambda_max)
 {
   /* Conjugate Gradient Algorithm */
   /*
@@ -75,6 +300,8 @@ void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
   double* r;              /* residual */
   double* p;              /* search direction */
   double* temp;
+  double* alphas = 0;     /* CG coefficients for the eigenvalues */
+  double* betas = 0;      /* estimation */
 
   /* allocate memory for vectors */
   r = (double*)spalloc(size);
@@ -84,6 +311,11 @@ void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
   memset(r,0,size);
   memset(p,0,size);
   memset(temp,0,size);
+  if (lambda_min)
+  {
+    alphas = (double*)spcalloc(max_iterations+1,sizeof(double));
+    betas = (double*)spcalloc(max_iterations+1,sizeof(double));
+  }
 
   /* x = x_0 */
   memcpy(x,x0,size);
@@ -110,6 +342,8 @@ void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
      *           (A*p_j,p_j)
      */                     
     alpha = a1/a2;              
+    if (alphas)
+      alphas[j] = alpha;
                                 
     /* x_{j+1} = x_j+alpha_j*p_j */
     for (i = 0; i < msize; ++ i)
@@ -129,6 +363,8 @@ void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
 
     /* b_j = (r_{j+1},r_{j+1})/(r_j,r_j) */
     beta = a2/a1;
+    if (betas)
+      betas[j] = beta;
     
     /* p_{j+1} = r_{j+1} + beta_j*p_j */
     for (i = 0; i < msize; ++ i)
@@ -136,29 +372,138 @@ void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
   }
   *max_iter = j;
   *tolerance = residn;
+  if (lambda_min)
+  {
+    cg_extreme_eigs(j < max_iterations ? j + 1 : j,alphas,betas,
+                    lambda_min,lambda_max);
+    spfree(alphas);
+    spfree(betas);
+  }
   
   spfree(r);
   spfree(p);
   spfree(temp);
 }
 
+void sp_matrix_yale_solve_cg(sp_matrix_yale_ptr self,
+                             double* b,
+                             double* x0,
+                             int* max_iter,
+                             double* tolerance,
+                             double* x)
+{
+  cg(self,b,x0,max_iter,tolerance,x,0,0);
+}
 
-void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
-                                  sp_matrix_skyline_ilu_ptr ILU,                         
+void sp_matrix_yale_solve_cg_eigs(sp_matrix_yale_ptr self,
                                   double* b,
                                   double* x0,
                                   int* max_iter,
                                   double* tolerance,
-                                  double* x)
+                                  double* x,
+                                  double* lambda_min,
+                                  double* lambda_max)
+{
+  cg(self,b,x0,max_iter,tolerance,x,lambda_min,lambda_max);
+}
+
+
+/*
+ * State of the ILU preconditioner M = L*U
+ */
+typedef struct
+{
+  sp_matrix_skyline_ilu_ptr ilu;
+  double* r1;                   /* backup of the residual */
+  double* temp;
+} ilu_precond_state;
+
+/*
+ * State of the incomplete Cholesky preconditioner M = L*L^T
+ */
+typedef struct
+{
+  sp_matrix_yale_ptr L;
+  double* temp;
+} ic_precond_state;
+
+static void ilu_precond_solve(void* state, double* r, double* z)
+{
+  ilu_precond_state* s = (ilu_precond_state*)state;
+  int size = sizeof(double)*s->ilu->parent.rows_count;
+  /*
+   * to solve system L*U*x = b
+   * y = U*x, => L*y = b
+   * U*x = y => x
+   */ 
+  memcpy(s->r1,r,size);
+  sp_matrix_skyline_ilu_lower_solve(s->ilu,s->r1,s->temp); /* temp = L^{-1}*r */
+  /* r1 now changed, temp contains solution */
+  sp_matrix_skyline_ilu_upper_solve(s->ilu,s->temp,z); /* z = U^{-1}*temp */
+  /* temp now changed, z contains solution*/
+}
+
+static void ic_precond_solve(void* state, double* r, double* z)
+{
+  ic_precond_state* s = (ic_precond_state*)state;
+  sp_matrix_yale_lower_solve(s->L,r,s->temp);       /* temp = L^{-1}*r */
+  sp_matrix_yale_lower_trans_solve(s->L,s->temp,z); /* z = L^{-T}*temp */
+}
+
+static void yale_ilu_precond_solve(void* state, double* r, double* z)
+{
+  sp_matrix_yale_ilu_solve((sp_matrix_yale_ilu_ptr)state,r,z);
+}
+
+/* Unpacks the generic preconditioner object, 0 if no preconditioner */
+static sp_precond_solve_func precond_func(sp_precond_ptr precond)
+{
+  return precond ? precond->apply : 0;
+}
+
+static void* precond_state(sp_precond_ptr precond)
+{
+  return precond ? precond->state : 0;
+}
+
+/*
+ * Calculates y = A*M^{-1}*x for the right-preconditioned methods
+ * Mx - work vector for M^{-1}*x
+ * Returns pointer to M^{-1}*x: Mx or x itself if no preconditioner
+ */
+static double* precond_mv(sp_matrix_yale_ptr self,
+                          sp_precond_solve_func precond,
+                          void* state,
+                          double* x,
+                          double* Mx,
+                          double* y)
+{
+  if (!precond)
+  {
+    sp_matrix_yale_mv(self,x,y);
+    return x;
+  }
+  precond(state,x,Mx);
+  sp_matrix_yale_mv(self,Mx,y);
+  return Mx;
+}
+
+static void pcg(sp_matrix_yale_ptr self,
+                sp_precond_solve_func precond,
+                void* state,
+                double* b,
+                double* x0,
+                int* max_iter,
+                double* tolerance,
+                double* x,
+                double* lambda_min,
+                double* lambda_max)
 {
   /* Preconditioned Conjugate Gradient Algorithm */
   /*
    * Based on the book:
    * Saad Y. Iterative methods for sparse linear systems (2ed., 2000)
    * page 246
-   *
-   * Preconditioner: Incomplete LU decomposition (ILU)
-   * M = L*U, A = M-R
    */
 
   /* variables */
@@ -171,24 +516,22 @@ void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
   double tol = *tolerance;
   
   double* r;              /* residual */
-  double* r1;             /* backup of the residual */
   double* p;              /* search direction */
   double* z;              /* z = M^{-1}*r */
   double* temp;
+  double* alphas = 0;     /* CG coefficients for the eigenvalues */
+  double* betas = 0;      /* estimation */
 
   /* allocate memory for vectors */
-  r = (double*)spalloc(size);
-  r1 = (double*)spalloc(size);
-  p = (double*)spalloc(size);
-  z = (double*)spalloc(size);
-  temp = (double*)spalloc(size);
-  
-  /* clear vectors */
-  memset(r,0,size);
-  memset(r1,0,size);
-  memset(p,0,size);
-  memset(z,0,size);
-  memset(temp,0,size);
+  r = (double*)spcalloc(msize,sizeof(double));
+  p = (double*)spcalloc(msize,sizeof(double));
+  z = (double*)spcalloc(msize,sizeof(double));
+  temp = (double*)spcalloc(msize,sizeof(double));
+  if (lambda_min)
+  {
+    alphas = (double*)spcalloc(max_iterations+1,sizeof(double));
+    betas = (double*)spcalloc(max_iterations+1,sizeof(double));
+  }
 
   /* x = x_0 */
   memcpy(x,x0,size);
@@ -198,18 +541,11 @@ void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
   for ( i = 0; i < msize; ++ i)
     r[i] = b[i] - r[i];
   
-  /* backup residual */
-  memcpy(r1,r,size);
   /* z_0 = M^{-1}*r_0 */
-  /*
-   * to solve system L*U*x = b
-   * y = U*x, => L*y = b
-   * U*x = y => x
-   */ 
-  sp_matrix_skyline_ilu_lower_solve(ILU,r1,temp); /* temp = L^{-1}*r */
-  /* r1 now changed, temp contains solution */
-  sp_matrix_skyline_ilu_upper_solve(ILU,temp,z); /* z = U^{-1}*temp */
-  /* temp now changed, z contains solution*/
+  if (precond)
+    precond(state,r,z);
+  else
+    memcpy(z,r,size);
   
   /* p_0 = z_0 */
   memcpy(p,z,size);
@@ -228,6 +564,8 @@ void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
      *           (A*p_j,p_j)
      */                     
     alpha = a1/a2;              
+    if (alphas)
+      alphas[j] = alpha;
                                 
     /* x_{j+1} = x_j+alpha_j*p_j */
     for (i = 0; i < msize; ++ i)
@@ -243,17 +581,18 @@ void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
       break;
 
     /* z_{j+1} = M^{-1}*r_{j+1} */
-    memcpy(r1,r,size);
-    memset(temp,0,size);
-    sp_matrix_skyline_ilu_lower_solve(ILU,r1,temp); /* temp = L^{-1}*r */
-    sp_matrix_skyline_ilu_upper_solve(ILU,temp,z); /* z = U^{-1}*temp */
-
+    if (precond)
+      precond(state,r,z);
+    else
+      memcpy(z,r,size);
     
     /* compute (r_{j+1},z_{j+1}) */
     a2 = prod(r,z,msize);
 
     /* b_j = (r_{j+1},z_{j+1})/(r_j,z_j) */
     beta = a2/a1;
+    if (betas)
+      betas[j] = beta;
     
     /* d_{j+1} = r_{j+1} + beta_j*d_j */
     for (i = 0; i < msize; ++ i)
@@ -261,15 +600,318 @@ void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
   }
   *max_iter = j;
   *tolerance = residn;
+  if (lambda_min)
+  {
+    cg_extreme_eigs(j < max_iterations ? j + 1 : j,alphas,betas,
+                    lambda_min,lambda_max);
+    spfree(alphas);
+    spfree(betas);
+  }
   
   /* free vectors */
   spfree(r);
-  spfree(r1);
   spfree(z);
   spfree(p);
   spfree(temp);
 }
 
+void sp_matrix_yale_solve_pcg_ilu(sp_matrix_yale_ptr self,
+                                  sp_matrix_skyline_ilu_ptr ILU,                         
+                                  double* b,
+                                  double* x0,
+                                  int* max_iter,
+                                  double* tolerance,
+                                  double* x)
+{
+  /*
+   * Preconditioner: Incomplete LU decomposition (ILU)
+   * M = L*U, A = M-R
+   */
+  ilu_precond_state state;
+  state.ilu = ILU;
+  state.r1 = (double*)spcalloc(self->rows_count,sizeof(double));
+  state.temp = (double*)spcalloc(self->rows_count,sizeof(double));
+  pcg(self,ilu_precond_solve,&state,b,x0,max_iter,tolerance,x,0,0);
+  spfree(state.r1);
+  spfree(state.temp);
+}
+
+static void ilu_sched_precond_solve(void* state, double* r, double* z)
+{
+  sp_matrix_skyline_ilu_sched_solve((sp_matrix_skyline_ilu_sched_ptr)state,
+                                    r,z);
+}
+
+void sp_matrix_yale_solve_pcg_ilu_sched(sp_matrix_yale_ptr self,
+                                        sp_matrix_skyline_ilu_sched_ptr sched,
+                                        double* b,
+                                        double* x0,
+                                        int* max_iter,
+                                        double* tolerance,
+                                        double* x)
+{
+  pcg(self,ilu_sched_precond_solve,sched,b,x0,max_iter,tolerance,x,0,0);
+}
+
+void sp_matrix_yale_solve_pcg_ic(sp_matrix_yale_ptr self,
+                                 sp_matrix_yale_ptr L,
+                                 double* b,
+                                 double* x0,
+                                 int* max_iter,
+                                 double* tolerance,
+                                 double* x)
+{
+  /*
+   * Preconditioner: Incomplete Cholesky decomposition
+   * M = L*L^T, A = M-R
+   */
+  ic_precond_state state;
+  state.L = L;
+  state.temp = (double*)spcalloc(self->rows_count,sizeof(double));
+  pcg(self,ic_precond_solve,&state,b,x0,max_iter,tolerance,x,0,0);
+  spfree(state.temp);
+}
+
+void sp_matrix_yale_solve_pcg_precond(sp_matrix_yale_ptr self,
+                                      sp_precond_ptr precond,
+                                      double* b,
+                                      double* x0,
+                                      int* max_iter,
+                                      double* tolerance,
+                                      double* x)
+{
+  pcg(self,precond_func(precond),precond_state(precond),
+      b,x0,max_iter,tolerance,x,0,0);
+}
+
+void sp_matrix_yale_solve_pcg_eigs(sp_matrix_yale_ptr self,
+                                   sp_precond_ptr precond,
+                                   double* b,
+                                   double* x0,
+                                   int* max_iter,
+                                   double* tolerance,
+                                   double* x,
+                                   double* lambda_min,
+                                   double* lambda_max)
+{
+  pcg(self,precond_func(precond),precond_state(precond),
+      b,x0,max_iter,tolerance,x,lambda_min,lambda_max);
+}
+
+/*
+ * Removes the columns c with keep[c] == 0 from the n x k block
+ * stored row by row
+ */
+static void block_compact(double* X, int n, int k, char* keep)
+{
+  int i,c;
+  size_t p = 0;
+  for (i = 0; i < n; ++ i)
+    for (c = 0; c < k; ++ c)
+      if (keep[c])
+        X[p++] = X[(size_t)i*k+c];
+}
+
+/*
+ * z_c = M^{-1}*r_c for the columns c of the n x k blocks R and Z
+ * with keep[c] != 0
+ * r, z - work vectors of the size n
+ */
+static void block_precond(sp_precond_solve_func precond,
+                          void* state,
+                          int n,
+                          int k,
+                          char* keep,
+                          double* R,
+                          double* Z,
+                          double* r,
+                          double* z)
+{
+  int i,c;
+  if (!precond)
+  {
+    memcpy(Z,R,sizeof(double)*n*k);
+    return;
+  }
+  for (c = 0; c < k; ++ c)
+  {
+    if (!keep[c])
+      continue;
+    for (i = 0; i < n; ++ i)
+      r[i] = R[(size_t)i*k+c];
+    precond(state,r,z);
+    for (i = 0; i < n; ++ i)
+      Z[(size_t)i*k+c] = z[i];
+  }
+}
+
+static void block_pcg(sp_matrix_yale_ptr self,
+                      sp_precond_solve_func precond,
+                      void* state,
+                      int k,
+                      double* b,
+                      double* x0,
+                      int* max_iter,
+                      double* tolerance,
+                      double* x)
+{
+  /*
+   * Every column runs its own PCG recurrence (own alpha and beta),
+   * the matrix-vector products of all active columns are done in one
+   * pass over the matrix. Columns are deflated from the active block
+   * as soon as they converge or exceed their maximum number of
+   * iterations
+   */
+  int i,c,j,ka = k,deflate;
+  double rz_new;
+  int n = self->rows_count;
+  size_t size = (size_t)n*k;
+  double* X = spcalloc(size+1,sizeof(double));
+  double* R = spcalloc(size+1,sizeof(double));
+  double* Z = spcalloc(size+1,sizeof(double));
+  double* P = spcalloc(size+1,sizeof(double));
+  double* AP = spcalloc(size+1,sizeof(double));
+  double* r = spcalloc(n+1,sizeof(double));
+  double* z = spcalloc(n+1,sizeof(double));
+  double* rz = spcalloc(k,sizeof(double));       /* (r_c,z_c) */
+  double* pap = spcalloc(k,sizeof(double));      /* (A*p_c,p_c) */
+  double* alpha = spcalloc(k,sizeof(double));
+  double* beta = spcalloc(k,sizeof(double));
+  double* residn = spcalloc(k,sizeof(double));
+  int* cols = spcalloc(k,sizeof(int));           /* original columns */
+  int* iters = spcalloc(k,sizeof(int));
+  char* keep = spcalloc(k,sizeof(char));
+
+  for (c = 0; c < k; ++ c)
+  {
+    cols[c] = c;
+    keep[c] = 1;
+    for (i = 0; i < n; ++ i)
+      X[(size_t)i*k+c] = x0[(size_t)c*n+i];
+  }
+  /* R = B - A*X_0 */
+  sp_matrix_yale_mm(self,k,SP_ROW_MAJOR,X,AP);
+  for (c = 0; c < k; ++ c)
+    for (i = 0; i < n; ++ i)
+      R[(size_t)i*k+c] = b[(size_t)c*n+i] - AP[(size_t)i*k+c];
+  /* columns already converged are deflated before the first iteration */
+  for (j = 0; ka > 0; ++ j)
+  {
+    deflate = 0;
+    memset(residn,0,ka*sizeof(double));
+    for (i = 0; i < n; ++ i)
+      for (c = 0; c < ka; ++ c)
+        residn[c] += R[(size_t)i*ka+c]*R[(size_t)i*ka+c];
+    for (c = 0; c < ka; ++ c)
+    {
+      residn[c] = sqrt(residn[c]);
+      keep[c] = residn[c] >= tolerance[cols[c]] &&
+        iters[c] < max_iter[cols[c]];
+      if (!keep[c])
+      {
+        deflate = 1;
+        max_iter[cols[c]] = iters[c];
+        tolerance[cols[c]] = residn[c];
+        for (i = 0; i < n; ++ i)
+          x[(size_t)cols[c]*n+i] = X[(size_t)i*ka+c];
+      }
+    }
+    /* Z = M^{-1}*R */
+    block_precond(precond,state,n,ka,keep,R,Z,r,z);
+    /* beta_c = (r_{j+1},z_{j+1})/(r_j,z_j), P = Z + beta*P */
+    memset(beta,0,ka*sizeof(double));
+    for (i = 0; i < n; ++ i)
+      for (c = 0; c < ka; ++ c)
+        beta[c] += R[(size_t)i*ka+c]*Z[(size_t)i*ka+c];
+    for (c = 0; c < ka; ++ c)
+    {
+      rz_new = beta[c];
+      beta[c] = j ? rz_new/rz[c] : 0;
+      rz[c] = rz_new;
+    }
+    SP_PRAGMA(omp parallel for private(c) schedule(static)
+              if (n > SP_PAR_MIN_SIZE))
+    for (i = 0; i < n; ++ i)
+      for (c = 0; c < ka; ++ c)
+        P[(size_t)i*ka+c] = Z[(size_t)i*ka+c] + beta[c]*P[(size_t)i*ka+c];
+    if (deflate)
+    {
+      block_compact(X,n,ka,keep);
+      block_compact(R,n,ka,keep);
+      block_compact(P,n,ka,keep);
+      for (c = 0, i = 0; c < ka; ++ c)
+        if (keep[c])
+        {
+          cols[i] = cols[c];
+          iters[i] = iters[c];
+          rz[i++] = rz[c];
+        }
+      ka = i;
+      if (!ka)
+        break;
+    }
+    /* AP = A*P */
+    sp_matrix_yale_mm(self,ka,SP_ROW_MAJOR,P,AP);
+    memset(pap,0,ka*sizeof(double));
+    for (i = 0; i < n; ++ i)
+      for (c = 0; c < ka; ++ c)
+        pap[c] += P[(size_t)i*ka+c]*AP[(size_t)i*ka+c];
+    for (c = 0; c < ka; ++ c)
+    {
+      alpha[c] = rz[c]/pap[c];
+      iters[c]++;
+    }
+    /* X = X + alpha*P, R = R - alpha*AP */
+    SP_PRAGMA(omp parallel for private(c) schedule(static)
+              if (n > SP_PAR_MIN_SIZE))
+    for (i = 0; i < n; ++ i)
+      for (c = 0; c < ka; ++ c)
+      {
+        X[(size_t)i*ka+c] += alpha[c]*P[(size_t)i*ka+c];
+        R[(size_t)i*ka+c] -= alpha[c]*AP[(size_t)i*ka+c];
+      }
+  }
+  spfree(X);
+  spfree(R);
+  spfree(Z);
+  spfree(P);
+  spfree(AP);
+  spfree(r);
+  spfree(z);
+  spfree(rz);
+  spfree(pap);
+  spfree(alpha);
+  spfree(beta);
+  spfree(residn);
+  spfree(cols);
+  spfree(iters);
+  spfree(keep);
+}
+
+void sp_matrix_yale_solve_block_cg(sp_matrix_yale_ptr self,
+                                   int k,
+                                   double* b,
+                                   double* x0,
+                                   int* max_iter,
+                                   double* tolerance,
+                                   double* x)
+{
+  block_pcg(self,0,0,k,b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_block_pcg(sp_matrix_yale_ptr self,
+                                    sp_precond_ptr precond,
+                                    int k,
+                                    double* b,
+                                    double* x0,
+                                    int* max_iter,
+                                    double* tolerance,
+                                    double* x)
+{
+  block_pcg(self,precond_func(precond),precond_state(precond),
+            k,b,x0,max_iter,tolerance,x);
+}
+
 void sp_matrix_create_ilu(sp_matrix_ptr self,sp_matrix_skyline_ilu_ptr ilu)
 {
   sp_matrix_skyline A;
@@ -293,39 +935,66 @@ void sp_matrix_create_ilu(sp_matrix_ptr self,sp_matrix_skyline_ilu_ptr ilu)
 void sp_matrix_skyline_ilu_copy_init(sp_matrix_skyline_ilu_ptr self,
                                      sp_matrix_skyline_ptr parent)
 {
-  int i,j,k,l,q;
+  int i,j,k,l,p,q;
+  int n = parent->rows_count;
   double sum;
+  int* pos;                     /* positions of row k in the lower triangle */
+  int* tr_offsets;              /* transposed portrait: rows containing */
+  int* tr_indicies;             /* column k, i.e. columns of U in row k */
+  int* tr_positions;            /* positions of U_{kj} in upper triangle */
   
   /* copy parent member-wise */
   self->parent = *parent;
   /* allocate memory for ILU decomposition arrays */
-  self->ilu_diag = (double*)spalloc(sizeof(double)*parent->rows_count);
-  self->ilu_lowertr = (double*)spalloc(sizeof(double)*parent->tr_nonzeros);
-  self->ilu_uppertr = (double*)spalloc(sizeof(double)*parent->tr_nonzeros);
-  /* clear arrays before construction of the ILU decomposition */
-  memset(self->ilu_diag,0,sizeof(double)*parent->rows_count);
-  memset(self->ilu_lowertr,0,sizeof(double)*parent->tr_nonzeros);
-  memset(self->ilu_uppertr,0,sizeof(double)*parent->tr_nonzeros);
+  self->ilu_diag = (double*)spcalloc(n,sizeof(double));
+  self->ilu_lowertr = (double*)spcalloc(parent->tr_nonzeros,sizeof(double));
+  self->ilu_uppertr = (double*)spcalloc(parent->tr_nonzeros,sizeof(double));
+
+  /*
+   * build the transposed portrait of the lower triangle:
+   * for every k rows j and positions q of the elements with jptr[q] == k,
+   * in ascending order of rows. Since the portrait is symmetric
+   * these are positions of the elements U_{kj} in the upper triangle
+   */
+  tr_offsets = (int*)spcalloc(n+1,sizeof(int));
+  tr_indicies = (int*)spcalloc(parent->tr_nonzeros+1,sizeof(int));
+  tr_positions = (int*)spcalloc(parent->tr_nonzeros+1,sizeof(int));
+  for (q = 0; q < parent->tr_nonzeros; ++ q)
+    tr_offsets[parent->jptr[q]+1]++;
+  for (k = 0; k < n; ++ k)
+    tr_offsets[k+1] += tr_offsets[k];
+  pos = (int*)spalloc(sizeof(int)*(n+1));
+  memcpy(pos,tr_offsets,sizeof(int)*(n+1));
+  for (j = 0; j < n; ++ j)
+    for (q = parent->iptr[j]; q < parent->iptr[j+1]; ++ q)
+    {
+      l = pos[parent->jptr[q]]++;
+      tr_indicies[l] = j;
+      tr_positions[l] = q;
+    }
+  /* marker array */
+  for (k = 0; k < n; ++ k)
+    pos[k] = -1;
 
-  for (k = 0; k < parent->rows_count; ++ k)
+  for (k = 0; k < n; ++ k)
   {
+    /* mark the portrait of the k-th row of L */
+    for (i = parent->iptr[k]; i < parent->iptr[k+1]; ++ i)
+      pos[parent->jptr[i]] = i;
+    
     for ( j = parent->iptr[k]; j < parent->iptr[k+1]; ++ j)
     {
       /*
        * L_{kj} = (A_{kj} - \sum\limits_{i=1}^{j-1}L_{ki}U_{ij}/U_{jj}
        * calculate using L_{k,jptr[j]}
+       * l = iptr[q]:iptr[q+1]-1 are coordinates of the q-th column
+       * in upper matrix array, pos gives the matching L_{ki}
        */
       sum = 0;
       q = parent->jptr[j];        /* column index */
-      for ( i = parent->iptr[k]; i < parent->iptr[k+1]; ++ i)
-      {
-        for ( l = parent->iptr[q]; l < parent->iptr[q+1]; ++ l)
-        {
-          /* if row and column indicies are the same */
-          if ( parent->jptr[i] == parent->jptr[l] )
-            sum += self->ilu_lowertr[i]*self->ilu_uppertr[l];
-        }
-      }
+      for ( l = parent->iptr[q]; l < parent->iptr[q+1]; ++ l)
+        if ((i = pos[parent->jptr[l]]) != -1)
+          sum += self->ilu_lowertr[i]*self->ilu_uppertr[l];
       self->ilu_lowertr[j] =
         (parent->lower_triangle[j] - sum)/self->ilu_diag[q];
     }
@@ -339,53 +1008,130 @@ void sp_matrix_skyline_ilu_copy_init(sp_matrix_skyline_ilu_ptr self,
       sum += self->ilu_lowertr[i]*self->ilu_uppertr[i];
     self->ilu_diag[k] = parent->diag[k] - sum;
 
-    for (j = k; j < parent->rows_count; ++ j)
+    for (l = tr_offsets[k]; l < tr_offsets[k+1]; ++ l)
     {
-      for ( q = parent->iptr[j]; q < parent->iptr[j+1]; ++ q)
-        if (k == parent->jptr[q])
-        {
-          /*
-           * U_{kj} = A_{kj} -
-           * \sum\limits_{i=1}^{k-1}L_{ki}U_{ij}
-           */
-          sum = 0;
-          /*
-           * i = iptr[k]:iptr[k+1]-1 are coordinates of the
-           * k-th row in lower matrix array (self->ilu_lowertr)
-           * l = iptr[j]:iptr[j+1]-1 are coordinates of the
-           * j-th column in upper matrix array (self->ilu_uppertr)
-           */
-          for ( i = parent->iptr[k]; i < parent->iptr[k+1]; ++ i)
-            for ( l = parent->iptr[j]; l < parent->iptr[j+1]; ++ l)
-            {
-              /* if row and column indicies are the same */
-              if ( parent->jptr[i] == parent->jptr[l] )
-                sum += self->ilu_lowertr[i]*self->ilu_uppertr[l];
-            }
-          self->ilu_uppertr[q] = parent->upper_triangle[q] - sum;
-        }
+      /*
+       * U_{kj} = A_{kj} -
+       * \sum\limits_{i=1}^{k-1}L_{ki}U_{ij}
+       * where q is the position of U_{kj} in the j-th column;
+       * only rows of the j-th column marked in the k-th row of L
+       * contribute to the sum
+       */
+      j = tr_indicies[l];
+      q = tr_positions[l];
+      sum = 0;
+      for ( p = parent->iptr[j]; p < parent->iptr[j+1]; ++ p)
+        if ((i = pos[parent->jptr[p]]) != -1)
+          sum += self->ilu_lowertr[i]*self->ilu_uppertr[p];
+      self->ilu_uppertr[q] = parent->upper_triangle[q] - sum;
     }
+    
+    /* clear the marker */
+    for (i = parent->iptr[k]; i < parent->iptr[k+1]; ++ i)
+      pos[parent->jptr[i]] = -1;
   }
+  spfree(pos);
+  spfree(tr_offsets);
+  spfree(tr_indicies);
+  spfree(tr_positions);
 }
 
-void sp_matrix_skyline_ilu_free(sp_matrix_skyline_ilu_ptr self)
+/*
+ * Scalar product of the row k of L and the column j of U
+ * for elements with indicies less than limit
+ * Both portraits are sorted, so they are merged
+ */
+static double ilu_row_col_prod(sp_matrix_skyline_ilu_ptr self,
+                               int k, int j, int limit)
 {
-  spfree(self->ilu_diag);
-  spfree(self->ilu_lowertr);
-  spfree(self->ilu_uppertr);
-  sp_matrix_skyline_free(&self->parent);
+  sp_matrix_skyline_ptr parent = &self->parent;
+  int i = parent->iptr[k], i_end = parent->iptr[k+1];
+  int l = parent->iptr[j], l_end = parent->iptr[j+1];
+  int ci, cl;
+  double sum = 0;
+  while (i < i_end && l < l_end)
+  {
+    ci = parent->jptr[i];
+    cl = parent->jptr[l];
+    if (ci >= limit || cl >= limit)
+      break;
+    if (ci == cl)
+      sum += self->ilu_lowertr[i++]*self->ilu_uppertr[l++];
+    else if (ci < cl)
+      i++;
+    else
+      l++;
+  }
+  return sum;
 }
 
-
-void sp_matrix_skyline_ilu_lower_mv(sp_matrix_skyline_ilu_ptr self,
-                                    double* x,
-                                    double* y)
+void sp_matrix_skyline_ilu_iter_init(sp_matrix_skyline_ilu_ptr self,
+                                     sp_matrix_skyline_ptr parent,
+                                     int sweeps)
 {
-  int i,j;
-  memset(y,0,sizeof(double)*self->parent.rows_count);
-  for (i = 0; i < self->parent.rows_count; ++ i)
-  {
-    y[i] = x[i];
+  int i,k,c,sweep;
+  int n = parent->rows_count;
+
+  /* copy parent member-wise */
+  self->parent = *parent;
+  /* first approximation */
+  self->ilu_diag = (double*)memdup(parent->diag,sizeof(double)*n);
+  self->ilu_lowertr = (double*)spcalloc(parent->tr_nonzeros,sizeof(double));
+  self->ilu_uppertr = (double*)memdup(parent->upper_triangle,
+                                      sizeof(double)*parent->tr_nonzeros);
+  for (i = 0; i < parent->tr_nonzeros; ++ i)
+    self->ilu_lowertr[i] = parent->lower_triangle[i]/parent->diag[parent->jptr[i]];
+
+  for (sweep = 0; sweep < sweeps; ++ sweep)
+  {
+    /*
+     * k-th task updates the k-th row of L, the k-th column of U and
+     * U_{kk}; the values from other tasks are used as they are at the
+     * moment (asynchronous iterations)
+     */
+    SP_PRAGMA(omp parallel for private(i,c) schedule(dynamic,64)
+              if (n > SP_PAR_MIN_SIZE))
+    for (k = 0; k < n; ++ k)
+    {
+      /* L_{kc} = (A_{kc} - \sum\limits_{m<c}L_{km}U_{mc})/U_{cc} */
+      for (i = parent->iptr[k]; i < parent->iptr[k+1]; ++ i)
+      {
+        c = parent->jptr[i];
+        self->ilu_lowertr[i] = (parent->lower_triangle[i] -
+                                ilu_row_col_prod(self,k,c,c))/
+          self->ilu_diag[c];
+      }
+      /* U_{ck} = A_{ck} - \sum\limits_{m<c}L_{cm}U_{mk} */
+      for (i = parent->iptr[k]; i < parent->iptr[k+1]; ++ i)
+      {
+        c = parent->jptr[i];
+        self->ilu_uppertr[i] = parent->upper_triangle[i] -
+          ilu_row_col_prod(self,c,k,c);
+      }
+      /* U_{kk} = A_{kk} - \sum\limits_{m<k}L_{km}U_{mk} */
+      self->ilu_diag[k] = parent->diag[k] - ilu_row_col_prod(self,k,k,k);
+    }
+  }
+}
+
+void sp_matrix_skyline_ilu_free(sp_matrix_skyline_ilu_ptr self)
+{
+  spfree(self->ilu_diag);
+  spfree(self->ilu_lowertr);
+  spfree(self->ilu_uppertr);
+  sp_matrix_skyline_free(&self->parent);
+}
+
+
+void sp_matrix_skyline_ilu_lower_mv(sp_matrix_skyline_ilu_ptr self,
+                                    double* x,
+                                    double* y)
+{
+  int i,j;
+  memset(y,0,sizeof(double)*self->parent.rows_count);
+  for (i = 0; i < self->parent.rows_count; ++ i)
+  {
+    y[i] = x[i];
     for (j = self->parent.iptr[i]; j < self->parent.iptr[i+1]; ++ j)
       y[i] += x[self->parent.jptr[j]]*self->ilu_lowertr[j];
   }
@@ -438,18 +1184,165 @@ void sp_matrix_skyline_ilu_upper_solve(sp_matrix_skyline_ilu_ptr self,
 }
 
 
-void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
-                                double* b,
-                                double* x0,
-                                int* max_iter,
-                                double* tolerance,
-                                double* x)
+/*
+ * Groups rows by levels: level[i] for every row i
+ * Fills offsets (levels+1 elements) and rows
+ */
+static void ilu_sched_group(int n, int levels, int* level,
+                            int* offsets, int* rows)
+{
+  int i;
+  memset(offsets,0,sizeof(int)*(levels+1));
+  for (i = 0; i < n; ++ i)
+    offsets[level[i]+1]++;
+  for (i = 0; i < levels; ++ i)
+    offsets[i+1] += offsets[i];
+  for (i = 0; i < n; ++ i)
+    rows[offsets[level[i]]++] = i;
+  for (i = levels; i > 0; -- i)
+    offsets[i] = offsets[i-1];
+  offsets[0] = 0;
+}
+
+void sp_matrix_skyline_ilu_sched_init(sp_matrix_skyline_ilu_sched_ptr self,
+                                      sp_matrix_skyline_ilu_ptr ilu)
+{
+  int i,j,p,q;
+  sp_matrix_skyline_ptr parent = &ilu->parent;
+  int n = parent->rows_count;
+  int* level = (int*)spcalloc(n,sizeof(int));
+  int* pos;
+
+  self->ilu = ilu;
+  self->temp = (double*)spcalloc(n,sizeof(double));
+
+  /*
+   * U is stored column-wise with the portrait of L: U_{jptr[q],i} for
+   * q = iptr[i]:iptr[i+1]-1. Convert it to the row-wise format
+   */
+  self->u_offsets = (int*)spcalloc(n+1,sizeof(int));
+  self->u_indicies = (int*)spcalloc(parent->tr_nonzeros+1,sizeof(int));
+  self->u_values = (double*)spcalloc(parent->tr_nonzeros+1,sizeof(double));
+  for (q = 0; q < parent->tr_nonzeros; ++ q)
+    self->u_offsets[parent->jptr[q]+1]++;
+  for (i = 0; i < n; ++ i)
+    self->u_offsets[i+1] += self->u_offsets[i];
+  pos = (int*)memdup(self->u_offsets,sizeof(int)*(n+1));
+  for (i = 0; i < n; ++ i)
+    for (q = parent->iptr[i]; q < parent->iptr[i+1]; ++ q)
+    {
+      p = pos[parent->jptr[q]]++;
+      self->u_indicies[p] = i;
+      self->u_values[p] = ilu->ilu_uppertr[q];
+    }
+  spfree(pos);
+
+  /* levels of L: row i depends on all rows j < i in its portrait */
+  self->lower_levels = 0;
+  for (i = 0; i < n; ++ i)
+  {
+    level[i] = 0;
+    for (q = parent->iptr[i]; q < parent->iptr[i+1]; ++ q)
+      if (level[parent->jptr[q]] + 1 > level[i])
+        level[i] = level[parent->jptr[q]] + 1;
+    if (level[i] + 1 > self->lower_levels)
+      self->lower_levels = level[i] + 1;
+  }
+  self->lower_offsets = (int*)spcalloc(self->lower_levels+1,sizeof(int));
+  self->lower_rows = (int*)spcalloc(n,sizeof(int));
+  ilu_sched_group(n,self->lower_levels,level,
+                  self->lower_offsets,self->lower_rows);
+  
+  /* levels of U: row i depends on all rows j > i in its portrait */
+  self->upper_levels = 0;
+  for (i = n-1; i >= 0; -- i)
+  {
+    level[i] = 0;
+    for (p = self->u_offsets[i]; p < self->u_offsets[i+1]; ++ p)
+      if (level[j = self->u_indicies[p]] + 1 > level[i])
+        level[i] = level[j] + 1;
+    if (level[i] + 1 > self->upper_levels)
+      self->upper_levels = level[i] + 1;
+  }
+  self->upper_offsets = (int*)spcalloc(self->upper_levels+1,sizeof(int));
+  self->upper_rows = (int*)spcalloc(n,sizeof(int));
+  ilu_sched_group(n,self->upper_levels,level,
+                  self->upper_offsets,self->upper_rows);
+  spfree(level);
+}
+
+void sp_matrix_skyline_ilu_sched_free(sp_matrix_skyline_ilu_sched_ptr self)
+{
+  spfree(self->lower_offsets);
+  spfree(self->lower_rows);
+  spfree(self->upper_offsets);
+  spfree(self->upper_rows);
+  spfree(self->u_offsets);
+  spfree(self->u_indicies);
+  spfree(self->u_values);
+  spfree(self->temp);
+}
+
+void sp_matrix_skyline_ilu_sched_solve(sp_matrix_skyline_ilu_sched_ptr self,
+                                       double* b,
+                                       double* x)
+{
+  int i,k,l,p;
+  double value;
+  sp_matrix_skyline_ilu_ptr ilu = self->ilu;
+  int* iptr = ilu->parent.iptr;
+  int* jptr = ilu->parent.jptr;
+  double* y = self->temp;
+
+  SP_PRAGMA(omp parallel private(i,k,l,p,value)
+            if (ilu->parent.rows_count > SP_PAR_MIN_SIZE))
+  {
+    /* L*y = b, L with unit diagonal */
+    for (l = 0; l < self->lower_levels; ++ l)
+    {
+      SP_PRAGMA(omp for schedule(static))
+      for (k = self->lower_offsets[l]; k < self->lower_offsets[l+1]; ++ k)
+      {
+        i = self->lower_rows[k];
+        value = b[i];
+        for (p = iptr[i]; p < iptr[i+1]; ++ p)
+          value -= ilu->ilu_lowertr[p]*y[jptr[p]];
+        y[i] = value;
+      }
+    }
+    /* U*x = y */
+    for (l = 0; l < self->upper_levels; ++ l)
+    {
+      SP_PRAGMA(omp for schedule(static))
+      for (k = self->upper_offsets[l]; k < self->upper_offsets[l+1]; ++ k)
+      {
+        i = self->upper_rows[k];
+        value = y[i];
+        for (p = self->u_offsets[i]; p < self->u_offsets[i+1]; ++ p)
+          value -= self->u_values[p]*x[self->u_indicies[p]];
+        x[i] = value/ilu->ilu_diag[i];
+      }
+    }
+  }
+}
+
+static void tfqmr(sp_matrix_yale_ptr self,
+                  sp_precond_solve_func precond,
+                  void* state,
+                  double* b,
+                  double* x0,
+                  int* max_iter,
+                  double* tolerance,
+                  double* x)
 {
   /* Transpose-Free Quasi-Minimal Residual Algorithm */
   /*
    * Based on the book:
    * Saad Y. Iterative methods for sparse linear systems (2ed., 2003)
    * page 235
+   *
+   * With preconditioner the method is applied to the right-preconditioned
+   * system A*M^{-1}*y = b, x = M^{-1}*y; vector d is kept as M^{-1}*d
    */
 
   /* variables */
@@ -471,8 +1364,12 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
   double* v[2];
   double* w;
   double* u[2];
+  double* Mu = 0;         /* M^{-1}*u_m */
+  double* pu;
   
   /* allocate memory for vectors */
+  if (precond)
+    Mu = (double*)spcalloc(msize,sizeof(double));
   r = (double*)spalloc(size);
   r1 = (double*)spalloc(size);
   temp = (double*)spalloc(size);
@@ -498,8 +1395,8 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
   memcpy(w,r,size);
   /* u_0 = r_0 */
   memcpy(u[1],r,size);
-  /* v_0 = A*u_0 */
-  sp_matrix_yale_mv(self,u[1],v[1]);
+  /* v_0 = A*M^{-1}*u_0 */
+  precond_mv(self,precond,state,u[1],Mu,v[1]);
 
   tau = norm2(r,msize);
   
@@ -524,8 +1421,8 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
         u[1][i] = u[0][i]-alpha*v[1][i]; /* u from old ? shall be u[1] */
     }
 
-    /* temp = A*u_m */
-    sp_matrix_yale_mv(self,u[0],temp);
+    /* temp = A*M^{-1}*u_m, pu = M^{-1}*u_m */
+    pu = precond_mv(self,precond,state,u[0],Mu,temp);
 
     /* w_{m+1} = w_m - alpha_m*A*u_m */
     for (i = 0; i < msize; ++ i)
@@ -534,7 +1431,7 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
     /* d_{m+1} = u_m + (theta^2_m/alpha_m)*eta_m*d_m */
     c = theta*theta/alpha*eta;
     for (i = 0; i < msize; ++ i)
-      d[i] = u[0][i] + c*d[i];
+      d[i] = pu[i] + c*d[i];
     
     /* theta_{m+1} = norm2(w_{m+1})/tau_m */
     theta = norm2(w,msize)/tau;
@@ -577,8 +1474,8 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
       /* v_{m+1} = A*u_{m+1} + beta_{m-1}*(A*u_m+beta_{m-1}*v_{m-1}) */
       for ( i = 0; i < msize; ++ i)
         v[1][i] = beta*(temp[i]+beta*v[0][i]);
-      /* temp = A*u_{m+1} */
-      sp_matrix_yale_mv(self,u[1],temp);
+      /* temp = A*M^{-1}*u_{m+1} */
+      precond_mv(self,precond,state,u[1],Mu,temp);
       for (i = 0; i < msize; ++ i)
         v[1][i] += temp[i];
     }
@@ -595,21 +1492,61 @@ void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
   spfree(w);
   spfree(u[0]);
   spfree(u[1]);
+  if (Mu)
+    spfree(Mu);
 }
 
+void sp_matrix_yale_solve_tfqmr(sp_matrix_yale_ptr self,
+                                double* b,
+                                double* x0,
+                                int* max_iter,
+                                double* tolerance,
+                                double* x)
+{
+  tfqmr(self,0,0,b,x0,max_iter,tolerance,x);
+}
 
-void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
-                              double* b,
-                              double* x0,
-                              int* max_iter,
-                              double* tolerance,
-                              double* x)
+void sp_matrix_yale_solve_tfqmr_ilu(sp_matrix_yale_ptr self,
+                                    sp_matrix_yale_ilu_ptr ilu,
+                                    double* b,
+                                    double* x0,
+                                    int* max_iter,
+                                    double* tolerance,
+                                    double* x)
+{
+  tfqmr(self,yale_ilu_precond_solve,ilu,b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_tfqmr_precond(sp_matrix_yale_ptr self,
+                                        sp_precond_ptr precond,
+                                        double* b,
+                                        double* x0,
+                                        int* max_iter,
+                                        double* tolerance,
+                                        double* x)
+{
+  tfqmr(self,precond_func(precond),precond_state(precond),
+        b,x0,max_iter,tolerance,x);
+}
+
+
+static void cgs(sp_matrix_yale_ptr self,
+                sp_precond_solve_func precond,
+                void* state,
+                double* b,
+                double* x0,
+                int* max_iter,
+                double* tolerance,
+                double* x)
 {
   /* Conjugate Gradient Squared Algorithm */
   /*
    * Based on the book:
    * Saad Y. Iterative methods for sparse linear systems (2ed., 2003)
    * page 229
+   *
+   * With preconditioner the method is applied to the right-preconditioned
+   * system A*M^{-1}*y = b, x = M^{-1}*y
    */
    
   /* variables */
@@ -626,8 +1563,11 @@ void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
   double* q;
   double* u;
   double* temp;
+  double* Mv = 0;         /* M^{-1}*p_j or M^{-1}*(u_j+q_j) */
 
   /* allocate memory for vectors */
+  if (precond)
+    Mv = (double*)spcalloc(msize,sizeof(double));
   r = (double*)spcalloc(msize,sizeof(double));
   r1 = (double*)spcalloc(msize,sizeof(double));
   p = (double*)spcalloc(msize,sizeof(double));
@@ -656,8 +1596,8 @@ void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
   /* CGS loop */
   for ( j = 0; j < max_iterations; j ++ )
   {
-    /* temp = A*p_j */
-    sp_matrix_yale_mv(self,p,temp);
+    /* temp = A*M^{-1}*p_j */
+    precond_mv(self,precond,state,p,Mv,temp);
     /* compute (r_j,r^*_0) and (A*p_j,r^*_0) */
     a1 = prod(r,r1,msize);      /* (r_j,r^*_0) */
     a2 = prod(temp,r1,msize);   /* (A*p_j,r^*_0) */
@@ -674,12 +1614,27 @@ void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
     for (i = 0; i < msize; ++ i)
       q[i] = u[i] - alpha*temp[i];
            
-    /* x_{j+1} = x_j+alpha_j(u_j+q_j) */
-    for (i = 0; i < msize; ++ i)
-      x[i] += alpha*(u[i] + q[i]);
+    if (!precond)
+    {
+      /* x_{j+1} = x_j+alpha_j(u_j+q_j) */
+      for (i = 0; i < msize; ++ i)
+        x[i] += alpha*(u[i] + q[i]);
 
-    /* temp = A*(u_j+q_j) */
-    sp_matrix_yale_mvsum(self,u,q,temp);
+      /* temp = A*(u_j+q_j) */
+      sp_matrix_yale_mvsum(self,u,q,temp);
+    }
+    else
+    {
+      /* x_{j+1} = x_j+alpha_j*M^{-1}*(u_j+q_j) */
+      for (i = 0; i < msize; ++ i)
+        temp[i] = u[i] + q[i];
+      precond(state,temp,Mv);
+      for (i = 0; i < msize; ++ i)
+        x[i] += alpha*Mv[i];
+
+      /* temp = A*M^{-1}*(u_j+q_j) */
+      sp_matrix_yale_mv(self,Mv,temp);
+    }
     
     /* r_{j+1} = r_j-alpha_j*A*(u_j+q_j) */
     for (i = 0; i < msize; ++ i)
@@ -713,4 +1668,723 @@ void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
   spfree(r1);
   spfree(q);
   spfree(u);
+  if (Mv)
+    spfree(Mv);
+}
+
+void sp_matrix_yale_solve_cgs(sp_matrix_yale_ptr self,
+                              double* b,
+                              double* x0,
+                              int* max_iter,
+                              double* tolerance,
+                              double* x)
+{
+  cgs(self,0,0,b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_cgs_ilu(sp_matrix_yale_ptr self,
+                                  sp_matrix_yale_ilu_ptr ilu,
+                                  double* b,
+                                  double* x0,
+                                  int* max_iter,
+                                  double* tolerance,
+                                  double* x)
+{
+  cgs(self,yale_ilu_precond_solve,ilu,b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_cgs_precond(sp_matrix_yale_ptr self,
+                                      sp_precond_ptr precond,
+                                      double* b,
+                                      double* x0,
+                                      int* max_iter,
+                                      double* tolerance,
+                                      double* x)
+{
+  cgs(self,precond_func(precond),precond_state(precond),
+      b,x0,max_iter,tolerance,x);
+}
+
+static void bicgstab(sp_matrix_yale_ptr self,
+                     sp_precond_solve_func precond,
+                     void* state,
+                     double* b,
+                     double* x0,
+                     int* max_iter,
+                     double* tolerance,
+                     double* x)
+{
+  /* Biconjugate Gradient Stabilized Algorithm */
+  /*
+   * Based on the book:
+   * Saad Y. Iterative methods for sparse linear systems (2ed., 2003)
+   * page 234
+   *
+   * With preconditioner the method is applied to the right-preconditioned
+   * system A*M^{-1}*y = b, x = M^{-1}*y
+   * Convergence is confirmed by the true residual b - A*x
+   */
+   
+  /* variables */
+  int i,j;
+  double alpha = 0, beta, omega = 0, rho, rho1 = 0, a1;
+  int restart = 1;
+  double residn = 0;
+  int size = sizeof(double)*self->rows_count;
+  int msize = self->rows_count;
+  int max_iterations = *max_iter;
+  double tol = *tolerance;
+  double* r;              /* residual */
+  double* r1;             /* r^*_0 */
+  double* p;              /* search direction */
+  double* v;              /* A*M^{-1}*p_j */
+  double* s;
+  double* t;              /* A*M^{-1}*s_j */
+  double* Mp = 0;         /* M^{-1}*p_j */
+  double* Ms = 0;         /* M^{-1}*s_j */
+  double* pp;
+  double* ps;
+
+  /* allocate memory for vectors */
+  r = (double*)spcalloc(msize,sizeof(double));
+  r1 = (double*)spcalloc(msize,sizeof(double));
+  p = (double*)spcalloc(msize,sizeof(double));
+  v = (double*)spcalloc(msize,sizeof(double));
+  s = (double*)spcalloc(msize,sizeof(double));
+  t = (double*)spcalloc(msize,sizeof(double));
+  if (precond)
+  {
+    Mp = (double*)spcalloc(msize,sizeof(double));
+    Ms = (double*)spcalloc(msize,sizeof(double));
+  }
+
+  /* x = x_0 */
+  memcpy(x,x0,size);
+
+  /* r_0 = b - A*x_0 */
+  sp_matrix_yale_mv(self,x0,r);
+  for ( i = 0; i < msize; ++ i)
+    r[i] = b[i] - r[i];
+  residn = norm2(r,msize);
+  /* r^*_0 = r_0 */
+  memcpy(r1,r,size);
+  
+  /* BiCGSTAB loop */
+  for ( j = 0; j < max_iterations && residn >= tol; j ++ )
+  {
+    /* rho_j = (r_j,r^*_0) */
+    rho = prod(r,r1,msize);
+    if (rho == 0)
+      break;
+    if (restart)
+    {
+      memcpy(p,r,size);
+      restart = 0;
+    }
+    else
+    {
+      /* beta_j = (rho_j/rho_{j-1})*(alpha_j/omega_j) */
+      beta = (rho/rho1)*(alpha/omega);
+      /* p_{j+1} = r_{j+1} + beta_j*(p_j - omega_j*A*p_j) */
+      for (i = 0; i < msize; ++ i)
+        p[i] = r[i] + beta*(p[i] - omega*v[i]);
+    }
+    rho1 = rho;
+    /* v = A*M^{-1}*p_j */
+    pp = precond_mv(self,precond,state,p,Mp,v);
+    /* alpha_j = (r_j,r^*_0)/(A*p_j,r^*_0) */
+    a1 = prod(v,r1,msize);
+    if (a1 == 0)
+      break;
+    alpha = rho/a1;
+    /* s_j = r_j - alpha_j*A*p_j */
+    for (i = 0; i < msize; ++ i)
+      s[i] = r[i] - alpha*v[i];
+    residn = norm2(s,msize);
+    if (residn < tol)
+    {
+      for (i = 0; i < msize; ++ i)
+        x[i] += alpha*pp[i];
+      /*
+       * verify the true residual; if the recurrence drifted away
+       * replace the residual and restart the search direction
+       */
+      residn = true_residual(self,b,x,r);
+      restart = 1;
+      continue;
+    }
+    /* t = A*M^{-1}*s_j */
+    ps = precond_mv(self,precond,state,s,Ms,t);
+    /* omega_j = (A*s_j,s_j)/(A*s_j,A*s_j) */
+    a1 = prod(t,t,msize);
+    omega = a1 != 0 ? prod(t,s,msize)/a1 : 0;
+    /* x_{j+1} = x_j + alpha_j*p_j + omega_j*s_j */
+    for (i = 0; i < msize; ++ i)
+      x[i] += alpha*pp[i] + omega*ps[i];
+    /* r_{j+1} = s_j - omega_j*A*s_j */
+    for (i = 0; i < msize; ++ i)
+      r[i] = s[i] - omega*t[i];
+    residn = norm2(r,msize);
+    /* verify the true residual, replace the residual if it drifted */
+    if (residn < tol)
+      residn = true_residual(self,b,x,r);
+    if (omega == 0)
+    {
+      j++;
+      break;
+    }
+  }
+  *max_iter = j;
+  *tolerance = residn;
+  
+  spfree(r);
+  spfree(r1);
+  spfree(p);
+  spfree(v);
+  spfree(s);
+  spfree(t);
+  if (precond)
+  {
+    spfree(Mp);
+    spfree(Ms);
+  }
+}
+
+void sp_matrix_yale_solve_bicgstab(sp_matrix_yale_ptr self,
+                                   double* b,
+                                   double* x0,
+                                   int* max_iter,
+                                   double* tolerance,
+                                   double* x)
+{
+  bicgstab(self,0,0,b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_bicgstab_ilu(sp_matrix_yale_ptr self,
+                                       sp_matrix_yale_ilu_ptr ilu,
+                                       double* b,
+                                       double* x0,
+                                       int* max_iter,
+                                       double* tolerance,
+                                       double* x)
+{
+  bicgstab(self,yale_ilu_precond_solve,ilu,b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_bicgstab_precond(sp_matrix_yale_ptr self,
+                                           sp_precond_ptr precond,
+                                           double* b,
+                                           double* x0,
+                                           int* max_iter,
+                                           double* tolerance,
+                                           double* x)
+{
+  bicgstab(self,precond_func(precond),precond_state(precond),
+           b,x0,max_iter,tolerance,x);
+}
+
+/*
+ * Adds the correction y to the solution x: x = x + M^{-1}*y
+ * and clears y
+ */
+static void flush_correction(sp_precond_solve_func precond,
+                             void* state,
+                             double* y,
+                             double* My,
+                             double* x,
+                             int size)
+{
+  int i;
+  double* z = y;
+  if (precond)
+  {
+    precond(state,y,My);
+    z = My;
+  }
+  for (i = 0; i < size; ++ i)
+    x[i] += z[i];
+  memset(y,0,size*sizeof(double));
+}
+
+static void bicgstabl(sp_matrix_yale_ptr self,
+                      int l,
+                      sp_precond_solve_func precond,
+                      void* state,
+                      double* b,
+                      double* x0,
+                      int* max_iter,
+                      double* tolerance,
+                      double* x)
+{
+  /* BiCGSTAB(l) Algorithm */
+  /*
+   * Based on the article:
+   * Sleijpen G.L.G., Fokkema D.R. BiCGstab(l) for linear equations
+   * involving unsymmetric matrices with complex spectrum (1993)
+   *
+   * With preconditioner the method is applied to the right-preconditioned
+   * system A*M^{-1}*y = b, x = M^{-1}*y; the correction of x is
+   * accumulated in the vector y and added to x when the convergence
+   * is checked by the true residual b - A*x
+   */
+
+  /* variables */
+  int i,j,k,m;
+  double alpha = 0, beta, omega = 1, rho0 = 1, rho1, gamma;
+  double residn = 0;
+  int size = sizeof(double)*self->rows_count;
+  int msize = self->rows_count;
+  int max_iterations = *max_iter;
+  double tol = *tolerance;
+  int breakdown = 0;
+  double** r;             /* residuals r_0..r_l */
+  double** u;             /* search directions u_0..u_l */
+  double* rt;             /* r^*_0 */
+  double* y;              /* accumulated correction of x */
+  double* My = 0;         /* M^{-1}*y or M^{-1}*u_j */
+  double* tau;            /* (l+1)x(l+1) Gram-Schmidt coefficients */
+  double* sigma;
+  double* g;              /* gamma_j */
+  double* g1;             /* gamma'_j */
+  double* g2;             /* gamma''_j */
+#define TAU(i,j) tau[(i)*(l+1)+(j)]
+
+  if (l < 1)
+    l = 1;
+  /* allocate memory for vectors */
+  r = (double**)spcalloc(l+1,sizeof(double*));
+  u = (double**)spcalloc(l+1,sizeof(double*));
+  for (j = 0; j <= l; ++ j)
+  {
+    r[j] = (double*)spcalloc(msize,sizeof(double));
+    u[j] = (double*)spcalloc(msize,sizeof(double));
+  }
+  rt = (double*)spcalloc(msize,sizeof(double));
+  y = (double*)spcalloc(msize,sizeof(double));
+  My = (double*)spcalloc(msize,sizeof(double));
+  tau = (double*)spcalloc((l+1)*(l+1),sizeof(double));
+  sigma = (double*)spcalloc(l+1,sizeof(double));
+  g = (double*)spcalloc(l+1,sizeof(double));
+  g1 = (double*)spcalloc(l+1,sizeof(double));
+  g2 = (double*)spcalloc(l+1,sizeof(double));
+
+  /* x = x_0 */
+  memcpy(x,x0,size);
+  /* r_0 = b - A*x_0 */
+  residn = true_residual(self,b,x,r[0]);
+  /* r^*_0 = r_0 */
+  memcpy(rt,r[0],size);
+
+  for (k = 0; k < max_iterations && residn >= tol && !breakdown; k += l)
+  {
+    rho0 = -omega*rho0;
+    /* BiCG part */
+    for (j = 0; j < l && !breakdown; ++ j)
+    {
+      rho1 = prod(r[j],rt,msize);
+      if (rho0 == 0)
+      {
+        breakdown = 1;
+        break;
+      }
+      beta = alpha*rho1/rho0;
+      rho0 = rho1;
+      for (i = 0; i <= j; ++ i)
+        for (m = 0; m < msize; ++ m)
+          u[i][m] = r[i][m] - beta*u[i][m];
+      /* u_{j+1} = A*M^{-1}*u_j */
+      precond_mv(self,precond,state,u[j],My,u[j+1]);
+      gamma = prod(u[j+1],rt,msize);
+      if (gamma == 0)
+      {
+        breakdown = 1;
+        break;
+      }
+      alpha = rho0/gamma;
+      for (i = 0; i <= j; ++ i)
+        for (m = 0; m < msize; ++ m)
+          r[i][m] -= alpha*u[i+1][m];
+      /* r_{j+1} = A*M^{-1}*r_j */
+      precond_mv(self,precond,state,r[j],My,r[j+1]);
+      for (m = 0; m < msize; ++ m)
+        y[m] += alpha*u[0][m];
+    }
+    if (breakdown)
+      break;
+    /* MR part: modified Gram-Schmidt orthogonalization of r_1..r_l */
+    for (j = 1; j <= l; ++ j)
+    {
+      for (i = 1; i < j; ++ i)
+      {
+        TAU(i,j) = prod(r[j],r[i],msize)/sigma[i];
+        for (m = 0; m < msize; ++ m)
+          r[j][m] -= TAU(i,j)*r[i][m];
+      }
+      sigma[j] = prod(r[j],r[j],msize);
+      if (sigma[j] == 0)
+      {
+        breakdown = 1;
+        break;
+      }
+      g1[j] = prod(r[0],r[j],msize)/sigma[j];
+    }
+    if (breakdown)
+      break;
+    g[l] = g1[l];
+    omega = g[l];
+    for (j = l-1; j >= 1; -- j)
+    {
+      g[j] = g1[j];
+      for (i = j+1; i <= l; ++ i)
+        g[j] -= TAU(j,i)*g[i];
+    }
+    for (j = 1; j < l; ++ j)
+    {
+      g2[j] = g[j+1];
+      for (i = j+1; i < l; ++ i)
+        g2[j] += TAU(j,i)*g[i+1];
+    }
+    /* update the solution, residual and search direction */
+    for (m = 0; m < msize; ++ m)
+    {
+      y[m] += g[1]*r[0][m];
+      r[0][m] -= g1[l]*r[l][m];
+      u[0][m] -= g[l]*u[l][m];
+    }
+    for (j = 1; j < l; ++ j)
+      for (m = 0; m < msize; ++ m)
+      {
+        u[0][m] -= g[j]*u[j][m];
+        y[m] += g2[j]*r[j][m];
+        r[0][m] -= g1[j]*r[j][m];
+      }
+    residn = norm2(r[0],msize);
+    /* verify the true residual, replace the residual if it drifted */
+    if (residn < tol)
+    {
+      flush_correction(precond,state,y,My,x,msize);
+      residn = true_residual(self,b,x,r[0]);
+    }
+  }
+  flush_correction(precond,state,y,My,x,msize);
+#undef TAU
+  *max_iter = k;
+  *tolerance = residn;
+
+  for (j = 0; j <= l; ++ j)
+  {
+    spfree(r[j]);
+    spfree(u[j]);
+  }
+  spfree(r);
+  spfree(u);
+  spfree(rt);
+  spfree(y);
+  spfree(My);
+  spfree(tau);
+  spfree(sigma);
+  spfree(g);
+  spfree(g1);
+  spfree(g2);
+}
+
+void sp_matrix_yale_solve_bicgstabl(sp_matrix_yale_ptr self,
+                                    int l,
+                                    sp_precond_ptr precond,
+                                    double* b,
+                                    double* x0,
+                                    int* max_iter,
+                                    double* tolerance,
+                                    double* x)
+{
+  bicgstabl(self,l,precond_func(precond),precond_state(precond),
+            b,x0,max_iter,tolerance,x);
+}
+
+/* Size of the row block used in the Krylov basis kernels */
+#define BASIS_BLOCK_SIZE 512
+
+/*
+ * Calculates h = V^T*w for k first vectors of the basis V
+ * V - k vectors of size n stored one after another
+ * The rows are processed by blocks in order to keep the
+ * block of w in cache while sweeping all vectors of the basis
+ */
+static void basis_dot(double* V, int k, int n, double* w, double* h)
+{
+  int i,j,start,end;
+  double sum;
+  double* v;
+  memset(h,0,sizeof(double)*k);
+  for (start = 0; start < n; start += BASIS_BLOCK_SIZE)
+  {
+    end = start + BASIS_BLOCK_SIZE < n ? start + BASIS_BLOCK_SIZE : n;
+    for (j = 0; j < k; ++ j)
+    {
+      v = V + (size_t)j*n;
+      sum = 0;
+      for (i = start; i < end; ++ i)
+        sum += v[i]*w[i];
+      h[j] += sum;
+    }
+  }
+}
+
+/*
+ * Calculates w = w - V*h for k first vectors of the basis V
+ */
+static void basis_update(double* V, int k, int n, double* h, double* w)
+{
+  int i,j,start,end;
+  double* v;
+  for (start = 0; start < n; start += BASIS_BLOCK_SIZE)
+  {
+    end = start + BASIS_BLOCK_SIZE < n ? start + BASIS_BLOCK_SIZE : n;
+    for (j = 0; j < k; ++ j)
+    {
+      v = V + (size_t)j*n;
+      for (i = start; i < end; ++ i)
+        w[i] -= h[j]*v[i];
+    }
+  }
+}
+
+static void yale_operator(void* state, double* x, double* y)
+{
+  sp_matrix_yale_mv((sp_matrix_yale_ptr)state,x,y);
+}
+
+static void gmres(int n,
+                  sp_operator_func op,
+                  void* op_state,
+                  int m,
+                  int flexible,
+                  sp_precond_solve_func precond,
+                  void* state,
+                  double* b,
+                  double* x0,
+                  int* max_iter,
+                  double* tolerance,
+                  double* x)
+{
+  /* Restarted Generalized Minimal Residual Algorithm */
+  /*
+   * Based on the book:
+   * Saad Y. Iterative methods for sparse linear systems (2ed., 2003)
+   * pages 172, 284 (right-preconditioned and flexible GMRES)
+   *
+   * Orthogonalization: classical Gram-Schmidt with reorthogonalization
+   * (CGS2), the Krylov basis stored contiguously
+   */
+
+  /* variables */
+  int i,j,k,iter = 0;
+  int size = sizeof(double)*n;
+  int max_iterations = *max_iter;
+  double tol = *tolerance;
+  double beta,residn,temp,hnext;
+  double* V;              /* Krylov basis, m+1 vectors */
+  double* Z = 0;          /* preconditioned basis for FGMRES, m vectors */
+  double* H;              /* (m+1)x m Hessenberg matrix, column-wise */
+  double* h;              /* reorthogonalization coefficients */
+  double* g;              /* right part of the least squares problem */
+  double* c;              /* Givens rotations */
+  double* s;
+  double* y;
+  double* w;
+  double* z;
+
+  if (m < 1)
+    m = 1;
+  /* allocate memory for vectors */
+  V = (double*)spcalloc((size_t)(m+1)*n,sizeof(double));
+  if (flexible && precond)
+    Z = (double*)spcalloc((size_t)m*n,sizeof(double));
+  H = (double*)spcalloc((m+1)*m,sizeof(double));
+  h = (double*)spcalloc(m+1,sizeof(double));
+  g = (double*)spcalloc(m+1,sizeof(double));
+  c = (double*)spcalloc(m,sizeof(double));
+  s = (double*)spcalloc(m,sizeof(double));
+  y = (double*)spcalloc(m,sizeof(double));
+  w = (double*)spcalloc(n,sizeof(double));
+  z = (double*)spcalloc(n,sizeof(double));
+
+  /* x = x_0 */
+  memcpy(x,x0,size);
+  /* r_0 = b - A*x_0 */
+  op(op_state,x,w);
+  for (i = 0; i < n; ++ i)
+    w[i] = b[i] - w[i];
+  residn = beta = norm2(w,n);
+  
+  while (iter < max_iterations && residn >= tol && beta != 0)
+  {
+    /* v_1 = r_0/beta */
+    for (i = 0; i < n; ++ i)
+      V[i] = w[i]/beta;
+    memset(g,0,sizeof(double)*(m+1));
+    g[0] = beta;
+    /* Arnoldi process */
+    for (j = 0; j < m && iter < max_iterations; )
+    {
+      /* w = A*M^{-1}*v_j */
+      if (precond)
+      {
+        precond(state,V+(size_t)j*n,Z ? Z+(size_t)j*n : z);
+        op(op_state,Z ? Z+(size_t)j*n : z,w);
+      }
+      else
+        op(op_state,V+(size_t)j*n,w);
+      /* CGS2: h = V^T*w, w = w - V*h, twice */
+      basis_dot(V,j+1,n,w,H+j*(m+1));
+      basis_update(V,j+1,n,H+j*(m+1),w);
+      basis_dot(V,j+1,n,w,h);
+      basis_update(V,j+1,n,h,w);
+      for (i = 0; i <= j; ++ i)
+        H[i+j*(m+1)] += h[i];
+      /* H_{j+1,j} is zeroed by the rotation, keep it for the breakdown */
+      hnext = norm2(w,n);
+      H[j+1+j*(m+1)] = hnext;
+      if (hnext != 0)
+        for (i = 0; i < n; ++ i)
+          V[(size_t)(j+1)*n+i] = w[i]/hnext;
+      /* apply previous Givens rotations to the new column */
+      for (i = 0; i < j; ++ i)
+      {
+        temp = c[i]*H[i+j*(m+1)] + s[i]*H[i+1+j*(m+1)];
+        H[i+1+j*(m+1)] = -s[i]*H[i+j*(m+1)] + c[i]*H[i+1+j*(m+1)];
+        H[i+j*(m+1)] = temp;
+      }
+      /* new rotation eliminating H_{j+1,j} */
+      temp = sqrt(H[j+j*(m+1)]*H[j+j*(m+1)] +
+                  H[j+1+j*(m+1)]*H[j+1+j*(m+1)]);
+      if (temp == 0)
+        break;
+      c[j] = H[j+j*(m+1)]/temp;
+      s[j] = H[j+1+j*(m+1)]/temp;
+      H[j+j*(m+1)] = temp;
+      H[j+1+j*(m+1)] = 0;
+      g[j+1] = -s[j]*g[j];
+      g[j] = c[j]*g[j];
+      ++ j;
+      ++ iter;
+      /* residual estimation */
+      residn = fabs(g[j]);
+      if (residn < tol || hnext == 0)
+        break;
+    }
+    k = j;
+    if (k == 0)
+      break;
+    /* solve H*y = g, H upper triangular k x k */
+    for (i = k-1; i >= 0; -- i)
+    {
+      y[i] = g[i];
+      for (j = i+1; j < k; ++ j)
+        y[i] -= H[i+j*(m+1)]*y[j];
+      y[i] /= H[i+i*(m+1)];
+    }
+    /* update the solution */
+    if (Z)
+    {
+      /* x = x + Z*y */
+      for (j = 0; j < k; ++ j)
+        y[j] = -y[j];
+      basis_update(Z,k,n,y,x);
+    }
+    else
+    {
+      /* x = x + M^{-1}*V*y */
+      memset(w,0,size);
+      for (j = 0; j < k; ++ j)
+        y[j] = -y[j];
+      basis_update(V,k,n,y,w);
+      if (precond)
+      {
+        precond(state,w,z);
+        for (i = 0; i < n; ++ i)
+          x[i] += z[i];
+      }
+      else
+        for (i = 0; i < n; ++ i)
+          x[i] += w[i];
+    }
+    /* true residual for the restart */
+    op(op_state,x,w);
+    for (i = 0; i < n; ++ i)
+      w[i] = b[i] - w[i];
+    residn = beta = norm2(w,n);
+  }
+  *max_iter = iter;
+  *tolerance = residn;
+
+  spfree(V);
+  if (Z)
+    spfree(Z);
+  spfree(H);
+  spfree(h);
+  spfree(g);
+  spfree(c);
+  spfree(s);
+  spfree(y);
+  spfree(w);
+  spfree(z);
+}
+
+void sp_matrix_yale_solve_gmres(sp_matrix_yale_ptr self,
+                                int m,
+                                sp_precond_ptr precond,
+                                double* b,
+                                double* x0,
+                                int* max_iter,
+                                double* tolerance,
+                                double* x)
+{
+  gmres(self->rows_count,yale_operator,self,m,0,
+        precond_func(precond),precond_state(precond),
+        b,x0,max_iter,tolerance,x);
+}
+
+void sp_matrix_yale_solve_fgmres(sp_matrix_yale_ptr self,
+                                 int m,
+                                 sp_precond_ptr precond,
+                                 double* b,
+                                 double* x0,
+                                 int* max_iter,
+                                 double* tolerance,
+                                 double* x)
+{
+  gmres(self->rows_count,yale_operator,self,m,1,
+        precond_func(precond),precond_state(precond),
+        b,x0,max_iter,tolerance,x);
+}
+
+void sp_operator_solve_gmres(int n,
+                             sp_operator_func op,
+                             void* op_state,
+                             int m,
+                             sp_precond_ptr precond,
+                             double* b,
+                             double* x0,
+                             int* max_iter,
+                             double* tolerance,
+                             double* x)
+{
+  gmres(n,op,op_state,m,0,precond_func(precond),precond_state(precond),
+        b,x0,max_iter,tolerance,x);
+}
+
+void sp_operator_solve_fgmres(int n,
+                              sp_operator_func op,
+                              void* op_state,
+                              int m,
+                              sp_precond_ptr precond,
+                              double* b,
+                              double* x0,
+                              int* max_iter,
+                              double* tolerance,
+                              double* x)
+{
+  gmres(n,op,op_state,m,1,precond_func(precond),precond_state(precond),
+        b,x0,max_iter,tolerance,x);
 }
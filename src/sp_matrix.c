@@ -19,6 +19,7 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <math.h>
 #include <assert.h>
@@ -29,6 +30,7 @@
 #include "sp_utils.h"
 #include "sp_tree.h"
 #include "sp_log.h"
+#include "sp_par.h"
 
 #define TRUE 1
 #define FALSE 0
@@ -433,6 +435,178 @@ void sp_matrix_yale_init(sp_matrix_yale_ptr self,
   self->offsets[i] = nonzeros;
 }
 
+/*
+ * Sorts the numbers of triplets order[0..len) by the key (minor[p],p)
+ * with Shell sort; the key is unique so the result is the same as
+ * of the stable sort by the minor index
+ */
+static void coo_line_sort(int* order, int len, const int* minor)
+{
+  int h,i,j,p;
+  for (h = 1; h < len/3; h = 3*h + 1);
+  for (; h > 0; h /= 3)
+    for (i = h; i < len; ++ i)
+    {
+      p = order[i];
+      for (j = i; j >= h && (minor[order[j-h]] > minor[p] ||
+                             (minor[order[j-h]] == minor[p] &&
+                              order[j-h] > p)); j -= h)
+        order[j] = order[j-h];
+      order[j] = p;
+    }
+}
+
+/*
+ * Parallel version of the conversion from the coordinate form:
+ * triplets are scattered to the lines with atomic counters, then
+ * every line is sorted independently. Gives the same result
+ * as the serial counting sort
+ */
+static void yale_init_coo_parallel(sp_matrix_yale_ptr self,
+                                   int n,
+                                   int nonzeros,
+                                   const int* major,
+                                   const int* minor,
+                                   const double* values)
+{
+  int i,p,q;
+  int* offsets = spcalloc(n+1,sizeof(int));
+  int* fill = spcalloc(n+1,sizeof(int));
+  int* order = spalloc((nonzeros+1)*sizeof(int));
+  /* 1. sizes of the lines */
+  SP_PRAGMA(omp parallel for schedule(static))
+  for (p = 0; p < nonzeros; ++ p)
+  {
+    SP_PRAGMA(omp atomic)
+    offsets[major[p]+1]++;
+  }
+  for (i = 0; i < n; ++ i)
+    offsets[i+1] += offsets[i];
+  memcpy(fill,offsets,n*sizeof(int));
+  /* 2. scatter the numbers of triplets to the lines */
+  SP_PRAGMA(omp parallel for private(q) schedule(static))
+  for (p = 0; p < nonzeros; ++ p)
+  {
+    SP_PRAGMA(omp atomic capture)
+    q = fill[major[p]]++;
+    order[q] = p;
+  }
+  /* 3. sort the lines, count the unique elements */
+  SP_PRAGMA(omp parallel for private(p) schedule(dynamic,64))
+  for (i = 0; i < n; ++ i)
+  {
+    coo_line_sort(order + offsets[i],offsets[i+1] - offsets[i],minor);
+    fill[i] = 0;
+    for (p = offsets[i]; p < offsets[i+1]; ++ p)
+      if (p == offsets[i] || minor[order[p]] != minor[order[p-1]])
+        fill[i]++;
+  }
+  self->offsets = spcalloc(n+1,sizeof(int));
+  for (i = 0; i < n; ++ i)
+    self->offsets[i+1] = self->offsets[i] + fill[i];
+  self->nonzeros = self->offsets[n];
+  self->indicies = spalloc((self->nonzeros+1)*sizeof(int));
+  self->values = spalloc((self->nonzeros+1)*sizeof(double));
+  /* 4. fill the lines summing the duplicates */
+  SP_PRAGMA(omp parallel for private(p,q) schedule(dynamic,64))
+  for (i = 0; i < n; ++ i)
+  {
+    q = self->offsets[i] - 1;
+    for (p = offsets[i]; p < offsets[i+1]; ++ p)
+      if (p > offsets[i] && minor[order[p]] == minor[order[p-1]])
+        self->values[q] += values[order[p]];
+      else
+      {
+        self->indicies[++q] = minor[order[p]];
+        self->values[q] = values[order[p]];
+      }
+  }
+  spfree(offsets);
+  spfree(fill);
+  spfree(order);
+}
+
+int sp_matrix_yale_init_coo(sp_matrix_yale_ptr self,
+                            sparse_storage_type type,
+                            int rows_count,
+                            int cols_count,
+                            int nonzeros,
+                            const int* rows,
+                            const int* cols,
+                            const double* values)
+{
+  int n = type == CRS ? rows_count : cols_count;
+  int m = type == CRS ? cols_count : rows_count;
+  const int* major = type == CRS ? rows : cols;
+  const int* minor = type == CRS ? cols : rows;
+  int i,p,q,begin,end;
+  int* count;
+  int* order;
+  for (p = 0; p < nonzeros; ++ p)
+    if (rows[p] < 0 || rows[p] >= rows_count ||
+        cols[p] < 0 || cols[p] >= cols_count)
+    {
+      LOGERROR("Element (%d,%d) is out of range of the matrix %dx%d",
+               rows[p],cols[p],rows_count,cols_count);
+      return 0;
+    }
+  memset(self,0,sizeof(sp_matrix_yale));
+  self->storage_type = type;
+  self->rows_count = rows_count;
+  self->cols_count = cols_count;
+  if (sp_par_max_threads() > 1 && nonzeros > SP_PAR_MIN_SIZE)
+  {
+    yale_init_coo_parallel(self,n,nonzeros,major,minor,values);
+    return 1;
+  }
+  count = spcalloc(int_max(n,m)+1,sizeof(int));
+  order = spalloc((nonzeros+1)*sizeof(int));
+  /* 1. stable counting sort of the triplets by the minor index */
+  for (p = 0; p < nonzeros; ++ p)
+    count[minor[p]+1]++;
+  for (i = 0; i < m; ++ i)
+    count[i+1] += count[i];
+  for (p = 0; p < nonzeros; ++ p)
+    order[count[minor[p]]++] = p;
+  /* 2. stable counting sort by the major index gives sorted lines */
+  self->offsets = spcalloc(n+1,sizeof(int));
+  self->indicies = spalloc((nonzeros+1)*sizeof(int));
+  self->values = spalloc((nonzeros+1)*sizeof(double));
+  for (p = 0; p < nonzeros; ++ p)
+    self->offsets[major[p]+1]++;
+  for (i = 0; i < n; ++ i)
+    self->offsets[i+1] += self->offsets[i];
+  memcpy(count,self->offsets,n*sizeof(int));
+  for (q = 0; q < nonzeros; ++ q)
+  {
+    p = order[q];
+    self->indicies[count[major[p]]] = minor[p];
+    self->values[count[major[p]]++] = values[p];
+  }
+  /* 3. sum the duplicates */
+  q = 0;
+  begin = 0;
+  for (i = 0; i < n; ++ i)
+  {
+    end = self->offsets[i+1];
+    self->offsets[i] = q;
+    for (p = begin; p < end; ++ p)
+      if (q > self->offsets[i] && self->indicies[q-1] == self->indicies[p])
+        self->values[q-1] += self->values[p];
+      else
+      {
+        self->indicies[q] = self->indicies[p];
+        self->values[q++] = self->values[p];
+      }
+    begin = end;
+  }
+  self->offsets[n] = q;
+  self->nonzeros = q;
+  spfree(count);
+  spfree(order);
+  return 1;
+}
+
 /*
  * Creates the sparse matrix in Yale format
  * using given size and row/column counts
@@ -723,6 +897,9 @@ void sp_matrix_yale_mv(sp_matrix_yale_ptr self,double* x, double* y)
   memset(y,0,sizeof(double)*self->rows_count);
   if (self->storage_type == CRS)
   {
+    /* rows are independent */
+    SP_PRAGMA(omp parallel for private(j) schedule(static)
+              if (self->rows_count > SP_PAR_MIN_SIZE))
     for ( i = 0; i < self->rows_count; ++ i)
       for ( j = self->offsets[i]; j < self->offsets[i+1]; ++ j)
         y[i] += self->values[j]*x[self->indicies[j]];
@@ -760,6 +937,87 @@ void sp_matrix_yale_mvsum(sp_matrix_yale_ptr self,
 }
 
 
+/*
+ * Number of vectors processed in one pass over the matrix in
+ * sp_matrix_yale_mm: accumulators of the row are kept in registers
+ */
+#ifndef SP_MM_BLOCK
+#define SP_MM_BLOCK 8
+#endif
+
+void sp_matrix_yale_mm(sp_matrix_yale_ptr self,
+                       int k,
+                       sp_dense_layout layout,
+                       double* X,
+                       double* Y)
+{
+  int i,j,p,c,c0,kc;
+  double value;
+  double* x;
+  /* strides of the rows and vectors in X and Y */
+  size_t xrs = layout == SP_ROW_MAJOR ? (size_t)k : 1;
+  size_t xcs = layout == SP_ROW_MAJOR ? 1 : (size_t)self->cols_count;
+  size_t yrs = layout == SP_ROW_MAJOR ? (size_t)k : 1;
+  size_t ycs = layout == SP_ROW_MAJOR ? 1 : (size_t)self->rows_count;
+  if (self->storage_type == CRS)
+  {
+    /* rows are independent */
+    SP_PRAGMA(omp parallel for private(j,p,c,c0,kc,value,x) \
+              schedule(static) if (self->rows_count > SP_PAR_MIN_SIZE))
+    for (i = 0; i < self->rows_count; ++ i)
+    {
+      double acc[SP_MM_BLOCK];
+      for (c0 = 0; c0 < k; c0 += SP_MM_BLOCK)
+      {
+        kc = k - c0 < SP_MM_BLOCK ? k - c0 : SP_MM_BLOCK;
+        for (c = 0; c < kc; ++ c)
+          acc[c] = 0;
+        for (p = self->offsets[i]; p < self->offsets[i+1]; ++ p)
+        {
+          value = self->values[p];
+          x = X + self->indicies[p]*xrs + c0*xcs;
+          if (xcs == 1)
+          {
+            SP_PRAGMA(omp simd)
+            for (c = 0; c < kc; ++ c)
+              acc[c] += value*x[c];
+          }
+          else
+            for (c = 0; c < kc; ++ c)
+              acc[c] += value*x[c*xcs];
+        }
+        for (c = 0; c < kc; ++ c)
+          Y[i*yrs + (c0+c)*ycs] = acc[c];
+      }
+    }
+  }
+  else                          /* CCS */
+  {
+    /* vectors are independent: threads work on the different vectors */
+    SP_PRAGMA(omp parallel for private(i,j,p,c,kc,value,x) \
+              schedule(static) if (k > SP_MM_BLOCK))
+    for (c0 = 0; c0 < k; c0 += SP_MM_BLOCK)
+    {
+      kc = k - c0 < SP_MM_BLOCK ? k - c0 : SP_MM_BLOCK;
+      for (i = 0; i < self->rows_count; ++ i)
+        for (c = 0; c < kc; ++ c)
+          Y[i*yrs + (c0+c)*ycs] = 0;
+      for (j = 0; j < self->cols_count; ++ j)
+      {
+        x = X + j*xrs + c0*xcs;
+        for (p = self->offsets[j]; p < self->offsets[j+1]; ++ p)
+        {
+          value = self->values[p];
+          i = self->indicies[p];
+          for (c = 0; c < kc; ++ c)
+            Y[i*yrs + (c0+c)*ycs] += value*x[c*xcs];
+        }
+      }
+    }
+  }
+}
+
+
 void sp_matrix_printf2(sp_matrix_ptr self)
 {
   double *p;
@@ -783,6 +1041,7 @@ void sp_matrix_yale_transpose(sp_matrix_yale_ptr self,
                               sp_matrix_yale_ptr to)
 {
   int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  int m = self->storage_type == CRS ? self->cols_count : self->rows_count;
   int maxsize = int_max(self->rows_count,self->cols_count);
   int i,j,k,p;
   int* offsets = spcalloc(maxsize+1,sizeof(int));
@@ -797,7 +1056,7 @@ void sp_matrix_yale_transpose(sp_matrix_yale_ptr self,
                        self->nonzeros,offsets+1);
 
   /* 3. offsets - partial sums of counts of row/columns */
-  memcpy(offsets,to->offsets,(n+1)*sizeof(int));
+  memcpy(offsets,to->offsets,(m+1)*sizeof(int));
   for ( i = 0; i < n; ++i)
   {
     for ( p = self->offsets[i]; p < self->offsets[i+1]; ++p )
@@ -843,6 +1102,495 @@ int sp_matrix_yale_convert_inplace(sp_matrix_yale_ptr self,
   return 0;
 }
 
+/*
+ * Sparse matrix-matrix product
+ *
+ * Gustavson algorithm: the row i of C is the linear combination of
+ * rows of B with coefficients from the row i of A. Rows of C are
+ * independent and calculated in parallel. Every row uses the dense
+ * accumulator (marker array of the size of the row of C) or, if the
+ * upper bound of the row length is small compared to the row size,
+ * the hash accumulator which fits in the cache.
+ *
+ * The product of 2 CCS matricies is calculated as the product of their
+ * transposed CRS representations: C^T = B^T*A^T
+ */
+
+/* Hash accumulator is used if the row length bound * ratio < row size */
+#define MULT_HASH_RATIO 16
+#define MULT_HASH_FACTOR 2654435761u
+
+/*
+ * Operands of the row-wise product: left and right matricies
+ * treated as CRS, converted if necessary
+ */
+typedef struct
+{
+  sp_matrix_yale_ptr left;
+  sp_matrix_yale_ptr right;
+  sp_matrix_yale converted;     /* converted operand, if any */
+  int has_converted;
+  sparse_storage_type type;     /* storage type of the result */
+} mult_operands;
+
+static int mult_operands_init(mult_operands* self,
+                              sp_matrix_yale_ptr A,
+                              sp_matrix_yale_ptr B)
+{
+  if (A->cols_count != B->rows_count)
+  {
+    LOGERROR("Matrix product: sizes %dx%d and %dx%d are not consistent",
+             A->rows_count,A->cols_count,B->rows_count,B->cols_count);
+    return 0;
+  }
+  self->has_converted = 0;
+  self->type = CRS;
+  self->left = A;
+  self->right = B;
+  if (A->storage_type == CCS && B->storage_type == CCS)
+  {
+    self->type = CCS;
+    self->left = B;
+    self->right = A;
+  }
+  else if (A->storage_type == CCS)
+  {
+    self->has_converted = sp_matrix_yale_convert(A,&self->converted,CRS);
+    self->left = &self->converted;
+  }
+  else if (B->storage_type == CCS)
+  {
+    self->has_converted = sp_matrix_yale_convert(B,&self->converted,CRS);
+    self->right = &self->converted;
+  }
+  return 1;
+}
+
+static void mult_operands_free(mult_operands* self)
+{
+  if (self->has_converted)
+    sp_matrix_yale_free(&self->converted);
+}
+
+/* Number of rows in the compressed storage */
+static int yale_compressed_size(sp_matrix_yale_ptr self)
+{
+  return self->storage_type == CRS ? self->rows_count : self->cols_count;
+}
+
+static int yale_other_size(sp_matrix_yale_ptr self)
+{
+  return self->storage_type == CRS ? self->cols_count : self->rows_count;
+}
+
+/*
+ * Hash table size for the row i of the product or 0 if the dense
+ * accumulator shall be used; width - size of the row
+ */
+static int mult_hash_size(sp_matrix_yale_ptr L,
+                          sp_matrix_yale_ptr R,
+                          int i,
+                          int width)
+{
+  int p,k,size = 1;
+  long bound = 0;
+  for (p = L->offsets[i]; p < L->offsets[i+1]; ++ p)
+  {
+    k = L->indicies[p];
+    bound += R->offsets[k+1] - R->offsets[k];
+  }
+  if (bound*MULT_HASH_RATIO >= width)
+    return 0;
+  while (size < 2*bound)
+    size <<= 1;
+  return size;
+}
+
+static int int_compare(const void* a, const void* b)
+{
+  return *(const int*)a - *(const int*)b;
+}
+
+/*
+ * Portrait of the row i of the product
+ * marker - work array of width elements filled with -1,
+ * restored after the call
+ * out - output indicies, 0 to count only
+ * Returns number of elements in the row
+ */
+static int mult_row_pattern(sp_matrix_yale_ptr L,
+                            sp_matrix_yale_ptr R,
+                            int i,
+                            int width,
+                            int* marker,
+                            int* out)
+{
+  int p,q,j,h,count = 0;
+  int size = mult_hash_size(L,R,i,width);
+  for (p = L->offsets[i]; p < L->offsets[i+1]; ++ p)
+    for (q = R->offsets[L->indicies[p]];
+         q < R->offsets[L->indicies[p]+1]; ++ q)
+    {
+      j = R->indicies[q];
+      if (size)
+      {
+        /* hash accumulator: open addressing in first size elements */
+        h = (int)(((unsigned)j*MULT_HASH_FACTOR) & (size - 1));
+        while (marker[h] != -1 && marker[h] != j)
+          h = (h + 1) & (size - 1);
+        if (marker[h] == j)
+          continue;
+        marker[h] = j;
+      }
+      else
+      {
+        if (marker[j] == -2)
+          continue;
+        marker[j] = -2;
+      }
+      if (out)
+        out[count] = j;
+      count++;
+    }
+  /* restore the marker */
+  if (size)
+    for (h = 0; h < size; ++ h)
+      marker[h] = -1;
+  else if (out)
+    for (p = 0; p < count; ++ p)
+      marker[out[p]] = -1;
+  else
+    for (p = L->offsets[i]; p < L->offsets[i+1]; ++ p)
+      for (q = R->offsets[L->indicies[p]];
+           q < R->offsets[L->indicies[p]+1]; ++ q)
+        marker[R->indicies[q]] = -1;
+  return count;
+}
+
+/*
+ * Values of the row i of the product C
+ * marker - work array of width elements filled with -1,
+ * restored after the call
+ * Returns 0 if the product has the element outside the portrait of C
+ */
+static int mult_row_values(sp_matrix_yale_ptr L,
+                           sp_matrix_yale_ptr R,
+                           sp_matrix_yale_ptr C,
+                           int i,
+                           int width,
+                           int* marker)
+{
+  int p,q,j,h,pos,result = 1;
+  int size = mult_hash_size(L,R,i,width);
+  int* keys;
+  int* positions;
+  double a;
+  /* the table shall keep the whole row of C */
+  if (2*(C->offsets[i+1] - C->offsets[i]) > size)
+    size = 0;
+  keys = marker;
+  positions = marker + size;
+  for (q = C->offsets[i]; q < C->offsets[i+1]; ++ q)
+  {
+    C->values[q] = 0;
+    j = C->indicies[q];
+    if (size)
+    {
+      h = (int)(((unsigned)j*MULT_HASH_FACTOR) & (size - 1));
+      while (keys[h] != -1)
+        h = (h + 1) & (size - 1);
+      keys[h] = j;
+      positions[h] = q;
+    }
+    else
+      marker[j] = q;
+  }
+  for (p = L->offsets[i]; p < L->offsets[i+1]; ++ p)
+  {
+    a = L->values[p];
+    for (q = R->offsets[L->indicies[p]];
+         q < R->offsets[L->indicies[p]+1]; ++ q)
+    {
+      j = R->indicies[q];
+      if (size)
+      {
+        h = (int)(((unsigned)j*MULT_HASH_FACTOR) & (size - 1));
+        while (keys[h] != -1 && keys[h] != j)
+          h = (h + 1) & (size - 1);
+        pos = keys[h] == j ? positions[h] : -1;
+      }
+      else
+        pos = marker[j];
+      if (pos < 0)
+      {
+        result = 0;
+        continue;
+      }
+      C->values[pos] += a*R->values[q];
+    }
+  }
+  /* restore the marker */
+  if (size)
+    for (h = 0; h < 2*size; ++ h)
+      marker[h] = -1;
+  else
+    for (q = C->offsets[i]; q < C->offsets[i+1]; ++ q)
+      marker[C->indicies[q]] = -1;
+  return result;
+}
+
+/* Allocates filled with -1 work arrays of size width for all threads */
+static int* mult_markers(int width, int* stride)
+{
+  int i;
+  int count;
+  int* markers;
+  *stride = width + 1;
+  count = *stride*sp_par_max_threads();
+  markers = spalloc(count*sizeof(int));
+  for (i = 0; i < count; ++ i)
+    markers[i] = -1;
+  return markers;
+}
+
+int sp_matrix_yale_mult_symbolic(sp_matrix_yale_ptr A,
+                                 sp_matrix_yale_ptr B,
+                                 sp_matrix_yale_ptr C)
+{
+  mult_operands op;
+  sp_matrix_yale_ptr L,R;
+  int i,n,width,stride;
+  int* offsets;
+  int* markers;
+  if (!mult_operands_init(&op,A,B))
+    return 0;
+  L = op.left;
+  R = op.right;
+  n = yale_compressed_size(L);
+  width = yale_other_size(R);
+  markers = mult_markers(width,&stride);
+  offsets = spcalloc(n+1,sizeof(int));
+  /* 1. row sizes */
+  SP_PRAGMA(omp parallel for schedule(dynamic,64) if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+    offsets[i+1] = mult_row_pattern(L,R,i,width,
+                                    markers + sp_par_thread_num()*stride,0);
+  for (i = 0; i < n; ++ i)
+    offsets[i+1] += offsets[i];
+  /* 2. the portrait */
+  memset(C,0,sizeof(sp_matrix_yale));
+  C->storage_type = op.type;
+  C->rows_count = A->rows_count;
+  C->cols_count = B->cols_count;
+  C->nonzeros = offsets[n];
+  C->offsets = offsets;
+  C->indicies = spalloc((C->nonzeros+1)*sizeof(int));
+  C->values = spcalloc(C->nonzeros+1,sizeof(double));
+  SP_PRAGMA(omp parallel for schedule(dynamic,64) if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+  {
+    mult_row_pattern(L,R,i,width,markers + sp_par_thread_num()*stride,
+                     C->indicies + offsets[i]);
+    qsort(C->indicies + offsets[i],offsets[i+1] - offsets[i],
+          sizeof(int),int_compare);
+  }
+  spfree(markers);
+  mult_operands_free(&op);
+  return 1;
+}
+
+int sp_matrix_yale_mult_numeric(sp_matrix_yale_ptr A,
+                                sp_matrix_yale_ptr B,
+                                sp_matrix_yale_ptr C)
+{
+  mult_operands op;
+  sp_matrix_yale_ptr L,R;
+  int i,n,width,stride;
+  int result = 1;
+  int* markers;
+  if (!mult_operands_init(&op,A,B))
+    return 0;
+  L = op.left;
+  R = op.right;
+  n = yale_compressed_size(L);
+  width = yale_other_size(R);
+  if (C->storage_type != op.type || C->rows_count != A->rows_count ||
+      C->cols_count != B->cols_count)
+  {
+    LOGERROR("Matrix product: wrong format of the result");
+    mult_operands_free(&op);
+    return 0;
+  }
+  markers = mult_markers(width,&stride);
+  SP_PRAGMA(omp parallel for schedule(dynamic,64) if (n > SP_PAR_MIN_SIZE) \
+            reduction(&&:result))
+  for (i = 0; i < n; ++ i)
+    result = mult_row_values(L,R,C,i,width,
+                             markers + sp_par_thread_num()*stride) && result;
+  if (!result)
+    LOGERROR("Matrix product: portrait of the result differs from the "
+             "symbolic one");
+  spfree(markers);
+  mult_operands_free(&op);
+  return result;
+}
+
+int sp_matrix_yale_mult(sp_matrix_yale_ptr A,
+                        sp_matrix_yale_ptr B,
+                        sp_matrix_yale_ptr C)
+{
+  if (!sp_matrix_yale_mult_symbolic(A,B,C))
+    return 0;
+  return sp_matrix_yale_mult_numeric(A,B,C);
+}
+
+/*
+ * Merges the sorted row i of A and B: calculates number of elements
+ * in the union or, if C is not 0, fills the row of C
+ */
+static int add_row(double alpha,
+                   sp_matrix_yale_ptr A,
+                   double beta,
+                   sp_matrix_yale_ptr B,
+                   sp_matrix_yale_ptr C,
+                   int i)
+{
+  int p = A->offsets[i], pend = A->offsets[i+1];
+  int q = B->offsets[i], qend = B->offsets[i+1];
+  int k = C ? C->offsets[i] : 0;
+  int start = k;
+  int j;
+  double value;
+  while (p < pend || q < qend)
+  {
+    if (q == qend || (p < pend && A->indicies[p] < B->indicies[q]))
+    {
+      j = A->indicies[p];
+      value = alpha*A->values[p++];
+    }
+    else if (p == pend || B->indicies[q] < A->indicies[p])
+    {
+      j = B->indicies[q];
+      value = beta*B->values[q++];
+    }
+    else
+    {
+      j = A->indicies[p];
+      value = alpha*A->values[p++] + beta*B->values[q++];
+    }
+    if (C)
+    {
+      C->indicies[k] = j;
+      C->values[k] = value;
+    }
+    k++;
+  }
+  return k - start;
+}
+
+int sp_matrix_yale_add(double alpha,
+                       sp_matrix_yale_ptr A,
+                       double beta,
+                       sp_matrix_yale_ptr B,
+                       sp_matrix_yale_ptr C)
+{
+  sp_matrix_yale converted;
+  int has_converted;
+  int i,n;
+  if (A->rows_count != B->rows_count || A->cols_count != B->cols_count)
+  {
+    LOGERROR("Matrix sum: sizes %dx%d and %dx%d are not consistent",
+             A->rows_count,A->cols_count,B->rows_count,B->cols_count);
+    return 0;
+  }
+  has_converted = sp_matrix_yale_convert(B,&converted,A->storage_type);
+  if (has_converted)
+    B = &converted;
+  n = A->storage_type == CRS ? A->rows_count : A->cols_count;
+  memset(C,0,sizeof(sp_matrix_yale));
+  C->storage_type = A->storage_type;
+  C->rows_count = A->rows_count;
+  C->cols_count = A->cols_count;
+  C->offsets = spcalloc(n+1,sizeof(int));
+  /* 1. sizes of rows/columns */
+  SP_PRAGMA(omp parallel for schedule(static) if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+    C->offsets[i+1] = add_row(alpha,A,beta,B,0,i);
+  for (i = 0; i < n; ++ i)
+    C->offsets[i+1] += C->offsets[i];
+  C->nonzeros = C->offsets[n];
+  C->indicies = spalloc((C->nonzeros+1)*sizeof(int));
+  C->values = spalloc((C->nonzeros+1)*sizeof(double));
+  /* 2. merge */
+  SP_PRAGMA(omp parallel for schedule(static) if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+    add_row(alpha,A,beta,B,C,i);
+  if (has_converted)
+    sp_matrix_yale_free(&converted);
+  return 1;
+}
+
+int sp_matrix_yale_add_inplace(double alpha,
+                               sp_matrix_yale_ptr A,
+                               double beta,
+                               sp_matrix_yale_ptr B)
+{
+  int i,p,q,n;
+  int result = 1;
+  if (A->rows_count != B->rows_count || A->cols_count != B->cols_count ||
+      A->storage_type != B->storage_type)
+  {
+    LOGERROR("Matrix sum: matricies are not consistent");
+    return 0;
+  }
+  n = A->storage_type == CRS ? A->rows_count : A->cols_count;
+  SP_PRAGMA(omp parallel for private(p,q) schedule(static) \
+            if (n > SP_PAR_MIN_SIZE) reduction(&&:result))
+  for (i = 0; i < n; ++ i)
+  {
+    p = A->offsets[i];
+    for (q = B->offsets[i]; q < B->offsets[i+1]; ++ q)
+    {
+      /* scale elements of A missing in B */
+      for (; p < A->offsets[i+1] && A->indicies[p] < B->indicies[q]; ++ p)
+        A->values[p] *= alpha;
+      if (p == A->offsets[i+1] || A->indicies[p] != B->indicies[q])
+      {
+        result = 0;
+        break;
+      }
+      A->values[p] = alpha*A->values[p] + beta*B->values[q];
+      p++;
+    }
+    for (; p < A->offsets[i+1]; ++ p)
+      A->values[p] *= alpha;
+  }
+  if (!result)
+    LOGERROR("Matrix sum: portrait of B is not a subset of portrait of A");
+  return result;
+}
+
+void sp_matrix_yale_scale(sp_matrix_yale_ptr self,
+                          double* rows,
+                          double* cols)
+{
+  int i,p;
+  int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  /* scaling of the compressed and the index dimensions */
+  double* outer = self->storage_type == CRS ? rows : cols;
+  double* inner = self->storage_type == CRS ? cols : rows;
+  SP_PRAGMA(omp parallel for private(p) schedule(static) \
+            if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+    for (p = self->offsets[i]; p < self->offsets[i+1]; ++ p)
+    {
+      if (outer)
+        self->values[p] *= outer[i];
+      if (inner)
+        self->values[p] *= inner[self->indicies[p]];
+    }
+}
+
 
 
 
@@ -881,6 +1629,20 @@ int sp_matrix_yale_permute(sp_matrix_yale_ptr self,
 }
 
 
+uint64_t sp_matrix_yale_pattern_hash(sp_matrix_yale_ptr self)
+{
+  uint64_t hash = SP_FNV_OFFSET_BASIS;
+  int n = self->storage_type == CRS ? self->rows_count : self->cols_count;
+  int header[4];
+  header[0] = self->storage_type;
+  header[1] = self->rows_count;
+  header[2] = self->cols_count;
+  header[3] = self->nonzeros;
+  hash = sp_fnv1a(hash,header,sizeof(header));
+  hash = sp_fnv1a(hash,self->offsets,(n+1)*sizeof(int));
+  return sp_fnv1a(hash,self->indicies,self->nonzeros*sizeof(int));
+}
+
 matrix_properties sp_matrix_yale_properites(sp_matrix_yale_ptr self)
 {
   matrix_properties props = PROP_GENERAL;
@@ -0,0 +1,1382 @@
+/* -*- Mode: C; tab-width: 2; indent-tabs-mode: nil; c-basic-offset: 2 -*- */
+/*
+  Copyright (C) 2011,2012 Alexey Veretennikov (alexey dot veretennikov at gmail.com)
+
+  This file is part of libspmatrix.
+
+  libspmatrix is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published
+  by the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  libspmatrix is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with libspmatrix.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sp_precond.h"
+#include "sp_mem.h"
+#include "sp_utils.h"
+#include "sp_log.h"
+#include "sp_par.h"
+
+/*
+ * Incomplete Cholesky factor under construction.
+ * Every column j of L occupies the segment
+ * [begin[j], begin[j] + capacity) of indicies/values arrays,
+ * only first count[j] elements are filled. Diagonal element is
+ * always the first element of the column
+ */
+typedef struct
+{
+  int* begin;
+  int* count;
+  int* indicies;
+  double* values;
+} ic_factor;
+
+/*
+ * Returns the k-th largest absolute value of n elements of x
+ * (k is 1-based). Quickselect, modifies the array x
+ */
+static double kth_largest_abs(double* x, int n, int k)
+{
+  int l = 0, r = n-1, i, j;
+  double pivot, tmp;
+  for (i = 0; i < n; ++ i)
+    x[i] = fabs(x[i]);
+  k--;
+  while (l < r)
+  {
+    pivot = x[(l+r)/2];
+    i = l;
+    j = r;
+    /* partition descending */
+    while (i <= j)
+    {
+      while (x[i] > pivot) i++;
+      while (x[j] < pivot) j--;
+      if (i <= j)
+      {
+        tmp = x[i]; x[i] = x[j]; x[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+    if (k <= j)
+      r = j;
+    else if (k >= i)
+      l = i;
+    else
+      break;
+  }
+  return x[k];
+}
+
+/*
+ * Up-looking incomplete Cholesky decomposition
+ * pattern_offsets/pattern_indicies - sorted indicies j < k of the
+ * candidates for nonzeros in the k-th row of L
+ * mark - if not 0, IC(0) mode: only elements of the pattern are
+ * updated and kept; droptol/fill ignored
+ * Returns nonzero if successfull
+ */
+static int sp_matrix_yale_ic_factor(sp_matrix_yale_ptr self,
+                                    int* pattern_offsets,
+                                    int* pattern_indicies,
+                                    int* mark,
+                                    double droptol,
+                                    int fill,
+                                    ic_factor* F)
+{
+  int n = self->rows_count;
+  int i,j,k,p,q,count,kept;
+  double* x = spcalloc(n,sizeof(double));
+  double* work = spcalloc(n,sizeof(double));
+  double A_kk,sum,tol,threshold,value;
+
+  for (k = 0; k < n; ++ k)
+  {
+    /*
+     * scatter the A(1:k-1,k) and find the diagonal element;
+     * norm of the column used as a drop tolerance scale
+     */
+    A_kk = 0;
+    tol = 0;
+    for (p = self->offsets[k];
+         p < self->offsets[k+1] && (i = self->indicies[p]) <= k;
+         ++ p)
+    {
+      if (i == k)
+        A_kk = self->values[p];
+      else
+        x[i] = self->values[p];
+    }
+    if (!mark)
+    {
+      for (p = self->offsets[k]; p < self->offsets[k+1]; ++ p)
+        tol += self->values[p]*self->values[p];
+      tol = droptol*sqrt(tol);
+    }
+    else
+    {
+      for (p = pattern_offsets[k]; p < pattern_offsets[k+1]; ++ p)
+        mark[pattern_indicies[p]] = k;
+    }
+    /* solve L(1:k-1,1:k-1)*L(k,1:k-1)' = A(1:k-1,k) dropping small values */
+    for (p = pattern_offsets[k]; p < pattern_offsets[k+1]; ++ p)
+    {
+      j = pattern_indicies[p];
+      if (x[j] == 0)
+        continue;
+      x[j] /= F->values[F->begin[j]];
+      if (!mark && fabs(x[j]) < tol)
+      {
+        x[j] = 0;
+        continue;
+      }
+      for (q = F->begin[j]+1; q < F->begin[j] + F->count[j]; ++ q)
+      {
+        i = F->indicies[q];
+        if (!mark || mark[i] == k)
+          x[i] -= F->values[q]*x[j];
+      }
+    }
+    /* apply the fill limit: keep only fill largest elements */
+    threshold = 0;
+    if (!mark && fill > 0)
+    {
+      count = 0;
+      for (p = pattern_offsets[k]; p < pattern_offsets[k+1]; ++ p)
+        if (x[pattern_indicies[p]] != 0)
+          work[count++] = x[pattern_indicies[p]];
+      if (count > fill)
+        threshold = kth_largest_abs(work,count,fill);
+    }
+    /* store the k-th row of L */
+    sum = 0;
+    kept = 0;
+    for (p = pattern_offsets[k]; p < pattern_offsets[k+1]; ++ p)
+    {
+      j = pattern_indicies[p];
+      value = x[j];
+      x[j] = 0;
+      if (!mark)
+      {
+        if (value == 0 || fabs(value) < threshold ||
+            (fill > 0 && kept >= fill))
+          continue;
+        kept++;
+      }
+      q = F->begin[j] + F->count[j]++;
+      F->indicies[q] = k;
+      F->values[q] = value;
+      sum += value*value;
+    }
+    value = A_kk - sum;
+    if (value <= 0)
+    {
+      LOGERROR("Incomplete Cholesky decomposition: "
+               "nonpositive pivot %e in %d row",value,k);
+      spfree(x);
+      spfree(work);
+      return 0;
+    }
+    F->indicies[F->begin[k]] = k;
+    F->values[F->begin[k]] = sqrt(value);
+    F->count[k] = 1;
+  }
+  spfree(x);
+  spfree(work);
+  return 1;
+}
+
+/*
+ * Compress the factor F to the Yale CCS matrix L
+ */
+static void ic_factor_compress(ic_factor* F, int n, sp_matrix_yale_ptr L)
+{
+  int j,nonzeros = 0;
+  for (j = 0; j < n; ++ j)
+    nonzeros += F->count[j];
+  L->storage_type = CCS;
+  L->rows_count = n;
+  L->cols_count = n;
+  L->nonzeros = nonzeros;
+  L->offsets = spcalloc(n+1,sizeof(int));
+  L->indicies = spcalloc(nonzeros,sizeof(int));
+  L->values = spcalloc(nonzeros,sizeof(double));
+  nonzeros = 0;
+  for (j = 0; j < n; ++ j)
+  {
+    L->offsets[j] = nonzeros;
+    memcpy(L->indicies+nonzeros,F->indicies+F->begin[j],
+           F->count[j]*sizeof(int));
+    memcpy(L->values+nonzeros,F->values+F->begin[j],
+           F->count[j]*sizeof(double));
+    nonzeros += F->count[j];
+  }
+  L->offsets[n] = nonzeros;
+}
+
+static void ic_factor_free(ic_factor* F)
+{
+  spfree(F->begin);
+  spfree(F->count);
+  spfree(F->indicies);
+  spfree(F->values);
+}
+
+int sp_matrix_yale_ic0(sp_matrix_yale_ptr self,
+                       sp_matrix_yale_ptr L)
+{
+  int result = 0;
+  int n,i,j,p,size;
+  int *pattern_offsets, *pattern_indicies, *mark;
+  ic_factor F;
+  if (!self || !L || self->storage_type != CCS ||
+      self->rows_count != self->cols_count)
+    return 0;
+  n = self->rows_count;
+  /*
+   * L has the portrait of the lower triangle of A; the k-th row
+   * of L has the portrait of the upper part of the k-th column of A
+   */
+  F.begin = spcalloc(n+1,sizeof(int));
+  F.count = spcalloc(n,sizeof(int));
+  pattern_offsets = spcalloc(n+1,sizeof(int));
+  size = 0;
+  for (j = 0; j < n; ++ j)
+  {
+    F.begin[j] = size;
+    pattern_offsets[j+1] = pattern_offsets[j];
+    for (p = self->offsets[j]; p < self->offsets[j+1]; ++ p)
+    {
+      i = self->indicies[p];
+      if (i >= j)
+        size++;
+      else
+        pattern_offsets[j+1]++;
+    }
+  }
+  F.begin[n] = size;
+  pattern_indicies = spcalloc(pattern_offsets[n]+1,sizeof(int));
+  for (j = 0; j < n; ++ j)
+  {
+    size = pattern_offsets[j];
+    for (p = self->offsets[j];
+         p < self->offsets[j+1] && (i = self->indicies[p]) < j; ++ p)
+      pattern_indicies[size++] = i;
+  }
+  F.indicies = spcalloc(F.begin[n],sizeof(int));
+  F.values = spcalloc(F.begin[n],sizeof(double));
+  mark = spalloc(n*sizeof(int));
+  for (i = 0; i < n; ++ i)
+    mark[i] = -1;
+
+  result = sp_matrix_yale_ic_factor(self,pattern_offsets,pattern_indicies,
+                                    mark,0,0,&F);
+  if (result)
+    ic_factor_compress(&F,n,L);
+  ic_factor_free(&F);
+  spfree(pattern_offsets);
+  spfree(pattern_indicies);
+  spfree(mark);
+  return result;
+}
+
+int sp_matrix_yale_ict(sp_matrix_yale_ptr self,
+                       sp_chol_symbolic_ptr symb,
+                       double droptol,
+                       int fill,
+                       sp_matrix_yale_ptr L)
+{
+  int result = 0;
+  int n,k,p,size;
+  int *pattern_offsets, *pattern_indicies;
+  ic_factor F;
+  if (!self || !symb || !L || self->storage_type != CCS ||
+      self->rows_count != self->cols_count)
+    return 0;
+  n = self->rows_count;
+  /*
+   * the portrait of the complete Cholesky factor is an upper bound
+   * for the incomplete one; rows of it without the diagonal are
+   * the candidates for the nonzeros
+   */
+  pattern_offsets = spcalloc(n+1,sizeof(int));
+  pattern_indicies = spcalloc(symb->nonzeros,sizeof(int));
+  size = 0;
+  for (k = 0; k < n; ++ k)
+  {
+    pattern_offsets[k] = size;
+    for (p = symb->crs_offsets[k]; p < symb->crs_offsets[k+1]; ++ p)
+      if (symb->crs_indicies[p] < k)
+        pattern_indicies[size++] = symb->crs_indicies[p];
+  }
+  pattern_offsets[n] = size;
+
+  F.begin = memdup(symb->ccs_offsets,(n+1)*sizeof(int));
+  F.count = spcalloc(n,sizeof(int));
+  F.indicies = spcalloc(symb->nonzeros,sizeof(int));
+  F.values = spcalloc(symb->nonzeros,sizeof(double));
+
+  result = sp_matrix_yale_ic_factor(self,pattern_offsets,pattern_indicies,
+                                    0,droptol,fill,&F);
+  if (result)
+    ic_factor_compress(&F,n,L);
+  ic_factor_free(&F);
+  spfree(pattern_offsets);
+  spfree(pattern_indicies);
+  return result;
+}
+
+/*
+ * Returns the matrix self in CRS format: self itself or
+ * the converted copy in tmp
+ */
+static sp_matrix_yale_ptr yale_crs(sp_matrix_yale_ptr self,
+                                   sp_matrix_yale_ptr tmp)
+{
+  if (self->storage_type == CRS)
+    return self;
+  sp_matrix_yale_convert(self,tmp,CRS);
+  return tmp;
+}
+
+/*
+ * Reserve space for extra elements in the growing LU factor
+ */
+static void ilu_reserve(sp_matrix_yale_ptr lu,
+                        int** levels,
+                        int* capacity,
+                        int extra)
+{
+  if (lu->nonzeros + extra <= *capacity)
+    return;
+  while (lu->nonzeros + extra > *capacity)
+    *capacity *= 2;
+  lu->indicies = sprealloc(lu->indicies,*capacity*sizeof(int));
+  if (lu->values)
+    lu->values = sprealloc(lu->values,*capacity*sizeof(double));
+  if (levels)
+    *levels = sprealloc(*levels,*capacity*sizeof(int));
+}
+
+static void ilu_init(sp_matrix_yale_ilu_ptr ilu, int n, int capacity,
+                     int with_values)
+{
+  ilu->lu.storage_type = CRS;
+  ilu->lu.rows_count = n;
+  ilu->lu.cols_count = n;
+  ilu->lu.nonzeros = 0;
+  ilu->lu.offsets = spcalloc(n+1,sizeof(int));
+  ilu->lu.indicies = spalloc(capacity*sizeof(int));
+  ilu->lu.values = with_values ? spalloc(capacity*sizeof(double)) : 0;
+  ilu->diag = spcalloc(n+1,sizeof(int));
+}
+
+int sp_matrix_yale_iluk(sp_matrix_yale_ptr self,
+                        int level,
+                        sp_matrix_yale_ilu_ptr ilu)
+{
+  int result = 1;
+  int n,i,j,c,l,p,q,tail,diag_added,capacity;
+  int *next, *lev, *marker, *levels;
+  sp_matrix_yale tmp;
+  sp_matrix_yale_ptr A;
+  if (!self || !ilu || self->rows_count != self->cols_count || level < 0)
+    return 0;
+  A = yale_crs(self,&tmp);
+  n = A->rows_count;
+  capacity = A->nonzeros + n + 1;
+  ilu_init(ilu,n,capacity,0);
+  levels = spalloc(capacity*sizeof(int));
+  /*
+   * row portrait is kept as a sorted linked list: next[] with
+   * the head in next[n] and n as a terminator
+   */
+  next = spalloc((n+1)*sizeof(int));
+  lev = spalloc(n*sizeof(int));
+  marker = spalloc(n*sizeof(int));
+  for (i = 0; i < n; ++ i)
+    marker[i] = -1;
+
+  /* symbolic factorization */
+  for (i = 0; i < n; ++ i)
+  {
+    /* portrait of the i-th row of A, with the diagonal */
+    tail = n;
+    diag_added = 0;
+    for (p = A->offsets[i]; p <= A->offsets[i+1]; ++ p)
+    {
+      c = p < A->offsets[i+1] ? A->indicies[p] : n;
+      if (!diag_added && c >= i)
+      {
+        next[tail] = i;
+        tail = i;
+        marker[i] = i;
+        lev[i] = 0;
+        diag_added = 1;
+      }
+      if (c == i || c == n)
+        continue;
+      next[tail] = c;
+      tail = c;
+      marker[c] = i;
+      lev[c] = 0;
+    }
+    next[tail] = n;
+    
+    /*
+     * lev(i,c) = min(lev(i,c), lev(i,j) + lev(j,c) + 1)
+     * for all j < i in ascending order
+     */
+    for (j = next[n]; j < i; j = next[j])
+      for (p = ilu->diag[j]+1; p < ilu->lu.offsets[j+1]; ++ p)
+      {
+        c = ilu->lu.indicies[p];
+        l = lev[j] + levels[p] + 1;
+        if (l > level)
+          continue;
+        if (marker[c] == i)
+        {
+          if (l < lev[c])
+            lev[c] = l;
+        }
+        else
+        {
+          /* insert to the sorted list after j */
+          for (q = j; next[q] < c; q = next[q]);
+          next[c] = next[q];
+          next[q] = c;
+          marker[c] = i;
+          lev[c] = l;
+        }
+      }
+    /* store the portrait of the row */
+    for (l = 0, c = next[n]; c < n; c = next[c])
+      l++;
+    ilu_reserve(&ilu->lu,&levels,&capacity,l);
+    for (c = next[n]; c < n; c = next[c])
+    {
+      if (c == i)
+        ilu->diag[i] = ilu->lu.nonzeros;
+      ilu->lu.indicies[ilu->lu.nonzeros] = c;
+      levels[ilu->lu.nonzeros++] = lev[c];
+    }
+    ilu->lu.offsets[i+1] = ilu->lu.nonzeros;
+  }
+  spfree(levels);
+  spfree(next);
+  spfree(lev);
+
+  /* numeric factorization on the obtained portrait */
+  ilu->lu.values = spcalloc(ilu->lu.nonzeros,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    marker[i] = -1;
+  for (i = 0; i < n && result; ++ i)
+  {
+    for (p = ilu->lu.offsets[i]; p < ilu->lu.offsets[i+1]; ++ p)
+      marker[ilu->lu.indicies[p]] = p;
+    for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+      ilu->lu.values[marker[A->indicies[p]]] = A->values[p];
+    for (p = ilu->lu.offsets[i]; p < ilu->diag[i]; ++ p)
+    {
+      j = ilu->lu.indicies[p];
+      ilu->lu.values[p] /= ilu->lu.values[ilu->diag[j]];
+      for (q = ilu->diag[j]+1; q < ilu->lu.offsets[j+1]; ++ q)
+        if ((l = marker[ilu->lu.indicies[q]]) != -1)
+          ilu->lu.values[l] -= ilu->lu.values[p]*ilu->lu.values[q];
+    }
+    if (ilu->lu.values[ilu->diag[i]] == 0)
+    {
+      LOGERROR("Incomplete LU decomposition: zero pivot in %d row",i);
+      result = 0;
+    }
+    for (p = ilu->lu.offsets[i]; p < ilu->lu.offsets[i+1]; ++ p)
+      marker[ilu->lu.indicies[p]] = -1;
+  }
+  spfree(marker);
+  if (A != self)
+    sp_matrix_yale_free(&tmp);
+  if (!result)
+    sp_matrix_yale_ilu_free(ilu);
+  return result;
+}
+
+/* binary min-heap of integers */
+static void heap_push(int* heap, int* size, int value)
+{
+  int i = (*size)++, parent;
+  while (i > 0 && heap[parent = (i-1)/2] > value)
+  {
+    heap[i] = heap[parent];
+    i = parent;
+  }
+  heap[i] = value;
+}
+
+static int heap_pop(int* heap, int* size)
+{
+  int result = heap[0];
+  int value = heap[--(*size)];
+  int i = 0, child;
+  while ((child = 2*i+1) < *size)
+  {
+    if (child + 1 < *size && heap[child+1] < heap[child])
+      child++;
+    if (heap[child] >= value)
+      break;
+    heap[i] = heap[child];
+    i = child;
+  }
+  heap[i] = value;
+  return result;
+}
+
+/*
+ * Reorders count indicies cols so that first k of them
+ * correspond to the largest absolute values of w
+ */
+static void select_largest(int* cols, int count, int k, double* w)
+{
+  int l = 0, r = count-1, i, j, tmp;
+  double pivot;
+  while (l < r)
+  {
+    pivot = fabs(w[cols[(l+r)/2]]);
+    i = l;
+    j = r;
+    while (i <= j)
+    {
+      while (fabs(w[cols[i]]) > pivot) i++;
+      while (fabs(w[cols[j]]) < pivot) j--;
+      if (i <= j)
+      {
+        tmp = cols[i]; cols[i] = cols[j]; cols[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+    if (k-1 <= j)
+      r = j;
+    else if (k-1 >= i)
+      l = i;
+    else
+      break;
+  }
+}
+
+static int int_compare(const void* a, const void* b)
+{
+  return *(const int*)a - *(const int*)b;
+}
+
+int sp_matrix_yale_ilut(sp_matrix_yale_ptr self,
+                        int fill,
+                        double droptol,
+                        sp_matrix_yale_ilu_ptr ilu)
+{
+  int n,i,j,c,p,q,capacity,heap_size,lcount,ucount;
+  int *marker, *heap, *lcols, *ucols;
+  double *w;
+  double tol,norm;
+  sp_matrix_yale tmp;
+  sp_matrix_yale_ptr A;
+  if (!self || !ilu || self->rows_count != self->cols_count)
+    return 0;
+  A = yale_crs(self,&tmp);
+  n = A->rows_count;
+  capacity = A->nonzeros + n + 1;
+  ilu_init(ilu,n,capacity,1);
+  w = spcalloc(n,sizeof(double));
+  marker = spalloc(n*sizeof(int));
+  heap = spalloc(n*sizeof(int));
+  lcols = spalloc(n*sizeof(int));
+  ucols = spalloc(n*sizeof(int));
+  for (i = 0; i < n; ++ i)
+    marker[i] = -1;
+
+  for (i = 0; i < n; ++ i)
+  {
+    /* w = A(i,:), the diagonal is always in the U part */
+    heap_size = 0;
+    lcount = 0;
+    ucount = 1;
+    ucols[0] = i;
+    marker[i] = i;
+    norm = 0;
+    for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+    {
+      c = A->indicies[p];
+      w[c] = A->values[p];
+      norm += w[c]*w[c];
+      if (c < i)
+        heap_push(heap,&heap_size,c);
+      else if (c > i)
+        ucols[ucount++] = c;
+      marker[c] = i;
+    }
+    norm = sqrt(norm);
+    tol = droptol*norm;
+
+    /* eliminate the L part in ascending order of columns */
+    while (heap_size)
+    {
+      j = heap_pop(heap,&heap_size);
+      if (w[j] == 0)
+        continue;
+      w[j] /= ilu->lu.values[ilu->diag[j]];
+      if (fabs(w[j]) < tol)
+      {
+        w[j] = 0;
+        continue;
+      }
+      for (q = ilu->diag[j]+1; q < ilu->lu.offsets[j+1]; ++ q)
+      {
+        c = ilu->lu.indicies[q];
+        if (marker[c] != i)
+        {
+          marker[c] = i;
+          w[c] = 0;
+          if (c < i)
+            heap_push(heap,&heap_size,c);
+          else
+            ucols[ucount++] = c;
+        }
+        w[c] -= w[j]*ilu->lu.values[q];
+      }
+      lcols[lcount++] = j;
+    }
+    /* drop small elements of the U part */
+    for (p = 1, q = 1; p < ucount; ++ p)
+      if (fabs(w[ucols[p]]) >= tol && w[ucols[p]] != 0)
+        ucols[q++] = ucols[p];
+      else
+        w[ucols[p]] = 0;
+    ucount = q;
+    /* keep fill largest elements in every part */
+    if (fill > 0 && lcount > fill)
+    {
+      select_largest(lcols,lcount,fill,w);
+      for (p = fill; p < lcount; ++ p)
+        w[lcols[p]] = 0;
+      lcount = fill;
+    }
+    if (fill > 0 && ucount - 1 > fill)
+    {
+      select_largest(ucols+1,ucount-1,fill,w);
+      for (p = fill+1; p < ucount; ++ p)
+        w[ucols[p]] = 0;
+      ucount = fill+1;
+    }
+    if (w[i] == 0)
+      w[i] = (1e-4 + droptol)*(norm != 0 ? norm : 1);
+    qsort(lcols,lcount,sizeof(int),int_compare);
+    qsort(ucols,ucount,sizeof(int),int_compare);
+
+    /* store the row */
+    ilu_reserve(&ilu->lu,0,&capacity,lcount+ucount);
+    for (p = 0; p < lcount + ucount; ++ p)
+    {
+      c = p < lcount ? lcols[p] : ucols[p-lcount];
+      if (c == i)
+        ilu->diag[i] = ilu->lu.nonzeros;
+      ilu->lu.indicies[ilu->lu.nonzeros] = c;
+      ilu->lu.values[ilu->lu.nonzeros++] = w[c];
+      w[c] = 0;
+    }
+    ilu->lu.offsets[i+1] = ilu->lu.nonzeros;
+  }
+  spfree(w);
+  spfree(marker);
+  spfree(heap);
+  spfree(lcols);
+  spfree(ucols);
+  if (A != self)
+    sp_matrix_yale_free(&tmp);
+  return 1;
+}
+
+void sp_matrix_yale_ilu_solve(sp_matrix_yale_ilu_ptr self,
+                              double* b,
+                              double* x)
+{
+  int i,p;
+  int n = self->lu.rows_count;
+  int* offsets = self->lu.offsets;
+  int* indicies = self->lu.indicies;
+  double* values = self->lu.values;
+  /* L*y = b, L with unit diagonal */
+  for (i = 0; i < n; ++ i)
+  {
+    x[i] = b[i];
+    for (p = offsets[i]; p < self->diag[i]; ++ p)
+      x[i] -= values[p]*x[indicies[p]];
+  }
+  /* U*x = y */
+  for (i = n-1; i >= 0; -- i)
+  {
+    for (p = self->diag[i]+1; p < offsets[i+1]; ++ p)
+      x[i] -= values[p]*x[indicies[p]];
+    x[i] /= values[self->diag[i]];
+  }
+}
+
+void sp_matrix_yale_ilu_free(sp_matrix_yale_ilu_ptr self)
+{
+  if (self)
+  {
+    sp_matrix_yale_free(&self->lu);
+    spfree(self->diag);
+    self->diag = 0;
+  }
+}
+
+/* Number of power iterations in the spectral radius estimation */
+#define POWER_ITERATIONS 15
+
+void sp_random_start_vector(double* v, int n)
+{
+  int i;
+  unsigned int seed = 12345;
+  for (i = 0; i < n; ++ i)
+  {
+    seed = seed*1103515245 + 12345;
+    v[i] = (double)((seed >> 16) & 0x7fff)/0x7fff - 0.5;
+  }
+}
+
+double sp_matrix_yale_jacobi_radius(sp_matrix_yale_ptr self, double* diag)
+{
+  int i,j;
+  int n = self->rows_count;
+  double rho = 0,norm,vnorm;
+  double* v = spcalloc(n,sizeof(double));
+  double* w = spcalloc(n,sizeof(double));
+  /* pseudo-random start vector contains all the modes, smooth
+   * ones are badly suited since the largest eigenvalues
+   * usually correspond to the oscillating eigenvectors */
+  sp_random_start_vector(v,n);
+  for (j = 0; j < POWER_ITERATIONS; ++ j)
+  {
+    sp_matrix_yale_mv(self,v,w);
+    norm = 0;
+    SP_PRAGMA(omp parallel for schedule(static) reduction(+:norm)
+              if (n > SP_PAR_MIN_SIZE))
+    for (i = 0; i < n; ++ i)
+    {
+      w[i] = diag[i] != 0 ? w[i]/diag[i] : 0;
+      norm += w[i]*w[i];
+    }
+    norm = sqrt(norm);
+    if (norm == 0)
+      break;
+    vnorm = 0;
+    SP_PRAGMA(omp parallel for schedule(static) reduction(+:vnorm)
+              if (n > SP_PAR_MIN_SIZE))
+    for (i = 0; i < n; ++ i)
+    {
+      vnorm += v[i]*v[i];
+      v[i] = w[i]/norm;
+    }
+    rho = norm/sqrt(vnorm);
+  }
+  spfree(v);
+  spfree(w);
+  return rho;
+}
+
+/*
+ * Chebyshev iteration with zero initial guess, see
+ * Saad Y. Iterative methods for sparse linear systems, algorithm 12.1
+ */
+void sp_matrix_yale_chebyshev(sp_matrix_yale_ptr self,
+                              double* diag,
+                              double lambda_min,
+                              double lambda_max,
+                              int degree,
+                              double* r,
+                              double* z,
+                              double* work)
+{
+  int i,k;
+  int n = self->rows_count;
+  double* res = work;
+  double* d = work + n;
+  double* ad = work + 2*n;
+  double theta = (lambda_max + lambda_min)/2;
+  double delta = (lambda_max - lambda_min)/2;
+  double sigma = delta > 0 ? theta/delta : 0;
+  double rho = sigma != 0 ? 1/sigma : 0;
+  double rho_new,c;
+  if (delta <= 0)               /* one point interval */
+    degree = 1;
+
+  SP_PRAGMA(omp parallel for schedule(static) if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+  {
+    res[i] = r[i];
+    d[i] = diag[i] != 0 ? r[i]/diag[i]/theta : 0;
+    z[i] = d[i];
+  }
+  for (k = 1; k < degree; ++ k)
+  {
+    sp_matrix_yale_mv(self,d,ad);
+    rho_new = 1/(2*sigma - rho);
+    c = 2*rho_new/delta;
+    SP_PRAGMA(omp parallel for schedule(static) if (n > SP_PAR_MIN_SIZE))
+    for (i = 0; i < n; ++ i)
+    {
+      res[i] -= ad[i];
+      d[i] = rho_new*rho*d[i] + (diag[i] != 0 ? c*res[i]/diag[i] : 0);
+      z[i] += d[i];
+    }
+    rho = rho_new;
+  }
+}
+
+void sp_precond_init(sp_precond_ptr self,
+                     sp_precond_setup_func setup,
+                     sp_precond_solve_func apply,
+                     sp_precond_free_func free,
+                     void* state)
+{
+  self->setup = setup;
+  self->apply = apply;
+  self->free = free;
+  self->state = state;
+}
+
+int sp_precond_setup(sp_precond_ptr self, sp_matrix_yale_ptr A)
+{
+  if (!self->setup)
+    return 1;
+  return self->setup(self->state,A);
+}
+
+void sp_precond_apply(sp_precond_ptr self, double* r, double* z)
+{
+  self->apply(self->state,r,z);
+}
+
+void sp_precond_free(sp_precond_ptr self)
+{
+  if (self->free)
+    self->free(self->state);
+  memset(self,0,sizeof(sp_precond));
+}
+
+/* ILU(k) preconditioner */
+
+typedef struct
+{
+  int level;
+  int ready;
+  sp_matrix_yale_ilu ilu;
+} iluk_precond_state;
+
+static int iluk_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  iluk_precond_state* s = (iluk_precond_state*)state;
+  if (s->ready)
+    sp_matrix_yale_ilu_free(&s->ilu);
+  s->ready = sp_matrix_yale_iluk(A,s->level,&s->ilu);
+  if (!s->ready)
+    LOGERROR("ILU(%d) preconditioner setup failed",s->level);
+  return s->ready;
+}
+
+static void iluk_precond_apply(void* state, double* r, double* z)
+{
+  sp_matrix_yale_ilu_solve(&((iluk_precond_state*)state)->ilu,r,z);
+}
+
+static void iluk_precond_free(void* state)
+{
+  iluk_precond_state* s = (iluk_precond_state*)state;
+  if (s->ready)
+    sp_matrix_yale_ilu_free(&s->ilu);
+  spfree(s);
+}
+
+void sp_precond_iluk_init(sp_precond_ptr self, int level)
+{
+  iluk_precond_state* s = spcalloc(1,sizeof(iluk_precond_state));
+  s->level = level;
+  sp_precond_init(self,iluk_precond_setup,iluk_precond_apply,
+                  iluk_precond_free,s);
+}
+
+/* IC(0) preconditioner */
+
+typedef struct
+{
+  int ready;
+  sp_matrix_yale L;
+  double* temp;
+} ic0_precond_state;
+
+static void ic0_precond_clear(ic0_precond_state* s)
+{
+  if (s->ready)
+  {
+    sp_matrix_yale_free(&s->L);
+    spfree(s->temp);
+    s->ready = 0;
+  }
+}
+
+static int ic0_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  ic0_precond_state* s = (ic0_precond_state*)state;
+  ic0_precond_clear(s);
+  s->ready = sp_matrix_yale_ic0(A,&s->L);
+  if (!s->ready)
+  {
+    LOGERROR("IC(0) preconditioner setup failed");
+    return 0;
+  }
+  s->temp = spcalloc(A->rows_count,sizeof(double));
+  return 1;
+}
+
+static void ic0_precond_apply(void* state, double* r, double* z)
+{
+  ic0_precond_state* s = (ic0_precond_state*)state;
+  sp_matrix_yale_lower_solve(&s->L,r,s->temp);       /* temp = L^{-1}*r */
+  sp_matrix_yale_lower_trans_solve(&s->L,s->temp,z); /* z = L^{-T}*temp */
+}
+
+static void ic0_precond_free(void* state)
+{
+  ic0_precond_clear((ic0_precond_state*)state);
+  spfree(state);
+}
+
+void sp_precond_ic0_init(sp_precond_ptr self)
+{
+  sp_precond_init(self,ic0_precond_setup,ic0_precond_apply,
+                  ic0_precond_free,spcalloc(1,sizeof(ic0_precond_state)));
+}
+
+/*
+ * Copies the matrix A to crs converting it to CRS format if necessary
+ * and extracts its diagonal. Returns nonzero if all diagonal elements
+ * are nonzero
+ */
+static int crs_copy_diagonal(sp_matrix_yale_ptr A,
+                             sp_matrix_yale_ptr crs,
+                             double** diag)
+{
+  int i,p;
+  int n = A->rows_count;
+  if (!sp_matrix_yale_convert(A,crs,CRS))
+    sp_matrix_yale_copy(A,crs);
+  *diag = spcalloc(n+1,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    for (p = crs->offsets[i]; p < crs->offsets[i+1]; ++ p)
+      if (crs->indicies[p] == i)
+        (*diag)[i] += crs->values[p];
+  for (i = 0; i < n; ++ i)
+    if ((*diag)[i] == 0)
+    {
+      LOGERROR("Zero diagonal element in the row %d",i);
+      return 0;
+    }
+  return 1;
+}
+
+/* Jacobi preconditioner */
+
+typedef struct
+{
+  int n;
+  double* inv_diag;
+} jacobi_precond_state;
+
+static int jacobi_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  jacobi_precond_state* s = (jacobi_precond_state*)state;
+  int i,p,k;
+  int n = A->storage_type == CRS ? A->rows_count : A->cols_count;
+  if (A->rows_count != A->cols_count)
+  {
+    LOGERROR("Jacobi preconditioner requires square matrix, %dx%d given",
+             A->rows_count,A->cols_count);
+    return 0;
+  }
+  if (s->inv_diag)
+    spfree(s->inv_diag);
+  s->n = n;
+  s->inv_diag = spcalloc(n+1,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+      if (A->indicies[p] == i)
+        s->inv_diag[i] += A->values[p];
+  k = 0;
+  SP_PRAGMA(omp parallel for schedule(static) reduction(+:k)
+            if (n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < n; ++ i)
+  {
+    if (s->inv_diag[i] != 0)
+      s->inv_diag[i] = 1/s->inv_diag[i];
+    else
+      k++;
+  }
+  if (k)
+    LOGERROR("Jacobi preconditioner: %d zero diagonal elements",k);
+  return k == 0;
+}
+
+static void jacobi_precond_apply(void* state, double* r, double* z)
+{
+  jacobi_precond_state* s = (jacobi_precond_state*)state;
+  int i;
+  SP_PRAGMA(omp parallel for schedule(static) if (s->n > SP_PAR_MIN_SIZE))
+  for (i = 0; i < s->n; ++ i)
+    z[i] = s->inv_diag[i]*r[i];
+}
+
+static void jacobi_precond_free(void* state)
+{
+  jacobi_precond_state* s = (jacobi_precond_state*)state;
+  if (s->inv_diag)
+    spfree(s->inv_diag);
+  spfree(s);
+}
+
+void sp_precond_jacobi_init(sp_precond_ptr self)
+{
+  sp_precond_init(self,jacobi_precond_setup,jacobi_precond_apply,
+                  jacobi_precond_free,
+                  spcalloc(1,sizeof(jacobi_precond_state)));
+}
+
+/* Block Jacobi preconditioner */
+
+typedef struct
+{
+  int block_size;
+  int n;
+  double* blocks;               /* inverted diagonal blocks stored
+                                 * row by row one after another */
+} block_jacobi_precond_state;
+
+/*
+ * Inverts the dense matrix a of the size n by Gauss-Jordan elimination
+ * with partial pivoting, a is destroyed. Returns 0 if a is singular
+ */
+static int dense_inverse(int n, double* a, double* inv)
+{
+  int i,j,k,pivot;
+  double value,norm = 0;
+  for (i = 0; i < n*n; ++ i)
+    norm = fabs(a[i]) > norm ? fabs(a[i]) : norm;
+  memset(inv,0,n*n*sizeof(double));
+  for (i = 0; i < n; ++ i)
+    inv[i*n+i] = 1;
+  for (k = 0; k < n; ++ k)
+  {
+    pivot = k;
+    for (i = k+1; i < n; ++ i)
+      if (fabs(a[i*n+k]) > fabs(a[pivot*n+k]))
+        pivot = i;
+    if (fabs(a[pivot*n+k]) <= norm*1e-14)
+      return 0;
+    if (pivot != k)
+      for (j = 0; j < n; ++ j)
+      {
+        value = a[k*n+j]; a[k*n+j] = a[pivot*n+j]; a[pivot*n+j] = value;
+        value = inv[k*n+j]; inv[k*n+j] = inv[pivot*n+j];
+        inv[pivot*n+j] = value;
+      }
+    value = 1/a[k*n+k];
+    for (j = 0; j < n; ++ j)
+    {
+      a[k*n+j] *= value;
+      inv[k*n+j] *= value;
+    }
+    for (i = 0; i < n; ++ i)
+      if (i != k && a[i*n+k] != 0)
+      {
+        value = a[i*n+k];
+        for (j = 0; j < n; ++ j)
+        {
+          a[i*n+j] -= value*a[k*n+j];
+          inv[i*n+j] -= value*inv[k*n+j];
+        }
+      }
+  }
+  return 1;
+}
+
+static int block_jacobi_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  block_jacobi_precond_state* s = (block_jacobi_precond_state*)state;
+  int i,j,p,b,singular = 0;
+  int bs = s->block_size;
+  int bs2 = bs*bs;
+  int n = A->rows_count;
+  int nblocks = n/bs;
+  double* a;
+  if (A->rows_count != A->cols_count || n % bs)
+  {
+    LOGERROR("Block Jacobi preconditioner: matrix %dx%d "
+             "is not consistent with the block size %d",
+             A->rows_count,A->cols_count,bs);
+    return 0;
+  }
+  if (s->blocks)
+    spfree(s->blocks);
+  s->n = n;
+  s->blocks = spcalloc((size_t)nblocks*bs2+1,sizeof(double));
+  a = spcalloc((size_t)nblocks*bs2+1,sizeof(double));
+  /* element (i,j) of the block is stored in a[i*bs+j] for CRS
+   * and transposed for CCS, fixed below */
+  for (i = 0; i < n; ++ i)
+    for (p = A->offsets[i]; p < A->offsets[i+1]; ++ p)
+    {
+      j = A->indicies[p];
+      if (j/bs == i/bs)
+      {
+        if (A->storage_type == CRS)
+          a[(size_t)(i/bs)*bs2 + (i%bs)*bs + j%bs] += A->values[p];
+        else
+          a[(size_t)(i/bs)*bs2 + (j%bs)*bs + i%bs] += A->values[p];
+      }
+    }
+  SP_PRAGMA(omp parallel for schedule(static) reduction(+:singular)
+            if (nblocks > SP_PAR_MIN_SIZE))
+  for (b = 0; b < nblocks; ++ b)
+    if (!dense_inverse(bs,a+(size_t)b*bs2,s->blocks+(size_t)b*bs2))
+      singular++;
+  spfree(a);
+  if (singular)
+    LOGERROR("Block Jacobi preconditioner: %d singular diagonal blocks",
+             singular);
+  return singular == 0;
+}
+
+static void block_jacobi_precond_apply(void* state, double* r, double* z)
+{
+  block_jacobi_precond_state* s = (block_jacobi_precond_state*)state;
+  int b,i,j;
+  int bs = s->block_size;
+  int nblocks = s->n/bs;
+  double* block;
+  SP_PRAGMA(omp parallel for private(i,j,block) schedule(static)
+            if (nblocks > SP_PAR_MIN_SIZE))
+  for (b = 0; b < nblocks; ++ b)
+  {
+    block = s->blocks + (size_t)b*bs*bs;
+    for (i = 0; i < bs; ++ i)
+    {
+      z[b*bs+i] = 0;
+      for (j = 0; j < bs; ++ j)
+        z[b*bs+i] += block[i*bs+j]*r[b*bs+j];
+    }
+  }
+}
+
+static void block_jacobi_precond_free(void* state)
+{
+  block_jacobi_precond_state* s = (block_jacobi_precond_state*)state;
+  if (s->blocks)
+    spfree(s->blocks);
+  spfree(s);
+}
+
+void sp_precond_block_jacobi_init(sp_precond_ptr self, int block_size)
+{
+  block_jacobi_precond_state* s =
+    spcalloc(1,sizeof(block_jacobi_precond_state));
+  s->block_size = block_size > 0 ? block_size : 1;
+  sp_precond_init(self,block_jacobi_precond_setup,block_jacobi_precond_apply,
+                  block_jacobi_precond_free,s);
+}
+
+/* SSOR preconditioner */
+
+typedef struct
+{
+  double omega;
+  int ready;
+  sp_matrix_yale A;             /* copy of the matrix in CRS format */
+  double* diag;
+} ssor_precond_state;
+
+static void ssor_precond_clear(ssor_precond_state* s)
+{
+  if (s->ready)
+  {
+    sp_matrix_yale_free(&s->A);
+    spfree(s->diag);
+    s->ready = 0;
+  }
+}
+
+static int ssor_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  ssor_precond_state* s = (ssor_precond_state*)state;
+  ssor_precond_clear(s);
+  if (A->rows_count != A->cols_count)
+  {
+    LOGERROR("SSOR preconditioner requires square matrix, %dx%d given",
+             A->rows_count,A->cols_count);
+    return 0;
+  }
+  s->ready = 1;
+  if (!crs_copy_diagonal(A,&s->A,&s->diag))
+  {
+    ssor_precond_clear(s);
+    LOGERROR("SSOR preconditioner setup failed");
+    return 0;
+  }
+  return 1;
+}
+
+/*
+ * Forward sweep (D/omega + L)*z = r*(2-omega)/omega
+ * followed by the backward sweep (D/omega + U)*z = (D/omega)*z
+ */
+static void ssor_precond_apply(void* state, double* r, double* z)
+{
+  ssor_precond_state* s = (ssor_precond_state*)state;
+  int i,p;
+  int n = s->A.rows_count;
+  int* offsets = s->A.offsets;
+  int* indicies = s->A.indicies;
+  double* values = s->A.values;
+  double omega = s->omega;
+  double c = (2 - omega)/omega;
+  double sum;
+  for (i = 0; i < n; ++ i)
+  {
+    sum = c*r[i];
+    for (p = offsets[i]; p < offsets[i+1]; ++ p)
+      if (indicies[p] < i)
+        sum -= values[p]*z[indicies[p]];
+    z[i] = omega*sum/s->diag[i];
+  }
+  for (i = n - 1; i >= 0; -- i)
+  {
+    sum = 0;
+    for (p = offsets[i]; p < offsets[i+1]; ++ p)
+      if (indicies[p] > i)
+        sum += values[p]*z[indicies[p]];
+    z[i] -= omega*sum/s->diag[i];
+  }
+}
+
+static void ssor_precond_free(void* state)
+{
+  ssor_precond_clear((ssor_precond_state*)state);
+  spfree(state);
+}
+
+void sp_precond_ssor_init(sp_precond_ptr self, double omega)
+{
+  ssor_precond_state* s = spcalloc(1,sizeof(ssor_precond_state));
+  s->omega = omega > 0 && omega < 2 ? omega : 1;
+  sp_precond_init(self,ssor_precond_setup,ssor_precond_apply,
+                  ssor_precond_free,s);
+}
+
+/* Chebyshev polynomial preconditioner */
+
+typedef struct
+{
+  int degree;
+  double lambda_min;            /* given bounds */
+  double lambda_max;
+  double lmin;                  /* bounds used */
+  double lmax;
+  int ready;
+  sp_matrix_yale A;             /* copy of the matrix in CRS format */
+  double* diag;
+  double* work;
+} chebyshev_precond_state;
+
+static void chebyshev_precond_clear(chebyshev_precond_state* s)
+{
+  if (s->ready)
+  {
+    sp_matrix_yale_free(&s->A);
+    spfree(s->diag);
+    if (s->work)
+      spfree(s->work);
+    s->work = 0;
+    s->ready = 0;
+  }
+}
+
+static int chebyshev_precond_setup(void* state, sp_matrix_yale_ptr A)
+{
+  chebyshev_precond_state* s = (chebyshev_precond_state*)state;
+  chebyshev_precond_clear(s);
+  if (A->rows_count != A->cols_count)
+  {
+    LOGERROR("Chebyshev preconditioner requires square matrix, "
+             "%dx%d given",A->rows_count,A->cols_count);
+    return 0;
+  }
+  s->ready = 1;
+  if (!crs_copy_diagonal(A,&s->A,&s->diag))
+  {
+    chebyshev_precond_clear(s);
+    LOGERROR("Chebyshev preconditioner setup failed");
+    return 0;
+  }
+  s->work = spcalloc(3*A->rows_count+1,sizeof(double));
+  s->lmax = s->lambda_max > 0 ? s->lambda_max :
+    CHEBYSHEV_SAFETY*sp_matrix_yale_jacobi_radius(&s->A,s->diag);
+  s->lmin = s->lambda_min > 0 ? s->lambda_min : s->lmax/CHEBYSHEV_RATIO;
+  if (s->lmax <= 0 || s->lmin > s->lmax)
+  {
+    LOGERROR("Chebyshev preconditioner: wrong spectrum bounds [%e,%e]",
+             s->lmin,s->lmax);
+    chebyshev_precond_clear(s);
+    return 0;
+  }
+  LOGINFO("Chebyshev preconditioner: degree %d, spectrum bounds [%e,%e]",
+          s->degree,s->lmin,s->lmax);
+  return 1;
+}
+
+static void chebyshev_precond_apply(void* state, double* r, double* z)
+{
+  chebyshev_precond_state* s = (chebyshev_precond_state*)state;
+  sp_matrix_yale_chebyshev(&s->A,s->diag,s->lmin,s->lmax,s->degree,
+                           r,z,s->work);
+}
+
+static void chebyshev_precond_free(void* state)
+{
+  chebyshev_precond_clear((chebyshev_precond_state*)state);
+  spfree(state);
+}
+
+void sp_precond_chebyshev_init(sp_precond_ptr self,
+                               int degree,
+                               double lambda_min,
+                               double lambda_max)
+{
+  chebyshev_precond_state* s = spcalloc(1,sizeof(chebyshev_precond_state));
+  s->degree = degree > 0 ? degree : 1;
+  s->lambda_min = lambda_min;
+  s->lambda_max = lambda_max;
+  sp_precond_init(self,chebyshev_precond_setup,chebyshev_precond_apply,
+                  chebyshev_precond_free,s);
+}
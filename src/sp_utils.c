@@ -18,9 +18,26 @@
  along with libspmatrix.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#if defined(__unix__) && !defined(__APPLE__) && \
+  !defined(_GNU_SOURCE) && !defined(_POSIX_C_SOURCE)
+/* mmap is POSIX, not C99 */
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <limits.h>
+#include <stdint.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define SP_HAVE_MMAP
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "sp_utils.h"
 #include "sp_mem.h"
@@ -162,7 +179,7 @@ const char* sp_extract_next_word(const char* line, const char** word)
 char* sp_read_text_file(const char* filename)
 {
   FILE* file;
-  const int block_size = 1024;
+  size_t block_size = 1024;
   /* contents buffer */
   char* contents = spcalloc(block_size+1,1);
   /* auxulary counters */
@@ -180,8 +197,10 @@ char* sp_read_text_file(const char* filename)
   {
     read_chunk = fread(contents+read,1,block_size, file);
     read += read_chunk;
-    
-    contents = (char*)sprealloc(contents,read + block_size);
+    /* grow geometrically to avoid quadratic copying */
+    if (read_chunk == block_size)
+      block_size *= 2;
+    contents = (char*)sprealloc(contents,read + block_size + 1);
   }
   contents[read] = '\0';
   /* close the file */
@@ -190,6 +209,533 @@ char* sp_read_text_file(const char* filename)
 }
 
 
+int sp_file_view_open(sp_file_view_ptr self, const char* filename)
+{
+#ifdef SP_HAVE_MMAP
+  int fd;
+  struct stat st;
+  void* addr;
+#endif
+  FILE* file;
+  long size;
+  char* buffer;
+  memset(self,0,sizeof(sp_file_view));
+#ifdef SP_HAVE_MMAP
+  fd = open(filename,O_RDONLY);
+  if (fd >= 0)
+  {
+    if (fstat(fd,&st) == 0 && st.st_size > 0)
+    {
+      addr = mmap(0,(size_t)st.st_size,PROT_READ,MAP_PRIVATE,fd,0);
+      if (addr != MAP_FAILED)
+      {
+        posix_madvise(addr,(size_t)st.st_size,POSIX_MADV_SEQUENTIAL);
+        close(fd);
+        self->data = (const char*)addr;
+        self->size = (size_t)st.st_size;
+        self->mapped = 1;
+        return 1;
+      }
+    }
+    close(fd);
+  }
+#endif
+  /* read the whole file by one block */
+  file = fopen(filename,"rb");
+  if (!file)
+  {
+    LOGERROR("Cannot read file %s", filename);
+    return 0;
+  }
+  if (fseek(file,0,SEEK_END) || (size = ftell(file)) < 0 ||
+      fseek(file,0,SEEK_SET))
+  {
+    LOGERROR("Cannot determine size of the file %s", filename);
+    fclose(file);
+    return 0;
+  }
+  buffer = spalloc(size+1);
+  if (fread(buffer,1,size,file) != (size_t)size)
+  {
+    LOGERROR("Cannot read file %s", filename);
+    spfree(buffer);
+    fclose(file);
+    return 0;
+  }
+  buffer[size] = '\0';
+  fclose(file);
+  self->data = buffer;
+  self->size = size;
+  return 1;
+}
+
+void sp_file_view_close(sp_file_view_ptr self)
+{
+#ifdef SP_HAVE_MMAP
+  if (self->mapped)
+    munmap((void*)self->data,self->size);
+  else
+#endif
+  if (self->data)
+    spfree((char*)self->data);
+  memset(self,0,sizeof(sp_file_view));
+}
+
+const char* sp_parse_int(const char* ptr, const char* end, int* value)
+{
+  const char* p = ptr;
+  const char* digits;
+  long long v = 0;
+  int negative = 0;
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  digits = p;
+  while (p < end && *p >= '0' && *p <= '9')
+  {
+    v = v*10 + (*p++ - '0');
+    if (v > (long long)INT_MAX + 1)
+      return ptr;               /* overflow */
+  }
+  if (p == digits || (!negative && v > INT_MAX))
+    return ptr;
+  *value = (int)(negative ? -v : v);
+  return p;
+}
+
+/* Maximum number of significant digits for the exact fast path */
+#define FAST_DIGITS 15
+/* Maximum decimal exponent for the exact fast path */
+#define FAST_EXPONENT 22
+/* Maximum number of digits accumulated in the 64-bit mantissa */
+#define MANTISSA_DIGITS 19
+/* Length of the number copied to the stack buffer for strtod */
+#define MAX_NUMBER_LENGTH 64
+
+const char* sp_parse_double(const char* ptr, const char* end, double* value)
+{
+  static const double powers[FAST_EXPONENT+1] =
+    {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+     1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  const char* p = ptr;
+  const char* start;
+  const char* exp_start;
+  unsigned long long mantissa = 0;
+  int digits = 0;               /* significant digits in the mantissa */
+  int dropped = 0;              /* significant digits not fitted */
+  int exponent = 0, exp_value = 0, exp_negative = 0, negative = 0;
+  int has_digits = 0;
+  char stack_buffer[MAX_NUMBER_LENGTH+1];
+  char* buffer;
+  size_t i,length;
+
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  start = p;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  /* integer part */
+  for (; p < end && *p >= '0' && *p <= '9'; ++ p)
+  {
+    has_digits = 1;
+    if (mantissa == 0 && *p == '0')
+      continue;                 /* leading zeros */
+    if (digits < MANTISSA_DIGITS)
+    {
+      mantissa = mantissa*10 + (*p - '0');
+      digits++;
+    }
+    else
+    {
+      exponent++;
+      dropped++;
+    }
+  }
+  /* fraction */
+  if (p < end && *p == '.')
+    for (++ p; p < end && *p >= '0' && *p <= '9'; ++ p)
+    {
+      has_digits = 1;
+      if (mantissa == 0 && *p == '0')
+        exponent--;
+      else if (digits < MANTISSA_DIGITS)
+      {
+        mantissa = mantissa*10 + (*p - '0');
+        digits++;
+        exponent--;
+      }
+      else
+        dropped++;
+    }
+  if (!has_digits)
+    return ptr;
+  /* exponent, also FORTRAN-style D */
+  if (p < end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D'))
+  {
+    exp_start = p++;
+    if (p < end && (*p == '-' || *p == '+'))
+      exp_negative = *p++ == '-';
+    if (p < end && *p >= '0' && *p <= '9')
+    {
+      for (; p < end && *p >= '0' && *p <= '9'; ++ p)
+        if (exp_value < 100000)
+          exp_value = exp_value*10 + (*p - '0');
+      exponent += exp_negative ? -exp_value : exp_value;
+    }
+    else
+      p = exp_start;            /* not an exponent */
+  }
+  if (!dropped && digits <= FAST_DIGITS &&
+      exponent >= -FAST_EXPONENT && exponent <= FAST_EXPONENT)
+  {
+    /* Clinger's fast path: mantissa and power of 10 are exact doubles,
+     * so one rounding gives the correctly rounded result */
+    *value = exponent < 0 ? (double)mantissa/powers[-exponent] :
+      (double)mantissa*powers[exponent];
+    if (negative)
+      *value = -*value;
+  }
+  else
+  {
+    /*
+     * slow path, correctly rounded by the C library. Taken also by
+     * all the numbers with 16-17 significant digits, like written
+     * with the full precision
+     */
+    length = (size_t)(p - start);
+    buffer = length > MAX_NUMBER_LENGTH ? spalloc(length+1) : stack_buffer;
+    memcpy(buffer,start,length);
+    buffer[length] = '\0';
+    for (i = 0; i < length; ++ i)
+      if (buffer[i] == 'd' || buffer[i] == 'D')
+        buffer[i] = 'e';
+    *value = strtod(buffer,0);
+    if (buffer != stack_buffer)
+      spfree(buffer);
+  }
+  return p;
+}
+
+/*
+ * Round-trip double to string conversion by the Grisu2
+ * algorithm (F. Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers", PLDI 2010): the digits are generated with
+ * 64-bit integer arithmetic from the value scaled by the cached power
+ * of 10, reading the result back gives exactly the same double.
+ * In about 0.1% of cases the digits are not the shortest possible
+ * (Grisu3 would detect them and fall back to the exact algorithm)
+ */
+typedef struct
+{
+  uint64_t f;                   /* significand */
+  int e;                        /* binary exponent */
+} diy_fp;
+
+#define DP_SIGNIFICAND_SIZE 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_SIZE)
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_EXPONENT_MASK 0x7FF0000000000000ULL
+
+static const uint64_t pow10_table[20] =
+{
+  1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+  10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+  100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+  100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+  100000000000000000ULL, 1000000000000000000ULL,
+  10000000000000000000ULL
+};
+
+static diy_fp diy_fp_make(uint64_t f, int e)
+{
+  diy_fp r;
+  r.f = f;
+  r.e = e;
+  return r;
+}
+
+/* Product rounded to 64 bits */
+static diy_fp diy_fp_multiply(diy_fp x, diy_fp y)
+{
+  const uint64_t M32 = 0xFFFFFFFFULL;
+  uint64_t a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+  uint64_t ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+  uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32) + (1ULL << 31);
+  return diy_fp_make(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+                     x.e + y.e + 64);
+}
+
+static diy_fp diy_fp_normalize(diy_fp x)
+{
+  while (!(x.f & (1ULL << 63)))
+  {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+/* Boundaries m-, m+ of the interval rounding to v, normalized */
+static void diy_fp_boundaries(diy_fp v, diy_fp* minus, diy_fp* plus)
+{
+  diy_fp pl = diy_fp_make((v.f << 1) + 1,v.e - 1);
+  diy_fp mi = v.f == DP_HIDDEN_BIT ? diy_fp_make((v.f << 2) - 1,v.e - 2) :
+    diy_fp_make((v.f << 1) - 1,v.e - 1);
+  pl = diy_fp_normalize(pl);
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+  *plus = pl;
+  *minus = mi;
+}
+
+/* Cached power 10^-K such that the product with 2^e is in [2^-60,2^-32] */
+static diy_fp cached_power(int e, int* K)
+{
+  /* 10^k for k = -348, -340, ..., 340 */
+  static const uint64_t powers_f[] =
+  {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+  };
+  static const short powers_e[] =
+  {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+  };
+  double dk = (-61 - e)*0.30102999566398114 + 347;
+  int k = (int)dk;
+  unsigned index;
+  if (dk - k > 0.0)
+    k++;
+  index = (unsigned)((k >> 3) + 1);
+  *K = -(-348 + (int)(index << 3));
+  return diy_fp_make(powers_f[index],powers_e[index]);
+}
+
+/* Moves the last digit closer to the exact value */
+static void grisu_round(char* buffer, int length, uint64_t delta,
+                        uint64_t rest, uint64_t ten_kappa, uint64_t wp_w)
+{
+  while (rest < wp_w && delta - rest >= ten_kappa &&
+         (rest + ten_kappa < wp_w ||
+          wp_w - rest > rest + ten_kappa - wp_w))
+  {
+    buffer[length - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static void digit_gen(diy_fp W, diy_fp Mp, uint64_t delta,
+                      char* buffer, int* length, int* K)
+{
+  diy_fp one = diy_fp_make(1ULL << -Mp.e,Mp.e);
+  uint64_t wp_w = Mp.f - W.f;
+  uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+  uint64_t p2 = Mp.f & (one.f - 1);
+  uint64_t rest;
+  int kappa = 1,d;
+  while (kappa < 10 && p1 >= pow10_table[kappa])
+    kappa++;
+  *length = 0;
+  /* integral part */
+  while (kappa > 0)
+  {
+    d = (int)(p1/pow10_table[kappa-1]);
+    p1 %= pow10_table[kappa-1];
+    if (d || *length)
+      buffer[(*length)++] = (char)('0' + d);
+    kappa--;
+    rest = ((uint64_t)p1 << -one.e) + p2;
+    if (rest <= delta)
+    {
+      *K += kappa;
+      grisu_round(buffer,*length,delta,rest,
+                  pow10_table[kappa] << -one.e,wp_w);
+      return;
+    }
+  }
+  /* fractional part */
+  for (;;)
+  {
+    p2 *= 10;
+    delta *= 10;
+    d = (int)(p2 >> -one.e);
+    if (d || *length)
+      buffer[(*length)++] = (char)('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta)
+    {
+      *K += kappa;
+      grisu_round(buffer,*length,delta,p2,one.f,
+                  -kappa < 20 ? wp_w*pow10_table[-kappa] : 0);
+      return;
+    }
+  }
+}
+
+static int write_exponent(int K, char* buffer)
+{
+  char* p = buffer;
+  if (K < 0)
+  {
+    *p++ = '-';
+    K = -K;
+  }
+  if (K >= 100)
+  {
+    *p++ = (char)('0' + K/100);
+    K %= 100;
+    *p++ = (char)('0' + K/10);
+  }
+  else if (K >= 10)
+    *p++ = (char)('0' + K/10);
+  *p++ = (char)('0' + K%10);
+  return (int)(p - buffer);
+}
+
+/* Places the decimal point: digits*10^k in the shortest readable form */
+static int prettify(char* buffer, int length, int k)
+{
+  int i,kk = length + k;        /* 10^(kk-1) <= v < 10^kk */
+  if (k >= 0 && kk <= 17)
+  {
+    /* 1234e2 -> 123400 */
+    for (i = length; i < kk; ++ i)
+      buffer[i] = '0';
+    return kk;
+  }
+  if (kk > 0 && kk <= 17)
+  {
+    /* 1234e-2 -> 12.34 */
+    memmove(buffer + kk + 1,buffer + kk,length - kk);
+    buffer[kk] = '.';
+    return length + 1;
+  }
+  if (kk > -6 && kk <= 0)
+  {
+    /* 1234e-6 -> 0.001234 */
+    memmove(buffer + 2 - kk,buffer,length);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    for (i = 2; i < 2 - kk; ++ i)
+      buffer[i] = '0';
+    return length + 2 - kk;
+  }
+  if (length == 1)
+  {
+    /* 1e30 */
+    buffer[1] = 'e';
+    return 2 + write_exponent(kk - 1,buffer + 2);
+  }
+  /* 1234e30 -> 1.234e33 */
+  memmove(buffer + 2,buffer + 1,length - 1);
+  buffer[1] = '.';
+  buffer[length + 1] = 'e';
+  return length + 2 + write_exponent(kk - 1,buffer + length + 2);
+}
+
+int sp_dtoa(double value, char* buffer)
+{
+  uint64_t u;
+  diy_fp v,w_m,w_p,c_mk,W,Wp,Wm;
+  int length,K,biased_e,sign = 0;
+  memcpy(&u,&value,sizeof(u));
+  if ((u & DP_EXPONENT_MASK) == DP_EXPONENT_MASK)
+    return sprintf(buffer,"%g",value); /* inf, nan */
+  if (u >> 63)
+  {
+    *buffer++ = '-';
+    sign = 1;
+    u &= ~(1ULL << 63);
+  }
+  if (!u)
+  {
+    buffer[0] = '0';
+    buffer[1] = '\0';
+    return sign + 1;
+  }
+  biased_e = (int)((u & DP_EXPONENT_MASK) >> DP_SIGNIFICAND_SIZE);
+  v = biased_e ?
+    diy_fp_make((u & DP_SIGNIFICAND_MASK) + DP_HIDDEN_BIT,
+                biased_e - DP_EXPONENT_BIAS) :
+    diy_fp_make(u & DP_SIGNIFICAND_MASK,1 - DP_EXPONENT_BIAS);
+  diy_fp_boundaries(v,&w_m,&w_p);
+  c_mk = cached_power(w_p.e,&K);
+  W = diy_fp_multiply(diy_fp_normalize(v),c_mk);
+  Wp = diy_fp_multiply(w_p,c_mk);
+  Wm = diy_fp_multiply(w_m,c_mk);
+  Wm.f++;
+  Wp.f--;
+  digit_gen(W,Wp,Wp.f - Wm.f,buffer,&length,&K);
+  length = prettify(buffer,length,K);
+  buffer[length] = '\0';
+  return sign + length;
+}
+
+int sp_itoa(int value, char* buffer)
+{
+  char digits[16];
+  unsigned int u = value < 0 ? 0u - (unsigned int)value : (unsigned int)value;
+  int i = 0,length = 0;
+  do
+  {
+    digits[i++] = (char)('0' + u%10);
+    u /= 10;
+  } while (u);
+  if (value < 0)
+    buffer[length++] = '-';
+  while (i)
+    buffer[length++] = digits[--i];
+  buffer[length] = '\0';
+  return length;
+}
+
+uint64_t sp_fnv1a(uint64_t hash, const void* data, size_t size)
+{
+  const unsigned char* p = data;
+  size_t i;
+  for (i = 0; i < size; ++ i)
+    hash = (hash ^ p[i])*1099511628211ULL;
+  return hash;
+}
+
 /* Extracts the integer of size bytes from the buffer from */
 int sp_extract_positional_int(const char* from, size_t size)
 {
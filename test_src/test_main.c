@@ -20,12 +20,15 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
 #include <memory.h>
 #include "sp_mem.h"
 
 #include "sp_matrix.h"
 #include "sp_direct.h"
 #include "sp_iter.h"
+#include "sp_amg.h"
 #include "sp_utils.h"
 #include "sp_file.h"
 #include "sp_cont.h"
@@ -584,6 +587,137 @@ static void pcg_ilu_solver()
   sp_matrix_yale_free(&yale);
 }
 
+static void ilu_level_schedule()
+{
+  sp_matrix mtx;
+  sp_matrix_yale yale;
+  sp_matrix_skyline_ilu ilu;
+  sp_matrix_skyline_ilu_sched sched;
+  const int n = 10;
+  int i,j,k,max_iter,iter;
+  double tolerance;
+  double *b, *x, *y, *temp;
+
+  /* 2d Laplacian on the n x n grid */
+  sp_matrix_init(&mtx,n*n,n*n,5,CRS);
+  for (i = 0; i < n; ++ i)
+    for (j = 0; j < n; ++ j)
+    {
+      k = i*n + j;
+      MTX(&mtx,k,k,4);
+      if (i > 0) MTX(&mtx,k,k-n,-1);
+      if (i < n-1) MTX(&mtx,k,k+n,-1);
+      if (j > 0) MTX(&mtx,k,k-1,-1);
+      if (j < n-1) MTX(&mtx,k,k+1,-1);
+    }
+  sp_matrix_reorder(&mtx);
+  sp_matrix_yale_init(&yale,&mtx);
+  sp_matrix_create_ilu(&mtx,&ilu);
+  sp_matrix_skyline_ilu_sched_init(&sched,&ilu);
+  /* wavefronts of the 5-point stencil: anti-diagonals of the grid */
+  ASSERT_TRUE(sched.lower_levels == 2*n-1);
+  ASSERT_TRUE(sched.upper_levels == 2*n-1);
+
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  y = spcalloc(n*n,sizeof(double));
+  temp = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    b[i] = i % 3 - 1;
+  /* compare with the sequential solves */
+  sp_matrix_skyline_ilu_sched_solve(&sched,b,x);
+  memcpy(temp,b,n*n*sizeof(double));
+  sp_matrix_skyline_ilu_lower_solve(&ilu,temp,y);
+  sp_matrix_skyline_ilu_upper_solve(&ilu,y,temp);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(x[i] - temp[i]) < 1e-14);
+
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_ilu(&yale,&ilu,b,y,&max_iter,&tolerance,x);
+  iter = max_iter;
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_ilu_sched(&yale,&sched,b,y,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  ASSERT_TRUE(max_iter == iter);
+
+  spfree(b);
+  spfree(x);
+  spfree(y);
+  spfree(temp);
+  sp_matrix_skyline_ilu_sched_free(&sched);
+  sp_matrix_skyline_ilu_free(&ilu);
+  sp_matrix_yale_free(&yale);
+  sp_matrix_free(&mtx);
+}
+
+static void ilu_fixed_point()
+{
+  sp_matrix mtx;
+  sp_matrix_yale yale;
+  sp_matrix_skyline A;
+  sp_matrix_skyline_ilu ilu,ilu_iter;
+  const int n = 10;
+  int i,j,k,max_iter,iter;
+  double tolerance;
+  double *b, *x, *x0;
+
+  /* 2d Laplacian on the n x n grid */
+  sp_matrix_init(&mtx,n*n,n*n,5,CRS);
+  for (i = 0; i < n; ++ i)
+    for (j = 0; j < n; ++ j)
+    {
+      k = i*n + j;
+      MTX(&mtx,k,k,4);
+      if (i > 0) MTX(&mtx,k,k-n,-1);
+      if (i < n-1) MTX(&mtx,k,k+n,-1);
+      if (j > 0) MTX(&mtx,k,k-1,-1);
+      if (j < n-1) MTX(&mtx,k,k+1,-1);
+    }
+  sp_matrix_reorder(&mtx);
+  sp_matrix_yale_init(&yale,&mtx);
+  sp_matrix_create_ilu(&mtx,&ilu);
+
+  /* number of sweeps equal to number of levels gives exact ILU(0) */
+  sp_matrix_skyline_init(&A,&mtx);
+  sp_matrix_skyline_ilu_iter_init(&ilu_iter,&A,2*n);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(ilu.ilu_diag[i] - ilu_iter.ilu_diag[i]) < 1e-12);
+  for (i = 0; i < ilu.parent.tr_nonzeros; ++ i)
+  {
+    ASSERT_TRUE(fabs(ilu.ilu_lowertr[i] - ilu_iter.ilu_lowertr[i]) < 1e-12);
+    ASSERT_TRUE(fabs(ilu.ilu_uppertr[i] - ilu_iter.ilu_uppertr[i]) < 1e-12);
+  }
+  sp_matrix_skyline_ilu_free(&ilu_iter);
+
+  /* few sweeps give the preconditioner close to the ILU(0) */
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  x0 = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    b[i] = i % 3 - 1;
+  sp_matrix_skyline_init(&A,&mtx);
+  sp_matrix_skyline_ilu_iter_init(&ilu_iter,&A,3);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_cg(&yale,b,x0,&max_iter,&tolerance,x);
+  iter = max_iter;
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_ilu(&yale,&ilu_iter,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  EXPECT_TRUE(max_iter < iter);
+
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  sp_matrix_skyline_ilu_free(&ilu_iter);
+  sp_matrix_skyline_ilu_free(&ilu);
+  sp_matrix_yale_free(&yale);
+  sp_matrix_free(&mtx);
+}
+
 static void cholesky()
 {
   /* initial matrix(octave representation):
@@ -747,6 +881,943 @@ static void cholesky()
 }
 
 
+static void incomplete_cholesky()
+{
+  /* same SPD matrix as in the cholesky test */
+  sp_matrix mtx,lapl;
+  sp_matrix_yale yale,yale_lapl,L,L0,Lt;
+  sp_chol_symbolic symb;
+  int i,j,k,max_iter;
+  const int n = 10;             /* grid size of the Laplacian */
+  double tolerance;
+  double *b, *x, *x0, *z;
+
+  sp_matrix_init(&mtx,7,7,5,CCS);
+  MTX(&mtx,0,0,90);MTX(&mtx,0,1,6);MTX(&mtx,0,2,4);MTX(&mtx,0,3,46);
+  MTX(&mtx,0,4,29);MTX(&mtx,0,6,26);
+  MTX(&mtx,1,0,6);MTX(&mtx,1,1,127);MTX(&mtx,1,2,34);MTX(&mtx,1,3,22);
+  MTX(&mtx,1,4,7);MTX(&mtx,1,6,38);
+  MTX(&mtx,2,0,4);MTX(&mtx,2,1,34);MTX(&mtx,2,2,108);MTX(&mtx,2,3,40);
+  MTX(&mtx,2,4,2);MTX(&mtx,2,6,4);
+  MTX(&mtx,3,0,46);MTX(&mtx,3,1,22);MTX(&mtx,3,2,40);MTX(&mtx,3,3,96);
+  MTX(&mtx,3,4,24);MTX(&mtx,3,6,6);
+  MTX(&mtx,4,0,29);MTX(&mtx,4,1,7);MTX(&mtx,4,2,2);MTX(&mtx,4,3,24);
+  MTX(&mtx,4,4,155);MTX(&mtx,4,6,37);
+  MTX(&mtx,5,5,64);
+  MTX(&mtx,6,0,26);MTX(&mtx,6,1,38);MTX(&mtx,6,2,4);MTX(&mtx,6,3,6);
+  MTX(&mtx,6,4,37);MTX(&mtx,6,6,70);
+  sp_matrix_yale_init(&yale,&mtx);
+
+  /*
+   * the Cholesky factor of this matrix has no fill-in, therefore
+   * IC(0) and ICT without dropping shall give the complete factor
+   */
+  ASSERT_TRUE(sp_matrix_yale_chol_symbolic(&yale,&symb));
+  ASSERT_TRUE(sp_matrix_yale_chol_numeric(&yale,&symb,&L));
+  ASSERT_TRUE(sp_matrix_yale_ic0(&yale,&L0));
+  ASSERT_TRUE(sp_matrix_yale_ict(&yale,&symb,0,0,&Lt));
+  ASSERT_TRUE(L0.nonzeros == L.nonzeros);
+  ASSERT_TRUE(Lt.nonzeros == L.nonzeros);
+  for (i = 0; i <= 7; ++ i)
+  {
+    ASSERT_TRUE(L0.offsets[i] == L.offsets[i]);
+    ASSERT_TRUE(Lt.offsets[i] == L.offsets[i]);
+  }
+  for (i = 0; i < L.nonzeros; ++ i)
+  {
+    ASSERT_TRUE(L0.indicies[i] == L.indicies[i]);
+    ASSERT_TRUE(Lt.indicies[i] == L.indicies[i]);
+    ASSERT_TRUE(fabs(L0.values[i] - L.values[i]) < 1e-12);
+    ASSERT_TRUE(fabs(Lt.values[i] - L.values[i]) < 1e-12);
+  }
+  sp_matrix_yale_free(&Lt);
+  /* fill limit: at most 1 offdiagonal element in every row */
+  ASSERT_TRUE(sp_matrix_yale_ict(&yale,&symb,0,1,&Lt));
+  ASSERT_TRUE(Lt.nonzeros <= 7 + 6);
+  sp_matrix_yale_free(&Lt);
+  sp_matrix_yale_free(&L0);
+  sp_matrix_yale_free(&L);
+  sp_matrix_yale_symbolic_free(&symb);
+
+  /* 2d Laplacian on the n x n grid: IC(0) differs from Cholesky */
+  sp_matrix_init(&lapl,n*n,n*n,5,CCS);
+  for (i = 0; i < n; ++ i)
+    for (j = 0; j < n; ++ j)
+    {
+      k = i*n + j;
+      MTX(&lapl,k,k,4);
+      if (i > 0) MTX(&lapl,k,k-n,-1);
+      if (i < n-1) MTX(&lapl,k,k+n,-1);
+      if (j > 0) MTX(&lapl,k,k-1,-1);
+      if (j < n-1) MTX(&lapl,k,k+1,-1);
+    }
+  sp_matrix_yale_init(&yale_lapl,&lapl);
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  x0 = spcalloc(n*n,sizeof(double));
+  z = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    x[i] = i % 7 - 3;
+  sp_matrix_yale_mv(&yale_lapl,x,b);
+
+  ASSERT_TRUE(sp_matrix_yale_ic0(&yale_lapl,&L0));
+  ASSERT_TRUE(L0.nonzeros == (yale_lapl.nonzeros + n*n)/2);
+  ASSERT_TRUE(sp_matrix_yale_chol_symbolic(&yale_lapl,&symb));
+  ASSERT_TRUE(sp_matrix_yale_ict(&yale_lapl,&symb,1e-2,0,&Lt));
+  ASSERT_TRUE(Lt.nonzeros < symb.nonzeros);
+
+  /* PCG with IC(0) shall converge faster than CG */
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_ic(&yale_lapl,&L0,b,x0,&max_iter,&tolerance,x);
+  k = max_iter;
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale_lapl,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_cg(&yale_lapl,b,x0,&max_iter,&tolerance,x);
+  EXPECT_TRUE(k < max_iter);
+  /* ICT */
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_ic(&yale_lapl,&Lt,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  EXPECT_TRUE(max_iter <= k);
+
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(z);
+  sp_matrix_yale_symbolic_free(&symb);
+  sp_matrix_yale_free(&Lt);
+  sp_matrix_yale_free(&L0);
+  sp_matrix_yale_free(&yale_lapl);
+  sp_matrix_yale_free(&yale);
+  sp_matrix_free(&lapl);
+  sp_matrix_free(&mtx);
+}
+
+/* 2d convection-diffusion operator on the n x n grid */
+static void convection_diffusion(sp_matrix_yale_ptr yale, int n, double c)
+{
+  sp_matrix mtx;
+  int i,j,k;
+  sp_matrix_init(&mtx,n*n,n*n,5,CRS);
+  for (i = 0; i < n; ++ i)
+    for (j = 0; j < n; ++ j)
+    {
+      k = i*n + j;
+      MTX(&mtx,k,k,4);
+      if (i > 0) MTX(&mtx,k,k-n,-1-c);
+      if (i < n-1) MTX(&mtx,k,k+n,-1+c);
+      if (j > 0) MTX(&mtx,k,k-1,-1-c);
+      if (j < n-1) MTX(&mtx,k,k+1,-1+c);
+    }
+  sp_matrix_reorder(&mtx);
+  sp_matrix_yale_init(yale,&mtx);
+  sp_matrix_free(&mtx);
+}
+
+static void incomplete_lu()
+{
+  sp_matrix_yale yale;
+  sp_matrix_yale_ilu ilu0,ilu1,ilut;
+  const int n = 12;
+  int i,j,k,p,q,r,max_iter,iter_plain;
+  double tolerance,lu_ij,l_ik;
+  double *b, *x, *x0, *z;
+  
+  convection_diffusion(&yale,n,0.9);
+  ASSERT_TRUE(sp_matrix_yale_iluk(&yale,0,&ilu0));
+  ASSERT_TRUE(sp_matrix_yale_iluk(&yale,1,&ilu1));
+  ASSERT_TRUE(sp_matrix_yale_ilut(&yale,10,1e-3,&ilut));
+  /* ILU(0) keeps the portrait and (L*U)_{ij} = A_{ij} on it */
+  ASSERT_TRUE(ilu0.lu.nonzeros == yale.nonzeros);
+  ASSERT_TRUE(ilu1.lu.nonzeros > yale.nonzeros);
+  for (i = 0; i < n*n; ++ i)
+    for (p = yale.offsets[i]; p < yale.offsets[i+1]; ++ p)
+    {
+      j = yale.indicies[p];
+      ASSERT_TRUE(ilu0.lu.indicies[p] == j);
+      /* (L*U)_{ij} = sum_k L_{ik}*U_{kj} */
+      lu_ij = 0;
+      for (q = ilu0.lu.offsets[i]; q < ilu0.lu.offsets[i+1]; ++ q)
+      {
+        k = ilu0.lu.indicies[q];
+        l_ik = k == i ? 1 : ilu0.lu.values[q];
+        if (k > i || k > j)
+          continue;
+        for (r = ilu0.diag[k]; r < ilu0.lu.offsets[k+1]; ++ r)
+          if (ilu0.lu.indicies[r] == j)
+            lu_ij += l_ik*ilu0.lu.values[r];
+      }
+      ASSERT_TRUE(fabs(lu_ij - yale.values[p]) < 1e-12);
+    }
+  
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  x0 = spcalloc(n*n,sizeof(double));
+  z = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    x[i] = i % 5 - 2;
+  sp_matrix_yale_mv(&yale,x,b);
+
+  /* BiCGSTAB */
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_bicgstab(&yale,b,x0,&max_iter,&tolerance,x);
+  iter_plain = max_iter;
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_bicgstab_ilu(&yale,&ilu1,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  EXPECT_TRUE(max_iter < iter_plain);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+
+  /* CGS */
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_cgs_ilu(&yale,&ilu0,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+
+  /* TFQMR */
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_tfqmr_ilu(&yale,&ilut,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-7);
+
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(z);
+  sp_matrix_yale_ilu_free(&ilu0);
+  sp_matrix_yale_ilu_free(&ilu1);
+  sp_matrix_yale_ilu_free(&ilut);
+  sp_matrix_yale_free(&yale);
+}
+
+static void yale_ilu_precond(void* state, double* r, double* z)
+{
+  sp_matrix_yale_ilu_solve((sp_matrix_yale_ilu_ptr)state,r,z);
+}
+
+static void bicgstab_solvers()
+{
+  sp_matrix_yale yale;
+  sp_matrix_yale_ilu ilu;
+  sp_precond precond;
+  const int n = 15;
+  int i,l,max_iter;
+  double tolerance;
+  double *b, *x, *x0, *z;
+  
+  convection_diffusion(&yale,n,0.95);
+  ASSERT_TRUE(sp_matrix_yale_iluk(&yale,0,&ilu));
+  sp_precond_init(&precond,0,yale_ilu_precond,0,&ilu);
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  x0 = spcalloc(n*n,sizeof(double));
+  z = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    x[i] = i % 7 - 3;
+  sp_matrix_yale_mv(&yale,x,b);
+
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_bicgstab_precond(&yale,&precond,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  
+  for (l = 1; l <= 4; l *= 2)
+  {
+    /* without preconditioner */
+    max_iter = 1000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_bicgstabl(&yale,l,0,b,x0,&max_iter,&tolerance,x);
+    ASSERT_TRUE(tolerance < 1e-10);
+    sp_matrix_yale_mv(&yale,x,z);
+    for (i = 0; i < n*n; ++ i)
+      ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+    /* with ILU(0) */
+    max_iter = 1000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_bicgstabl(&yale,l,&precond,b,x0,&max_iter,&tolerance,x);
+    ASSERT_TRUE(tolerance < 1e-10);
+    sp_matrix_yale_mv(&yale,x,z);
+    for (i = 0; i < n*n; ++ i)
+      ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  }
+  
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(z);
+  sp_matrix_yale_ilu_free(&ilu);
+  sp_matrix_yale_free(&yale);
+}
+
+/* matrix-free operator: y = A*x, counting the calls */
+typedef struct
+{
+  sp_matrix_yale_ptr A;
+  int calls;
+} counting_operator;
+
+static void counting_operator_mv(void* state, double* x, double* y)
+{
+  counting_operator* op = (counting_operator*)state;
+  sp_matrix_yale_mv(op->A,x,y);
+  op->calls ++;
+}
+
+/* variable preconditioner: few iterations of BiCGSTAB-ILU(0) */
+typedef struct
+{
+  sp_matrix_yale_ptr A;
+  sp_matrix_yale_ilu_ptr ilu;
+} inner_solver;
+
+static void inner_bicgstab_precond(void* state, double* r, double* z)
+{
+  inner_solver* inner = (inner_solver*)state;
+  int max_iter = 3;
+  double tolerance = 1e-14;
+  double* z0 = spcalloc(inner->A->rows_count,sizeof(double));
+  sp_matrix_yale_solve_bicgstab_ilu(inner->A,inner->ilu,r,z0,
+                                    &max_iter,&tolerance,z);
+  spfree(z0);
+}
+
+static void gmres_solvers()
+{
+  sp_matrix_yale yale;
+  sp_matrix_yale_ilu ilu;
+  counting_operator op;
+  inner_solver inner;
+  sp_precond precond,inner_precond;
+  const int n = 15;
+  int i,m,max_iter,iter_plain,iter_first = 0;
+  double tolerance;
+  double *b, *x, *x0, *z;
+  
+  convection_diffusion(&yale,n,0.95);
+  ASSERT_TRUE(sp_matrix_yale_iluk(&yale,0,&ilu));
+  sp_precond_init(&precond,0,yale_ilu_precond,0,&ilu);
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  x0 = spcalloc(n*n,sizeof(double));
+  z = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    x[i] = i % 7 - 3;
+  sp_matrix_yale_mv(&yale,x,b);
+
+  for (m = 5; m <= 40; m *= 2)
+  {
+    /* without preconditioner */
+    max_iter = 2000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_gmres(&yale,m,0,b,x0,&max_iter,&tolerance,x);
+    iter_plain = max_iter;
+    ASSERT_TRUE(tolerance < 1e-10);
+    /* larger Krylov subspace needs fewer iterations */
+    if (m == 5)
+      iter_first = iter_plain;
+    else if (m == 40)
+      ASSERT_TRUE(iter_plain < iter_first/2);
+    sp_matrix_yale_mv(&yale,x,z);
+    for (i = 0; i < n*n; ++ i)
+      ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+    /* with ILU(0) */
+    max_iter = 2000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_gmres(&yale,m,&precond,b,x0,&max_iter,&tolerance,x);
+    ASSERT_TRUE(tolerance < 1e-10);
+    EXPECT_TRUE(max_iter < iter_plain);
+    sp_matrix_yale_mv(&yale,x,z);
+    for (i = 0; i < n*n; ++ i)
+      ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  }
+
+  /* FGMRES with the inner iterative solver as a preconditioner */
+  inner.A = &yale;
+  inner.ilu = &ilu;
+  sp_precond_init(&inner_precond,0,inner_bicgstab_precond,0,&inner);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_fgmres(&yale,10,&inner_precond,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+
+  /* matrix-free GMRES */
+  op.A = &yale;
+  op.calls = 0;
+  max_iter = 2000;
+  tolerance = 1e-10;
+  sp_operator_solve_gmres(n*n,counting_operator_mv,&op,20,&precond,
+                          b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  ASSERT_TRUE(op.calls > max_iter);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(z);
+  sp_matrix_yale_ilu_free(&ilu);
+  sp_matrix_yale_free(&yale);
+}
+
+static void precond_interface()
+{
+  sp_matrix_yale yale,yale_ccs;
+  sp_precond precond;
+  const int n = 12;
+  int i,k,max_iter;
+  double tolerance;
+  double *b, *x, *x0, *z;
+
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  x0 = spcalloc(n*n,sizeof(double));
+  z = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    x[i] = i % 5 - 2;
+
+  /* symmetric case: PCG with IC(0) and without preconditioner */
+  convection_diffusion(&yale,n,0);
+  sp_matrix_yale_convert(&yale,&yale_ccs,CCS);
+  sp_matrix_yale_mv(&yale_ccs,x,b);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_cg(&yale_ccs,b,x0,&max_iter,&tolerance,x);
+  k = max_iter;
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_precond(&yale_ccs,0,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  ASSERT_TRUE(max_iter == k);
+  sp_precond_ic0_init(&precond);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale_ccs));
+  /* setup could be repeated */
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale_ccs));
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_precond(&yale_ccs,&precond,
+                                   b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  EXPECT_TRUE(max_iter < k);
+  sp_matrix_yale_mv(&yale_ccs,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  sp_precond_free(&precond);
+  sp_matrix_yale_free(&yale_ccs);
+  sp_matrix_yale_free(&yale);
+
+  /* nonsymmetric case: CGS and TFQMR with ILU(1) */
+  convection_diffusion(&yale,n,0.9);
+  for (i = 0; i < n*n; ++ i)
+    x[i] = i % 5 - 2;
+  sp_matrix_yale_mv(&yale,x,b);
+  sp_precond_iluk_init(&precond,1);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_cgs_precond(&yale,&precond,
+                                   b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_tfqmr_precond(&yale,&precond,
+                                     b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-7);
+  sp_precond_free(&precond);
+  
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(z);
+  sp_matrix_yale_free(&yale);
+}
+
+/*
+ * Plane stress problem on the nx x ny grid of unit squares, every
+ * square divided into 2 linear triangles; left side is fixed.
+ * coords - output coordinates of the nodes
+ */
+static void plane_stress(sp_matrix_yale_ptr yale, int nx, int ny,
+                         double* coords)
+{
+  sp_matrix mtx;
+  const double E = 1, nu = 0.3;
+  const double D[3][3] = {{E/(1-nu*nu),E*nu/(1-nu*nu),0},
+                          {E*nu/(1-nu*nu),E/(1-nu*nu),0},
+                          {0,0,E/(2*(1+nu))}};
+  double B[3][6], DB[3][6], x[3], y[3];
+  int nodes[3];
+  int i,j,e,k,l,r,c,t,I,J;
+  int n = (nx+1)*(ny+1)*2;
+  sp_matrix_init(&mtx,n,n,18,CRS);
+  for (i = 0; i <= ny; ++ i)
+    for (j = 0; j <= nx; ++ j)
+    {
+      coords[(i*(nx+1)+j)*2] = j;
+      coords[(i*(nx+1)+j)*2+1] = i;
+    }
+  for (i = 0; i < ny; ++ i)
+    for (j = 0; j < nx; ++ j)
+      for (t = 0; t < 2; ++ t)
+      {
+        nodes[0] = i*(nx+1)+j;
+        nodes[1] = t ? (i+1)*(nx+1)+j+1 : i*(nx+1)+j+1;
+        nodes[2] = t ? (i+1)*(nx+1)+j : (i+1)*(nx+1)+j+1;
+        for (k = 0; k < 3; ++ k)
+        {
+          x[k] = coords[nodes[k]*2];
+          y[k] = coords[nodes[k]*2+1];
+        }
+        /* B = 1/(2*area)*[b_k 0; 0 c_k; c_k b_k], area = 1/2 */
+        memset(B,0,sizeof(B));
+        for (k = 0; k < 3; ++ k)
+        {
+          B[0][2*k] = B[2][2*k+1] = y[(k+1)%3] - y[(k+2)%3];
+          B[1][2*k+1] = B[2][2*k] = x[(k+2)%3] - x[(k+1)%3];
+        }
+        for (r = 0; r < 3; ++ r)
+          for (c = 0; c < 6; ++ c)
+          {
+            DB[r][c] = 0;
+            for (l = 0; l < 3; ++ l)
+              DB[r][c] += D[r][l]*B[l][c];
+          }
+        /* K = area*B^T*D*B */
+        for (k = 0; k < 6; ++ k)
+          for (l = 0; l < 6; ++ l)
+          {
+            I = nodes[k/2]*2 + k%2;
+            J = nodes[l/2]*2 + l%2;
+            if (coords[I-I%2] == 0 || coords[J-J%2] == 0)
+              continue;
+            for (e = 0, c = 0; c < 3; ++ c)
+              if (B[c][k] != 0 && DB[c][l] != 0)
+                e = 1;
+            if (e)
+            {
+              MTX(&mtx,I,J,0.5*(B[0][k]*DB[0][l]+B[1][k]*DB[1][l]+
+                                B[2][k]*DB[2][l]));
+            }
+          }
+      }
+  /* fixed nodes on the left side */
+  for (i = 0; i <= ny; ++ i)
+  {
+    MTX(&mtx,i*(nx+1)*2,i*(nx+1)*2,1);
+    MTX(&mtx,i*(nx+1)*2+1,i*(nx+1)*2+1,1);
+  }
+  sp_matrix_reorder(&mtx);
+  sp_matrix_yale_init(yale,&mtx);
+  sp_matrix_free(&mtx);
+}
+
+static void amg_preconditioner()
+{
+  sp_matrix_yale yale;
+  sp_amg amg;
+  sp_amg_params params;
+  sp_precond precond;
+  int sizes[2] = {16, 48};
+  int iters[2];
+  int i,s,n,max_iter,cg_iter;
+  double tolerance;
+  double *b, *x, *x0, *z, *coords, *modes;
+
+  /* 2d Poisson problem: iterations shall not grow with the size */
+  for (s = 0; s < 2; ++ s)
+  {
+    n = sizes[s]*sizes[s];
+    convection_diffusion(&yale,sizes[s],0);
+    b = spcalloc(n,sizeof(double));
+    x = spcalloc(n,sizeof(double));
+    x0 = spcalloc(n,sizeof(double));
+    z = spcalloc(n,sizeof(double));
+    for (i = 0; i < n; ++ i)
+      x[i] = i % 7 - 3;
+    sp_matrix_yale_mv(&yale,x,b);
+    ASSERT_TRUE(sp_amg_init(&amg,&yale,0));
+    ASSERT_TRUE(amg.levels_count > 1);
+    ASSERT_TRUE(amg.coarse_direct);
+    for (i = 1; i < amg.levels_count; ++ i)
+      ASSERT_TRUE(amg.levels[i].A.rows_count <
+                  amg.levels[i-1].A.rows_count);
+    sp_amg_free(&amg);
+    
+    sp_precond_amg_init(&precond,0);
+    ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+    max_iter = 1000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_pcg_precond(&yale,&precond,
+                                     b,x0,&max_iter,&tolerance,x);
+    iters[s] = max_iter;
+    ASSERT_TRUE(tolerance < 1e-10);
+    sp_matrix_yale_mv(&yale,x,z);
+    for (i = 0; i < n; ++ i)
+      ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+    max_iter = 1000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_cg(&yale,b,x0,&max_iter,&tolerance,x);
+    cg_iter = max_iter;
+    EXPECT_TRUE(iters[s] < cg_iter/3);
+    sp_precond_free(&precond);
+    spfree(b);
+    spfree(x);
+    spfree(x0);
+    spfree(z);
+    sp_matrix_yale_free(&yale);
+  }
+  EXPECT_TRUE(iters[1] < 2*iters[0]);
+
+  /* plane stress problem with rigid body modes */
+  n = 2*(24+1)*(8+1);
+  coords = spcalloc(n,sizeof(double));
+  modes = spcalloc(3*n,sizeof(double));
+  b = spcalloc(n,sizeof(double));
+  x = spcalloc(n,sizeof(double));
+  x0 = spcalloc(n,sizeof(double));
+  z = spcalloc(n,sizeof(double));
+  plane_stress(&yale,24,8,coords);
+  ASSERT_TRUE(sp_amg_rigid_body_modes(2,n/2,coords,modes) == 3);
+  for (i = 0; i < n; ++ i)
+    x[i] = coords[i - i%2] == 0 ? 0 : i % 5 - 2;
+  sp_matrix_yale_mv(&yale,x,b);
+  sp_amg_params_init(&params);
+  params.block_size = 2;
+  params.coarse_size = 50;
+  /* only translations */
+  sp_precond_amg_init(&precond,&params);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_precond(&yale,&precond,
+                                   b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  iters[0] = max_iter;
+  sp_precond_free(&precond);
+  /* translations and rotation */
+  params.nullspace_size = 3;
+  params.nullspace = modes;
+  sp_precond_amg_init(&precond,&params);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_precond(&yale,&precond,
+                                   b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  iters[1] = max_iter;
+  EXPECT_TRUE(iters[1] < iters[0]);
+  sp_matrix_yale_mv(&yale,x,z);
+  for (i = 0; i < n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_cg(&yale,b,x0,&max_iter,&tolerance,x);
+  EXPECT_TRUE(iters[1] < max_iter);
+  sp_precond_free(&precond);
+  
+  spfree(coords);
+  spfree(modes);
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(z);
+  sp_matrix_yale_free(&yale);
+}
+
+/* Solves the system with PCG, returns number of iterations */
+static int pcg_iterations(sp_matrix_yale_ptr yale,
+                          sp_precond_ptr precond,
+                          double* b,
+                          double* x)
+{
+  int i,max_iter = 1000;
+  int n = yale->rows_count;
+  double tolerance = 1e-10;
+  double* x0 = spcalloc(n,sizeof(double));
+  double* z = spcalloc(n,sizeof(double));
+  sp_matrix_yale_solve_pcg_precond(yale,precond,b,x0,&max_iter,&tolerance,x);
+  ASSERT_TRUE(tolerance < 1e-10);
+  sp_matrix_yale_mv(yale,x,z);
+  for (i = 0; i < n; ++ i)
+    ASSERT_TRUE(fabs(z[i] - b[i]) < 1e-8);
+  spfree(x0);
+  spfree(z);
+  return max_iter;
+}
+
+static void simple_preconditioners()
+{
+  sp_matrix mtx;
+  sp_matrix_yale yale,ccs;
+  sp_precond precond;
+  sp_amg_params params;
+  int i,n,cg_iter,jacobi_iter,iter;
+  double *b, *x, *coords;
+  double diag[3] = {2,4,8};
+  double r[3] = {1,1,1};
+  double z[3],work[9];
+
+  /* Poisson problem */
+  convection_diffusion(&yale,32,0);
+  n = yale.rows_count;
+  b = spcalloc(n,sizeof(double));
+  x = spcalloc(n,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    x[i] = i % 7 - 3;
+  sp_matrix_yale_mv(&yale,x,b);
+  cg_iter = pcg_iterations(&yale,0,b,x);
+
+  sp_precond_jacobi_init(&precond);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  jacobi_iter = pcg_iterations(&yale,&precond,b,x);
+  EXPECT_TRUE(jacobi_iter <= cg_iter);
+  sp_precond_free(&precond);
+
+  sp_precond_ssor_init(&precond,1.5);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  iter = pcg_iterations(&yale,&precond,b,x);
+  EXPECT_TRUE(iter < jacobi_iter/2);
+  sp_precond_free(&precond);
+
+  /* Chebyshev with estimated bounds, matrix in CCS format */
+  sp_matrix_yale_convert(&yale,&ccs,CCS);
+  sp_precond_chebyshev_init(&precond,4,0,0);
+  ASSERT_TRUE(sp_precond_setup(&precond,&ccs));
+  iter = pcg_iterations(&yale,&precond,b,x);
+  EXPECT_TRUE(iter < jacobi_iter/2);
+  sp_precond_free(&precond);
+  sp_matrix_yale_free(&ccs);
+
+  /* AMG with Chebyshev smoother */
+  sp_amg_params_init(&params);
+  params.smoother = SP_AMG_CHEBYSHEV;
+  sp_precond_amg_init(&precond,&params);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  iter = pcg_iterations(&yale,&precond,b,x);
+  EXPECT_TRUE(iter < jacobi_iter/4);
+  sp_precond_free(&precond);
+  spfree(b);
+  spfree(x);
+  sp_matrix_yale_free(&yale);
+
+  /* block Jacobi on the plane stress problem */
+  n = 2*(16+1)*(8+1);
+  coords = spcalloc(n,sizeof(double));
+  b = spcalloc(n,sizeof(double));
+  x = spcalloc(n,sizeof(double));
+  plane_stress(&yale,16,8,coords);
+  for (i = 0; i < n; ++ i)
+    x[i] = coords[i - i%2] == 0 ? 0 : i % 5 - 2;
+  sp_matrix_yale_mv(&yale,x,b);
+  sp_precond_block_jacobi_init(&precond,2);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  iter = pcg_iterations(&yale,&precond,b,x);
+  sp_precond_free(&precond);
+  sp_precond_jacobi_init(&precond);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  EXPECT_TRUE(iter <= pcg_iterations(&yale,&precond,b,x));
+  sp_precond_free(&precond);
+  sp_precond_block_jacobi_init(&precond,4);
+  ASSERT_FALSE(sp_precond_setup(&precond,&yale));
+  sp_precond_free(&precond);
+  spfree(coords);
+  spfree(b);
+  spfree(x);
+  sp_matrix_yale_free(&yale);
+
+  /* Chebyshev polynomial of the diagonal matrix is exact
+   * when the spectrum is one point */
+  sp_matrix_init(&mtx,3,3,1,CRS);
+  for (i = 0; i < 3; ++ i)
+    MTX(&mtx,i,i,diag[i]);
+  sp_matrix_yale_init(&yale,&mtx);
+  sp_matrix_free(&mtx);
+  sp_matrix_yale_chebyshev(&yale,diag,1,1,5,r,z,work);
+  for (i = 0; i < 3; ++ i)
+    ASSERT_TRUE(EQL(z[i],1/diag[i]));
+  sp_matrix_yale_free(&yale);
+}
+
+static void eigenvalue_estimates()
+{
+  sp_matrix mtx;
+  sp_matrix_yale yale;
+  int i,n = 100,max_iter;
+  double lambda_min,lambda_max,exact_min,exact_max,tolerance;
+  double *b, *x, *x0, *diag;
+
+  /* 1d Laplacian: eigenvalues 2 - 2*cos(k*pi/(n+1)), k = 1..n */
+  sp_matrix_init(&mtx,n,n,3,CRS);
+  for (i = 0; i < n; ++ i)
+  {
+    MTX(&mtx,i,i,2);
+    if (i > 0)
+      MTX(&mtx,i,i-1,-1);
+    if (i < n - 1)
+      MTX(&mtx,i,i+1,-1);
+  }
+  sp_matrix_yale_init(&yale,&mtx);
+  sp_matrix_free(&mtx);
+  exact_min = 2 - 2*cos(M_PI/(n+1));
+  exact_max = 2 - 2*cos(n*M_PI/(n+1));
+
+  /* full Lanczos process gives exact eigenvalues */
+  ASSERT_TRUE(sp_matrix_yale_lanczos(&yale,0,n,&lambda_min,&lambda_max));
+  ASSERT_TRUE(fabs(lambda_min - exact_min) < 1e-8);
+  ASSERT_TRUE(fabs(lambda_max - exact_max) < 1e-8);
+  /* few steps: eigenvalues are inside the spectrum */
+  ASSERT_TRUE(sp_matrix_yale_lanczos(&yale,0,30,&lambda_min,&lambda_max));
+  ASSERT_TRUE(lambda_min > exact_min - 1e-10);
+  ASSERT_TRUE(lambda_max < exact_max + 1e-10);
+  EXPECT_TRUE(lambda_max > 0.99*exact_max);
+  /* eigenvalues of D^{-1}*A */
+  diag = spcalloc(n,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    diag[i] = 2;
+  ASSERT_TRUE(sp_matrix_yale_lanczos(&yale,diag,n,&lambda_min,&lambda_max));
+  ASSERT_TRUE(fabs(lambda_min - exact_min/2) < 1e-8);
+  ASSERT_TRUE(fabs(lambda_max - exact_max/2) < 1e-8);
+
+  /* estimates from the CG coefficients */
+  b = spcalloc(n,sizeof(double));
+  x = spcalloc(n,sizeof(double));
+  x0 = spcalloc(n,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    x[i] = i % 7 - 3;
+  sp_matrix_yale_mv(&yale,x,b);
+  max_iter = 1000;
+  tolerance = 1e-12;
+  sp_matrix_yale_solve_cg_eigs(&yale,b,x0,&max_iter,&tolerance,x,
+                               &lambda_min,&lambda_max);
+  ASSERT_TRUE(tolerance < 1e-12);
+  EXPECT_TRUE(fabs(lambda_min - exact_min)/exact_min < 1e-3);
+  EXPECT_TRUE(fabs(lambda_max - exact_max)/exact_max < 1e-3);
+  max_iter = 1000;
+  tolerance = 1e-12;
+  sp_matrix_yale_solve_pcg_eigs(&yale,0,b,x0,&max_iter,&tolerance,x,
+                                &lambda_min,&lambda_max);
+  EXPECT_TRUE(fabs(lambda_max/lambda_min - exact_max/exact_min) <
+              1e-3*exact_max/exact_min);
+  sp_matrix_yale_printf_spectrum(&yale);
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(diag);
+  sp_matrix_yale_free(&yale);
+}
+
+static void block_cg_solvers()
+{
+  sp_matrix_yale yale,ccs;
+  sp_precond precond;
+  const int k = 4;
+  int i,c,n,max_iter;
+  int iters[4];
+  double tolerance;
+  double tol[4];
+  double *b, *x, *x0, *y;
+
+  convection_diffusion(&yale,24,0);
+  sp_matrix_yale_convert(&yale,&ccs,CCS);
+  n = yale.rows_count;
+  b = spcalloc(n*k,sizeof(double));
+  x = spcalloc(n*k,sizeof(double));
+  x0 = spcalloc(n*k,sizeof(double));
+  y = spcalloc(n,sizeof(double));
+  /* last right-hand side is zero and converges at once */
+  for (c = 0; c < k - 1; ++ c)
+    for (i = 0; i < n; ++ i)
+      b[c*n+i] = (i*(c+1)) % 11 - 5;
+
+  /* every column shall behave as a separate CG */
+  for (c = 0; c < k; ++ c)
+  {
+    iters[c] = 1000;
+    tol[c] = 1e-10;
+  }
+  sp_matrix_yale_solve_block_cg(&yale,k,b,x0,iters,tol,x);
+  ASSERT_TRUE(iters[k-1] == 0);
+  for (c = 0; c < k; ++ c)
+  {
+    ASSERT_TRUE(tol[c] < 1e-10);
+    sp_matrix_yale_mv(&yale,x+c*n,y);
+    for (i = 0; i < n; ++ i)
+      ASSERT_TRUE(fabs(y[i] - b[c*n+i]) < 1e-8);
+  }
+  for (c = 0; c < k - 1; ++ c)
+  {
+    max_iter = 1000;
+    tolerance = 1e-10;
+    sp_matrix_yale_solve_cg(&yale,b+c*n,x0,&max_iter,&tolerance,y);
+    EXPECT_TRUE(abs(max_iter - iters[c]) <= 1);
+  }
+
+  /* preconditioned, matrix in CCS format, limited iterations */
+  sp_precond_ssor_init(&precond,1.5);
+  ASSERT_TRUE(sp_precond_setup(&precond,&yale));
+  for (c = 0; c < k; ++ c)
+  {
+    iters[c] = c == 0 ? 3 : 1000;
+    tol[c] = 1e-10;
+  }
+  sp_matrix_yale_solve_block_pcg(&ccs,&precond,k,b,x0,iters,tol,x);
+  ASSERT_TRUE(iters[0] == 3);
+  ASSERT_TRUE(tol[0] > 1e-10);
+  for (c = 1; c < k; ++ c)
+  {
+    ASSERT_TRUE(tol[c] < 1e-10);
+    sp_matrix_yale_mv(&yale,x+c*n,y);
+    for (i = 0; i < n; ++ i)
+      ASSERT_TRUE(fabs(y[i] - b[c*n+i]) < 1e-8);
+  }
+  max_iter = 1000;
+  tolerance = 1e-10;
+  sp_matrix_yale_solve_pcg_precond(&yale,&precond,b+n,x0,
+                                   &max_iter,&tolerance,y);
+  EXPECT_TRUE(abs(max_iter - iters[1]) <= 1);
+  sp_precond_free(&precond);
+
+  spfree(b);
+  spfree(x);
+  spfree(x0);
+  spfree(y);
+  sp_matrix_yale_free(&yale);
+  sp_matrix_yale_free(&ccs);
+}
+
 static void load_from_files()
 {
   sp_matrix_yale mtx;
@@ -1507,6 +2578,1015 @@ static void yale_transpose_convert()
   sp_matrix_yale_free(&yale3);
 }
 
+/* fills the dense row-wise matrix from the Yale matrix */
+static void yale_to_dense(sp_matrix_yale_ptr yale, double* dense)
+{
+  int i,p;
+  int n = yale->storage_type == CRS ? yale->rows_count : yale->cols_count;
+  memset(dense,0,yale->rows_count*yale->cols_count*sizeof(double));
+  for (i = 0; i < n; ++ i)
+    for (p = yale->offsets[i]; p < yale->offsets[i+1]; ++ p)
+      if (yale->storage_type == CRS)
+        dense[i*yale->cols_count + yale->indicies[p]] += yale->values[p];
+      else
+        dense[yale->indicies[p]*yale->cols_count + i] += yale->values[p];
+}
+
+/* random sparse matrix with about nnz elements in every row */
+static void random_yale(sp_matrix_yale_ptr yale, int rows, int cols,
+                        int nnz, sparse_storage_type type, unsigned* seed)
+{
+  sp_matrix mtx;
+  int i,k;
+  sp_matrix_init(&mtx,rows,cols,nnz,type);
+  for (i = 0; i < rows; ++ i)
+    for (k = 0; k < nnz; ++ k)
+    {
+      *seed = *seed*1103515245u + 12345u;
+      MTX(&mtx,i,(*seed >> 8) % cols,(double)((*seed >> 4) % 19) - 9);
+    }
+  sp_matrix_reorder(&mtx);
+  sp_matrix_yale_init(yale,&mtx);
+  sp_matrix_free(&mtx);
+}
+
+static void yale_mult()
+{
+  /* sizes: wide matrix B with short rows uses the hash accumulator */
+  const int rows[2] = {30, 40}, inner[2] = {25, 50}, cols[2] = {35, 2000};
+  const int nnz[2] = {6, 2};
+  sparse_storage_type types[2] = {CRS, CCS};
+  sp_matrix_yale A,B,C;
+  double *a, *b, *c, *expected;
+  unsigned seed = 7;
+  int s,ta,tb,i,j,k,p;
+
+  for (s = 0; s < 2; ++ s)
+    for (ta = 0; ta < 2; ++ ta)
+      for (tb = 0; tb < 2; ++ tb)
+      {
+        random_yale(&A,rows[s],inner[s],nnz[s],types[ta],&seed);
+        random_yale(&B,inner[s],cols[s],nnz[s],types[tb],&seed);
+        a = spcalloc(rows[s]*inner[s],sizeof(double));
+        b = spcalloc(inner[s]*cols[s],sizeof(double));
+        c = spcalloc(rows[s]*cols[s],sizeof(double));
+        expected = spcalloc(rows[s]*cols[s],sizeof(double));
+        yale_to_dense(&A,a);
+        yale_to_dense(&B,b);
+        for (i = 0; i < rows[s]; ++ i)
+          for (k = 0; k < inner[s]; ++ k)
+            for (j = 0; j < cols[s]; ++ j)
+              expected[i*cols[s]+j] += a[i*inner[s]+k]*b[k*cols[s]+j];
+        
+        ASSERT_TRUE(sp_matrix_yale_mult(&A,&B,&C));
+        ASSERT_TRUE(C.storage_type == (ta && tb ? CCS : CRS));
+        ASSERT_TRUE(C.rows_count == rows[s] && C.cols_count == cols[s]);
+        /* indicies are sorted */
+        for (i = 0; i < (ta && tb ? cols[s] : rows[s]); ++ i)
+          for (p = C.offsets[i]+1; p < C.offsets[i+1]; ++ p)
+            ASSERT_TRUE(C.indicies[p-1] < C.indicies[p]);
+        yale_to_dense(&C,c);
+        for (i = 0; i < rows[s]*cols[s]; ++ i)
+          ASSERT_TRUE(fabs(c[i] - expected[i]) < 1e-10);
+        
+        /* numeric part with the same portraits and new values */
+        for (p = 0; p < A.nonzeros; ++ p)
+          A.values[p] *= 2;
+        for (p = 0; p < B.nonzeros; ++ p)
+          B.values[p] -= 1;
+        yale_to_dense(&A,a);
+        yale_to_dense(&B,b);
+        memset(expected,0,rows[s]*cols[s]*sizeof(double));
+        for (i = 0; i < rows[s]; ++ i)
+          for (k = 0; k < inner[s]; ++ k)
+            for (j = 0; j < cols[s]; ++ j)
+              expected[i*cols[s]+j] += a[i*inner[s]+k]*b[k*cols[s]+j];
+        ASSERT_TRUE(sp_matrix_yale_mult_numeric(&A,&B,&C));
+        yale_to_dense(&C,c);
+        for (i = 0; i < rows[s]*cols[s]; ++ i)
+          ASSERT_TRUE(fabs(c[i] - expected[i]) < 1e-10);
+        
+        spfree(a);
+        spfree(b);
+        spfree(c);
+        spfree(expected);
+        sp_matrix_yale_free(&A);
+        sp_matrix_yale_free(&B);
+        sp_matrix_yale_free(&C);
+      }
+  /* inconsistent sizes */
+  random_yale(&A,5,6,2,CRS,&seed);
+  ASSERT_FALSE(sp_matrix_yale_mult(&A,&A,&C));
+  sp_matrix_yale_free(&A);
+}
+
+static void yale_add()
+{
+  const int n = 40;
+  sparse_storage_type types[2] = {CRS, CCS};
+  sp_matrix_yale K,M,C,S;
+  double *k, *m, *c, *scale;
+  unsigned seed = 11;
+  int t,tm,i,j,p;
+  const double dt = 0.25;
+
+  k = spcalloc(n*n,sizeof(double));
+  m = spcalloc(n*n,sizeof(double));
+  c = spcalloc(n*n,sizeof(double));
+  scale = spcalloc(n,sizeof(double));
+  for (i = 0; i < n; ++ i)
+    scale[i] = 1 + i % 3;
+  for (t = 0; t < 2; ++ t)
+    for (tm = 0; tm < 2; ++ tm)
+    {
+      /* C = K + dt*M, different portraits */
+      random_yale(&K,n,n,4,types[t],&seed);
+      random_yale(&M,n,n,3,types[tm],&seed);
+      yale_to_dense(&K,k);
+      yale_to_dense(&M,m);
+      ASSERT_TRUE(sp_matrix_yale_add(1,&K,dt,&M,&C));
+      ASSERT_TRUE(C.storage_type == types[t]);
+      ASSERT_TRUE(C.nonzeros <= K.nonzeros + M.nonzeros);
+      for (i = 0; i < n; ++ i)
+        for (p = C.offsets[i]+1; p < C.offsets[i+1]; ++ p)
+          ASSERT_TRUE(C.indicies[p-1] < C.indicies[p]);
+      yale_to_dense(&C,c);
+      for (i = 0; i < n*n; ++ i)
+        ASSERT_TRUE(fabs(c[i] - k[i] - dt*m[i]) < 1e-12);
+      
+      if (t == tm)
+      {
+        /* portrait of M is a subset of C: C = 2*C - M */
+        ASSERT_TRUE(sp_matrix_yale_add_inplace(2,&C,-1,&M));
+        yale_to_dense(&C,c);
+        for (i = 0; i < n*n; ++ i)
+          ASSERT_TRUE(fabs(c[i] - 2*k[i] - (2*dt-1)*m[i]) < 1e-12);
+        /* portrait of C is not a subset of M */
+        if (C.nonzeros > M.nonzeros)
+          ASSERT_FALSE(sp_matrix_yale_add_inplace(1,&M,1,&C));
+      }
+      sp_matrix_yale_free(&C);
+
+      /* scaling */
+      sp_matrix_yale_copy(&K,&S);
+      sp_matrix_yale_scale(&S,scale,0);
+      yale_to_dense(&S,c);
+      for (i = 0; i < n; ++ i)
+        for (j = 0; j < n; ++ j)
+          ASSERT_TRUE(fabs(c[i*n+j] - scale[i]*k[i*n+j]) < 1e-12);
+      sp_matrix_yale_scale(&S,0,scale);
+      yale_to_dense(&S,c);
+      for (i = 0; i < n; ++ i)
+        for (j = 0; j < n; ++ j)
+          ASSERT_TRUE(fabs(c[i*n+j] - scale[i]*k[i*n+j]*scale[j]) < 1e-12);
+      sp_matrix_yale_free(&S);
+      sp_matrix_yale_free(&K);
+      sp_matrix_yale_free(&M);
+    }
+  spfree(k);
+  spfree(m);
+  spfree(c);
+  spfree(scale);
+}
+
+static void yale_mm()
+{
+  sp_matrix_yale yale;
+  const int ks[3] = {1, 3, 11};
+  sparse_storage_type types[2] = {CRS, CCS};
+  const int rows = 37, cols = 23;
+  int t,s,l,i,c,k;
+  unsigned seed = 7;
+  double *X, *Y, *x, *y;
+  sp_dense_layout layout;
+
+  x = spcalloc(cols,sizeof(double));
+  y = spcalloc(rows,sizeof(double));
+  for (t = 0; t < 2; ++ t)
+  {
+    random_yale(&yale,rows,cols,4,types[t],&seed);
+    for (s = 0; s < 3; ++ s)
+    {
+      k = ks[s];
+      X = spcalloc(cols*k,sizeof(double));
+      Y = spcalloc(rows*k,sizeof(double));
+      for (l = 0; l < 2; ++ l)
+      {
+        layout = l ? SP_COL_MAJOR : SP_ROW_MAJOR;
+        for (i = 0; i < cols*k; ++ i)
+          X[i] = (i*7) % 13 - 6;
+        sp_matrix_yale_mm(&yale,k,layout,X,Y);
+        /* compare with k matrix-vector products */
+        for (c = 0; c < k; ++ c)
+        {
+          for (i = 0; i < cols; ++ i)
+            x[i] = layout == SP_ROW_MAJOR ? X[i*k+c] : X[c*cols+i];
+          sp_matrix_yale_mv(&yale,x,y);
+          for (i = 0; i < rows; ++ i)
+            ASSERT_TRUE(EQL(y[i],layout == SP_ROW_MAJOR ?
+                            Y[i*k+c] : Y[c*rows+i]));
+        }
+      }
+      spfree(X);
+      spfree(Y);
+    }
+    sp_matrix_yale_free(&yale);
+  }
+  spfree(x);
+  spfree(y);
+}
+static void mm_fast_loader()
+{
+  const char* numbers[] = {"0", "-0.25", "1.5e-3", "+17", "1D+02",
+                           "0.1", "3.14159265358979323846",
+                           "123456789012345678901234", "1e-5", ".5",
+                           "4.9406564584124654e-324",
+                           "2.2250738585072014e-308",
+                           "1.7976931348623157e308", "9007199254740993",
+                           "0.000000000000000000000000123"};
+  const char* ptr;
+  const char* mm =
+    "%%MatrixMarket matrix coordinate real symmetric\r\n"
+    "% comment\n"
+    "\n"
+    "  3 3 4\r\n"
+    "1 1 4.0\n"
+    "% comment inside\n"
+    "2 1 -1e0\r\n"
+    "\t3 2 -1.0D+00\n"
+    "3 3 4\n";
+  double expected[9] = {4,-1,0, -1,0,-1, 0,-1,4};
+  char buf[64];
+  sp_matrix_yale yale,loaded;
+  sparse_storage_type types[2] = {CRS, CCS};
+  double value;
+  int i,t,k;
+  unsigned seed = 3;
+  FILE* f;
+
+  /* number parsers */
+  for (i = 0; i < (int)(sizeof(numbers)/sizeof(numbers[0])); ++ i)
+  {
+    strcpy(buf,numbers[i]);
+    for (k = 0; buf[k]; ++ k)
+      if (buf[k] == 'D')
+        buf[k] = 'e';
+    ptr = sp_parse_double(numbers[i],numbers[i]+strlen(numbers[i]),&value);
+    ASSERT_TRUE(ptr == numbers[i] + strlen(numbers[i]));
+    ASSERT_TRUE(value == strtod(buf,0));
+  }
+  ptr = "  -42x";
+  ASSERT_TRUE(sp_parse_int(ptr,ptr+6,&k) == ptr+5 && k == -42);
+  ASSERT_TRUE(sp_parse_int(ptr,ptr+2,&k) == ptr);
+  ptr = "1.5e+";
+  ASSERT_TRUE(sp_parse_double(ptr,ptr+5,&value) == ptr+3 && value == 1.5);
+  ptr = "e5";
+  ASSERT_TRUE(sp_parse_double(ptr,ptr+2,&value) == ptr);
+  /* longer than the stack buffer */
+  ptr = "0.3333333333333333333333333333333333333333"
+    "33333333333333333333333333333333333333333e-2";
+  ASSERT_TRUE(sp_parse_double(ptr,ptr+strlen(ptr),&value) ==
+              ptr+strlen(ptr) && value == strtod(ptr,0));
+
+  /* symmetric matrix with comments, empty lines and CRLF */
+  f = fopen("test_mm_loader.mtx","wb");
+  ASSERT_TRUE(f);
+  fputs(mm,f);
+  fclose(f);
+  for (t = 0; t < 2; ++ t)
+  {
+    ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_mm_loader.mtx",
+                                         types[t]));
+    ASSERT_TRUE(loaded.storage_type == types[t]);
+    ASSERT_TRUE(loaded.nonzeros == 6);
+    for (i = 0; i < 3; ++ i)
+      for (k = loaded.offsets[i]; k < loaded.offsets[i+1]; ++ k)
+      {
+        ASSERT_TRUE(k == loaded.offsets[i] ||
+                    loaded.indicies[k-1] < loaded.indicies[k]);
+        ASSERT_TRUE(EQL(loaded.values[k],expected[i*3+loaded.indicies[k]]));
+      }
+    sp_matrix_yale_free(&loaded);
+  }
+  /* truncated file */
+  f = fopen("test_mm_loader.mtx","wb");
+  ASSERT_TRUE(f);
+  fputs("%%MatrixMarket matrix coordinate real general\n2 2 3\n1 1 1\n",f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file(&loaded,"test_mm_loader.mtx",CRS));
+
+  /* save and load */
+  for (t = 0; t < 2; ++ t)
+  {
+    random_yale(&yale,40,25,5,types[t],&seed);
+    ASSERT_TRUE(sp_matrix_yale_save_file(&yale,"test_mm_loader.mtx"));
+    ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_mm_loader.mtx",
+                                         types[t]));
+    ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+    sp_matrix_yale_free(&loaded);
+    sp_matrix_yale_free(&yale);
+  }
+  remove("test_mm_loader.mtx");
+}
+
+static void parallel_loader()
+{
+  /* several megabytes to be split into chunks parsed by threads */
+  const int n = 20000;
+  sp_matrix_yale yale,loaded;
+  unsigned seed = 11;
+  int i,k,lower = 0;
+  FILE* f;
+
+  random_yale(&yale,n,n,8,CRS,&seed);
+  /* every element split into 2 halves, rows in reverse order */
+  f = fopen("test_par_loader.mtx","wb");
+  ASSERT_TRUE(f);
+  fprintf(f,"%%%%MatrixMarket matrix coordinate real general\n");
+  fprintf(f,"%d %d %d\n",n,n,2*yale.nonzeros);
+  for (i = n - 1; i >= 0; -- i)
+    for (k = yale.offsets[i]; k < yale.offsets[i+1]; ++ k)
+      fprintf(f,"%d %d %.17g\n%% comment\n%d %d %.17g\n",
+              i+1,yale.indicies[k]+1,yale.values[k]/2,
+              i+1,yale.indicies[k]+1,yale.values[k]/2);
+  fclose(f);
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_par_loader.mtx",CRS));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+  sp_matrix_yale_free(&loaded);
+
+  /* skew-symmetric matrix from the strict lower triangle, without zeros
+   * which look symmetric */
+  f = fopen("test_par_loader.mtx","wb");
+  ASSERT_TRUE(f);
+  for (i = 0; i < n; ++ i)
+    for (k = yale.offsets[i]; k < yale.offsets[i+1]; ++ k)
+      lower += yale.indicies[k] < i && yale.values[k] != 0;
+  fprintf(f,"%%%%MatrixMarket matrix coordinate real skew-symmetric\n");
+  fprintf(f,"%d %d %d\n",n,n,lower);
+  for (i = 0; i < n; ++ i)
+    for (k = yale.offsets[i]; k < yale.offsets[i+1]; ++ k)
+      if (yale.indicies[k] < i && yale.values[k] != 0)
+        fprintf(f,"%d %d %.17g\n",i+1,yale.indicies[k]+1,yale.values[k]);
+  fclose(f);
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_par_loader.mtx",CCS));
+  ASSERT_TRUE(loaded.nonzeros == 2*lower);
+  ASSERT_TRUE(sp_matrix_yale_properites(&loaded) == PROP_SKEW_SYMMETRIC);
+  sp_matrix_yale_free(&loaded);
+  remove("test_par_loader.mtx");
+
+  /* 0-based triplets */
+  ASSERT_TRUE(sp_matrix_yale_save_file(&yale,"test_par_loader.txt"));
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_par_loader.txt",CRS));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+  sp_matrix_yale_free(&loaded);
+  remove("test_par_loader.txt");
+  sp_matrix_yale_free(&yale);
+}
+
+static void hb_fixed_width()
+{
+  /* 5x5 general matrix, column 1 unsorted, fields without separating
+   * spaces, D exponent and FORTRAN exponent without the letter */
+  const char* rua =
+    "5x5 unsymmetric test matrix                                             5by5    \n"
+    "             8             2             2             4             0\n"
+    "RUA                        5             5            11             0\n"
+    "(3I4)           (6I3)           (3E12.4)            \n"
+    "   1   4   6\n"
+    "   8  10  12\n"
+    "  5  3  1  1  4  2\n"
+    "  5  1  4  2  5\n"
+    "  0.5000E+01  2.0000D+00  1.0000E+00\n"
+    " -3.0000E+00  0.4000+001 -2.0000E+00\n"
+    " -5.0000E+00 -1.0000E+00-4.00000E+00\n"
+    "  3.0000E+00     6.00000\n";
+  const double rua_expected[25] = {1,-3,0,-1,0, 0,0,-2,0,3, 2,0,0,0,0,
+                                   0,4,0,-4,0, 5,0,-5,0,6};
+  /* symmetric 3x3 lower triangle with CRLF line ends */
+  const char* rsa =
+    "3x3 symmetric test matrix                                               3by3    \r\n"
+    "             3             1             1             1             0\r\n"
+    "RSA                        3             3             5             0\r\n"
+    "(4I5)           (5I3)           (5F8.2)             \r\n"
+    "    1    3    5    6\r\n"
+    "  1  2  2  3  3\r\n"
+    "    4.00   -1.00    4.00   -1.00    4.00\r\n";
+  const double rsa_expected[9] = {4,-1,0, -1,4,-1, 0,-1,4};
+  const char* contents[2];
+  const double* expected[2];
+  int sizes[2] = {5, 3};
+  double dense[25];
+  sp_matrix_yale loaded;
+  int i,t;
+  FILE* f;
+  contents[0] = rua; contents[1] = rsa;
+  expected[0] = rua_expected; expected[1] = rsa_expected;
+
+  for (t = 0; t < 2; ++ t)
+  {
+    f = fopen("test_hb.rua","wb");
+    ASSERT_TRUE(f);
+    fputs(contents[t],f);
+    fclose(f);
+    ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_hb.rua",CRS));
+    ASSERT_TRUE(loaded.storage_type == CCS);
+    ASSERT_TRUE(loaded.rows_count == sizes[t]);
+    for (i = 0; i < loaded.cols_count; ++ i)
+      ASSERT_TRUE(loaded.offsets[i+1] == loaded.offsets[i] ||
+                  loaded.indicies[loaded.offsets[i]] <
+                  loaded.indicies[loaded.offsets[i+1]-1]);
+    yale_to_dense(&loaded,dense);
+    for (i = 0; i < sizes[t]*sizes[t]; ++ i)
+      ASSERT_TRUE(EQL(dense[i],expected[t][i]));
+    sp_matrix_yale_free(&loaded);
+  }
+  /* declared more lines than present */
+  f = fopen("test_hb.rua","wb");
+  ASSERT_TRUE(f);
+  fwrite(rsa,1,strlen(rsa)-20,f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file(&loaded,"test_hb.rua",CRS));
+  remove("test_hb.rua");
+}
+
+static void matrix_vectors()
+{
+  /* two right-hand sides, zero guesses and solutions (1,1,1), (1,2,3) */
+  const char* full =
+    "3x3 symmetric matrix with right-hand sides                              3by3rhs\n"
+    "             9             1             1             1             6\n"
+    "RSA                        3             3             5             0\n"
+    "(4I5)           (5I3)           (5F8.2)             (4F8.2)\n"
+    "FGX                        2             0\n"
+    "    1    3    5    6\n"
+    "  1  2  2  3  3\n"
+    "    4.00   -1.00    4.00   -1.00    4.00\n"
+    "    3.00    2.00    3.00    2.00\n"
+    "    4.00   10.00\n"
+    "    0.00    0.00    0.00    0.00\n"
+    "    0.00    0.00\n"
+    "    1.00    1.00    1.00    1.00\n"
+    "    2.00    3.00\n";
+  /* the same right-hand sides without zeros in the sparse form */
+  const char* sparse =
+    "3x3 symmetric matrix with sparse right-hand sides                       3by3rhs\n"
+    "             6             1             1             1             3\n"
+    "RSA                        3             3             5             0\n"
+    "(4I5)           (5I3)           (5F8.2)             (4F8.2)\n"
+    "M                          2             4\n"
+    "    1    3    5    6\n"
+    "  1  2  2  3  3\n"
+    "    4.00   -1.00    4.00   -1.00    4.00\n"
+    "    1    3    5\n"
+    "  1  3  2  3\n"
+    "    3.00    3.00    4.00   10.00\n";
+  const double rhs_full[6] = {3,2,3, 2,4,10};
+  const double rhs_sparse[6] = {3,0,3, 0,4,10};
+  const double solution[6] = {1,1,1, 1,2,3};
+  sp_matrix_yale loaded;
+  sp_matrix_vectors vectors;
+  int i;
+  FILE* f;
+
+  f = fopen("test_vectors.rsa","wb");
+  ASSERT_TRUE(f);
+  fputs(full,f);
+  fclose(f);
+  ASSERT_TRUE(sp_matrix_yale_load_file_vectors(&loaded,&vectors,
+                                               "test_vectors.rsa",CCS));
+  ASSERT_TRUE(loaded.nonzeros == 7);
+  ASSERT_TRUE(vectors.rows == 3 && vectors.count == 2);
+  ASSERT_TRUE(vectors.rhs && vectors.guess && vectors.solution);
+  for (i = 0; i < 6; ++ i)
+  {
+    ASSERT_TRUE(EQL(vectors.rhs[i],rhs_full[i]));
+    ASSERT_TRUE(EQL(vectors.guess[i],0));
+    ASSERT_TRUE(EQL(vectors.solution[i],solution[i]));
+  }
+  sp_matrix_vectors_free(&vectors);
+  sp_matrix_yale_free(&loaded);
+  /* matrix alone */
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_vectors.rsa",CCS));
+  sp_matrix_yale_free(&loaded);
+
+  f = fopen("test_vectors.rsa","wb");
+  ASSERT_TRUE(f);
+  fputs(sparse,f);
+  fclose(f);
+  ASSERT_TRUE(sp_matrix_yale_load_file_vectors(&loaded,&vectors,
+                                               "test_vectors.rsa",CCS));
+  ASSERT_TRUE(vectors.count == 2 && !vectors.guess && !vectors.solution);
+  for (i = 0; i < 6; ++ i)
+    ASSERT_TRUE(EQL(vectors.rhs[i],rhs_sparse[i]));
+  sp_matrix_vectors_free(&vectors);
+  sp_matrix_yale_free(&loaded);
+  /* truncated vectors */
+  f = fopen("test_vectors.rsa","wb");
+  fwrite(sparse,1,strlen(sparse)-10,f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file_vectors(&loaded,&vectors,
+                                                "test_vectors.rsa",CCS));
+  remove("test_vectors.rsa");
+
+  /* Matrix Market with the companion files */
+  f = fopen("test_vectors.mtx","wt");
+  fputs("%%MatrixMarket matrix coordinate real symmetric\n"
+        "3 3 5\n1 1 4\n2 1 -1\n2 2 4\n3 2 -1\n3 3 4\n",f);
+  fclose(f);
+  f = fopen("test_vectors_b.mtx","wt");
+  fputs("%%MatrixMarket matrix array real general\n"
+        "% two right-hand sides\n3 2\n3\n2\n3\n2\n4\n10\n",f);
+  fclose(f);
+  ASSERT_TRUE(sp_matrix_yale_load_file_vectors(&loaded,&vectors,
+                                               "test_vectors.mtx",CRS));
+  ASSERT_TRUE(vectors.count == 2 && vectors.rhs && !vectors.solution);
+  for (i = 0; i < 6; ++ i)
+    ASSERT_TRUE(EQL(vectors.rhs[i],rhs_full[i]));
+  sp_matrix_vectors_free(&vectors);
+  sp_matrix_yale_free(&loaded);
+  f = fopen("test_vectors_x.mtx","wt");
+  fputs("%%MatrixMarket matrix coordinate real general\n"
+        "3 2 6\n1 1 1\n2 1 1\n3 1 1\n1 2 1\n2 2 2\n3 2 3\n",f);
+  fclose(f);
+  ASSERT_TRUE(sp_matrix_yale_load_file_vectors(&loaded,&vectors,
+                                               "test_vectors.mtx",CRS));
+  for (i = 0; i < 6; ++ i)
+    ASSERT_TRUE(EQL(vectors.solution[i],solution[i]));
+  sp_matrix_vectors_free(&vectors);
+  sp_matrix_yale_free(&loaded);
+  /* wrong number of solutions */
+  f = fopen("test_vectors_x.mtx","wt");
+  fputs("%%MatrixMarket matrix array real general\n3 1\n1\n1\n1\n",f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file_vectors(&loaded,&vectors,
+                                                "test_vectors.mtx",CRS));
+  remove("test_vectors.mtx");
+  remove("test_vectors_b.mtx");
+  remove("test_vectors_x.mtx");
+}
+
+static void fast_writer()
+{
+  const double values[] = {0, 1, -4, 0.1, 1.0/3, 1e-7, 1e21, 5e-324,
+                           1.7976931348623157e308, 123456.789e-300};
+  const char* shortest[] = {"0", "1", "-4", "0.1", "0.3333333333333333",
+                            "1e-7", "1e21", "5e-324",
+                            "1.7976931348623157e308", "1.23456789e-295"};
+  const int n = 20000;
+  char buf[SP_DTOA_SIZE],line[128];
+  sp_matrix mtx;
+  sp_matrix_yale yale,loaded;
+  unsigned seed = 13;
+  int i,p;
+  FILE* f;
+
+  for (i = 0; i < (int)(sizeof(values)/sizeof(values[0])); ++ i)
+  {
+    ASSERT_TRUE(sp_dtoa(values[i],buf) == (int)strlen(shortest[i]));
+    ASSERT_TRUE(!strcmp(buf,shortest[i]));
+  }
+  /* Grisu2 is not always the shortest, but always reads back */
+  sp_dtoa(1e23,buf);
+  ASSERT_TRUE(strtod(buf,0) == 1e23);
+  ASSERT_TRUE(sp_itoa(-2147483647-1,buf) == 11 &&
+              !strcmp(buf,"-2147483648"));
+
+  /* several chunks, values not representable by few digits */
+  random_yale(&yale,n,n,8,CRS,&seed);
+  for (p = 0; p < yale.nonzeros; ++ p)
+    yale.values[p] /= 3;
+  ASSERT_TRUE(sp_matrix_yale_save_file_props(&yale,"test_writer.mtx",
+                                             PROP_GENERAL));
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_writer.mtx",CRS));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+  for (p = 0; p < yale.nonzeros; ++ p)
+    ASSERT_TRUE(yale.values[p] == loaded.values[p]);
+  sp_matrix_yale_free(&loaded);
+  sp_matrix_yale_free(&yale);
+
+  /* known symmetry: only the lower triangle written */
+  sp_matrix_init(&mtx,n,n,3,CRS);
+  for (i = 0; i < n; ++ i)
+  {
+    MTX(&mtx,i,i,2.1);
+    if (i > 0) MTX(&mtx,i,i-1,-1.0/7);
+    if (i < n-1) MTX(&mtx,i,i+1,-1.0/7);
+  }
+  sp_matrix_yale_init(&yale,&mtx);
+  sp_matrix_free(&mtx);
+  ASSERT_TRUE(sp_matrix_yale_save_file_props(&yale,"test_writer.mtx",
+                                             PROP_SYMMETRIC));
+  f = fopen("test_writer.mtx","r");
+  ASSERT_TRUE(f && fgets(line,sizeof(line),f));
+  fclose(f);
+  ASSERT_TRUE(strstr(line,"symmetric"));
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_writer.mtx",CRS));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+  sp_matrix_yale_free(&loaded);
+  sp_matrix_yale_free(&yale);
+  remove("test_writer.mtx");
+}
+
+static void binary_format()
+{
+  sparse_storage_type types[2] = {CRS, CCS};
+  sp_matrix_yale yale,loaded,mapped;
+  sp_file_view view;
+  unsigned seed = 5;
+  char buf[256];
+  size_t size;
+  int i,k,t;
+  FILE* f;
+
+  for (t = 0; t < 2; ++ t)
+  {
+    random_yale(&yale,300,200,7,types[t],&seed);
+    ASSERT_TRUE(sp_matrix_yale_save_file(&yale,"test_binary.spb"));
+    /* storage type of the file is kept */
+    ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_binary.spb",
+                                         types[1-t]));
+    ASSERT_TRUE(loaded.storage_type == types[t]);
+    ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+    sp_matrix_yale_free(&loaded);
+    /* zero-copy view with aligned arrays */
+    ASSERT_TRUE(sp_matrix_yale_map_file(&mapped,&view,1,"test_binary.spb"));
+    ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&mapped) == MTX_SAME);
+    ASSERT_TRUE((const char*)mapped.offsets >= view.data &&
+                (const char*)mapped.values < view.data + view.size);
+    ASSERT_TRUE(((const char*)mapped.values - view.data) % 64 == 0);
+    /* index out of range */
+    k = (int)((const char*)mapped.indicies - view.data);
+    sp_file_view_close(&view);
+    f = fopen("test_binary.spb","r+b");
+    ASSERT_TRUE(f && fseek(f,k,SEEK_SET) == 0);
+    i = -1;
+    fwrite(&i,sizeof(int),1,f);
+    fclose(f);
+    ASSERT_FALSE(sp_matrix_yale_load_file(&loaded,"test_binary.spb",CRS));
+    ASSERT_FALSE(sp_matrix_yale_map_file(&mapped,&view,1,"test_binary.spb"));
+    ASSERT_TRUE(sp_matrix_yale_map_file(&mapped,&view,0,"test_binary.spb"));
+    sp_file_view_close(&view);
+    sp_matrix_yale_free(&yale);
+  }
+  /* truncated file */
+  f = fopen("test_binary.spb","rb");
+  ASSERT_TRUE(f);
+  size = fread(buf,1,sizeof(buf),f);
+  fclose(f);
+  ASSERT_TRUE(size == sizeof(buf));
+  f = fopen("test_binary.spb","wb");
+  fwrite(buf,1,sizeof(buf),f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file(&loaded,"test_binary.spb",CRS));
+  /* not a binary matrix */
+  buf[0] = 'X';
+  f = fopen("test_binary.spb","wb");
+  fwrite(buf,1,sizeof(buf),f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_map_file(&mapped,&view,1,"test_binary.spb"));
+  remove("test_binary.spb");
+}
+
+/* Returns the size of the file in bytes, -1 if not possible */
+static long file_size(const char* filename)
+{
+  long size = -1;
+  FILE* f = fopen(filename,"rb");
+  if (f)
+  {
+    fseek(f,0,SEEK_END);
+    size = ftell(f);
+    fclose(f);
+  }
+  return size;
+}
+
+static void compressed_format()
+{
+  const int n = 200;            /* grid size of the Laplacian */
+  sparse_storage_type types[2] = {CRS, CCS};
+  sp_matrix lapl;
+  sp_matrix_yale yale,loaded;
+  unsigned seed = 9;
+  char* buf;
+  long size;
+  int i,j,k,t;
+  FILE* f;
+
+  for (t = 0; t < 2; ++ t)
+  {
+    random_yale(&yale,500,300,9,types[t],&seed);
+    ASSERT_TRUE(sp_matrix_yale_save_file(&yale,"test_compressed.spz"));
+    ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_compressed.spz",
+                                         types[1-t]));
+    ASSERT_TRUE(loaded.storage_type == types[t]);
+    ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+    sp_matrix_yale_free(&loaded);
+    sp_matrix_yale_free(&yale);
+  }
+
+  /* regular matrix: several chunks, much smaller than the raw arrays */
+  sp_matrix_init(&lapl,n*n,n*n,5,CRS);
+  for (i = 0; i < n; ++ i)
+    for (j = 0; j < n; ++ j)
+    {
+      k = i*n + j;
+      MTX(&lapl,k,k,4);
+      if (i > 0) MTX(&lapl,k,k-n,-1);
+      if (i < n-1) MTX(&lapl,k,k+n,-1);
+      if (j > 0) MTX(&lapl,k,k-1,-1);
+      if (j < n-1) MTX(&lapl,k,k+1,-1);
+    }
+  sp_matrix_yale_init(&yale,&lapl);
+  sp_matrix_free(&lapl);
+  ASSERT_TRUE(sp_matrix_yale_save_file(&yale,"test_compressed.spz"));
+  ASSERT_TRUE(sp_matrix_yale_save_file(&yale,"test_compressed.spb"));
+  size = file_size("test_compressed.spz");
+  ASSERT_TRUE(size > 0 && size*10 < file_size("test_compressed.spb"));
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_compressed.spz",CRS));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+  sp_matrix_yale_free(&loaded);
+  sp_matrix_yale_free(&yale);
+
+  /* truncated file */
+  buf = spalloc(size);
+  f = fopen("test_compressed.spz","rb");
+  ASSERT_TRUE(f && fread(buf,1,size,f) == (size_t)size);
+  fclose(f);
+  f = fopen("test_compressed.spz","wb");
+  fwrite(buf,1,size-1,f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file(&loaded,"test_compressed.spz",CRS));
+  /* header claims more nonzeros than the file can hold */
+  f = fopen("test_compressed.spz","wb");
+  k = INT_MAX;
+  fwrite(buf,1,40,f);             /* magic, 4 fields, rows and columns */
+  fwrite(&k,sizeof(int),1,f);
+  fwrite(buf+40+sizeof(int),1,size-40-sizeof(int),f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_load_file(&loaded,"test_compressed.spz",CRS));
+  spfree(buf);
+  remove("test_compressed.spz");
+  remove("test_compressed.spb");
+}
+
+static void file_assembler()
+{
+  const int n = 60;             /* grid of n x n bilinear elements */
+  const int nodes = (n+1)*(n+1);
+  sparse_storage_type types[2] = {CRS, CCS};
+  sp_matrix mtx;
+  sp_matrix_yale yale,loaded;
+  sp_matrix_assembler assembler;
+  sp_file_view view;
+  unsigned seed = 17;
+  int e,i,j,k,l,t,runs;
+  int element[4];
+  FILE* f;
+
+  for (t = 0; t < 2; ++ t)
+  {
+    sp_matrix_init(&mtx,nodes,nodes + 3,9,types[t]);
+    ASSERT_TRUE(sp_matrix_assembler_init(&assembler,nodes,nodes + 3,
+                                         types[t],
+                                         1000*sizeof(sp_assembly_element),
+                                         "test_assembler.tmp"));
+    /* elements in the random order, contributions overlap in nodes */
+    for (k = 0; k < n*n; ++ k)
+    {
+      seed = seed*1103515245u + 12345u;
+      e = (seed >> 8) % (n*n);
+      i = e / n;
+      j = e % n;
+      element[0] = i*(n+1) + j;
+      element[1] = element[0] + 1;
+      element[2] = element[0] + n + 1;
+      element[3] = element[2] + 1;
+      for (i = 0; i < 4; ++ i)
+        for (j = 0; j < 4; ++ j)
+        {
+          l = i == j ? 4 : -1;
+          MTX(&mtx,element[i],element[j],l);
+          ASSERT_TRUE(sp_matrix_assembler_add(&assembler,element[i],
+                                              element[j],l));
+        }
+      MTX(&mtx,element[0],nodes + k % 3,1);
+      ASSERT_TRUE(sp_matrix_assembler_add(&assembler,element[0],
+                                          nodes + k % 3,1));
+    }
+    runs = assembler.runs_count;
+    ASSERT_TRUE(runs > 1);
+    ASSERT_TRUE(sp_matrix_assembler_finish(&assembler,"test_assembler.spb"));
+    /* scratch file is removed */
+    ASSERT_FALSE(fopen("test_assembler.tmp","rb"));
+    sp_matrix_yale_init(&yale,&mtx);
+    sp_matrix_free(&mtx);
+    ASSERT_TRUE(sp_matrix_yale_map_file(&loaded,&view,1,
+                                        "test_assembler.spb"));
+    ASSERT_TRUE(loaded.storage_type == types[t]);
+    ASSERT_TRUE(sp_matrix_yale_cmp(&yale,&loaded) == MTX_SAME);
+    sp_file_view_close(&view);
+    sp_matrix_yale_free(&yale);
+  }
+
+  /* nothing assembled */
+  ASSERT_TRUE(sp_matrix_assembler_init(&assembler,3,4,CRS,1 << 20,
+                                       "test_assembler.tmp"));
+  ASSERT_TRUE(sp_matrix_assembler_finish(&assembler,"test_assembler.spb"));
+  ASSERT_TRUE(sp_matrix_yale_load_file(&loaded,"test_assembler.spb",CRS));
+  ASSERT_TRUE(loaded.rows_count == 3 && loaded.cols_count == 4 &&
+              loaded.nonzeros == 0);
+  sp_matrix_yale_free(&loaded);
+  /* unfinished assembly */
+  ASSERT_TRUE(sp_matrix_assembler_init(&assembler,3,3,CRS,16,
+                                       "test_assembler.tmp"));
+  ASSERT_TRUE(sp_matrix_assembler_add(&assembler,1,1,1));
+  ASSERT_TRUE(sp_matrix_assembler_add(&assembler,2,1,1));
+  sp_matrix_assembler_free(&assembler);
+  f = fopen("test_assembler.tmp","rb");
+  ASSERT_FALSE(f);
+  remove("test_assembler.spb");
+}
+
+static void vector_io()
+{
+  const int n = 1000;
+  const int count = 3;
+  double* x = spalloc(n*count*sizeof(double));
+  double* loaded;
+  int* ints = spalloc(n*sizeof(int));
+  int* loaded_ints;
+  const void* mapped;
+  void* data;
+  sp_file_view view;
+  sp_vector_type type;
+  int i,length,cnt,size;
+  int64_t big;
+  FILE* f;
+
+  for (i = 0; i < n*count; ++ i)
+    x[i] = sin(i)*1e3;
+  for (i = 0; i < n; ++ i)
+    ints[i] = i*i - 7;
+
+  /* block of several right-hand sides */
+  ASSERT_TRUE(sp_save_vectors(x,SP_VECTOR_DOUBLE,n,count,1,"test_vector.spv"));
+  ASSERT_TRUE(sp_load_vectors(&data,&type,&length,&cnt,"test_vector.spv"));
+  ASSERT_TRUE(type == SP_VECTOR_DOUBLE && length == n && cnt == count);
+  ASSERT_TRUE(memcmp(data,x,n*count*sizeof(double)) == 0);
+  spfree(data);
+  ASSERT_TRUE(sp_map_vectors(&mapped,&view,&type,&length,&cnt,1,
+                             "test_vector.spv"));
+  ASSERT_TRUE(((size_t)mapped & 63) == 0);
+  ASSERT_TRUE(memcmp(mapped,x,n*count*sizeof(double)) == 0);
+  sp_file_view_close(&view);
+
+  /* corrupted data is detected by the checksum */
+  f = fopen("test_vector.spv","r+b");
+  ASSERT_TRUE(f && fseek(f,100,SEEK_SET) == 0);
+  fputc(0x55,f);
+  fclose(f);
+  ASSERT_FALSE(sp_load_vectors(&data,&type,&length,&cnt,"test_vector.spv"));
+  /* sizes overflowing in the header */
+  f = fopen("test_vector.spv","r+b");
+  ASSERT_TRUE(f && fseek(f,24,SEEK_SET) == 0);
+  for (i = 0; i < 2; ++ i)
+  {
+    big = INT_MAX;
+    fwrite(&big,sizeof(big),1,f);
+  }
+  fclose(f);
+  ASSERT_FALSE(sp_load_vectors(&data,&type,&length,&cnt,"test_vector.spv"));
+
+  /* single vectors via the extension */
+  sp_save_double_vector(x,n,"test_vector.spv");
+  ASSERT_TRUE(sp_load_double_vector(&loaded,&size,"test_vector.spv"));
+  ASSERT_TRUE(size == n && memcmp(loaded,x,n*sizeof(double)) == 0);
+  spfree(loaded);
+  ASSERT_FALSE(sp_load_int_vector(&loaded_ints,&size,"test_vector.spv"));
+  sp_save_int_vector(ints,n,"test_vector.spv");
+  ASSERT_TRUE(sp_load_int_vector(&loaded_ints,&size,"test_vector.spv"));
+  ASSERT_TRUE(size == n && memcmp(loaded_ints,ints,n*sizeof(int)) == 0);
+  spfree(loaded_ints);
+
+  /* text format */
+  sp_save_double_vector(x,n,"test_vector.txt");
+  ASSERT_TRUE(sp_load_double_vector(&loaded,&size,"test_vector.txt"));
+  ASSERT_TRUE(size == n && memcmp(loaded,x,n*sizeof(double)) == 0);
+  spfree(loaded);
+
+  remove("test_vector.spv");
+  remove("test_vector.txt");
+  spfree(ints);
+  spfree(x);
+}
+
+static void chol_persistence()
+{
+  const int n = 12;             /* grid size of the Laplacian */
+  sp_matrix lapl;
+  sp_matrix_yale yale,L,loaded,mapped;
+  sp_chol_symbolic symb,symb_loaded;
+  sp_file_view view;
+  double *b, *x, *expected;
+  int i,j,k;
+  FILE* f;
+
+  sp_matrix_init(&lapl,n*n,n*n,5,CCS);
+  for (i = 0; i < n; ++ i)
+    for (j = 0; j < n; ++ j)
+    {
+      k = i*n + j;
+      MTX(&lapl,k,k,4);
+      if (i > 0) MTX(&lapl,k,k-n,-1);
+      if (i < n-1) MTX(&lapl,k,k+n,-1);
+      if (j > 0) MTX(&lapl,k,k-1,-1);
+      if (j < n-1) MTX(&lapl,k,k+1,-1);
+    }
+  sp_matrix_yale_init(&yale,&lapl);
+  b = spcalloc(n*n,sizeof(double));
+  x = spcalloc(n*n,sizeof(double));
+  expected = spcalloc(n*n,sizeof(double));
+  for (i = 0; i < n*n; ++ i)
+    expected[i] = i % 5 - 2;
+  sp_matrix_yale_mv(&yale,expected,b);
+
+  ASSERT_TRUE(sp_matrix_yale_chol_symbolic(&yale,&symb));
+  ASSERT_TRUE(sp_matrix_yale_chol_numeric(&yale,&symb,&L));
+  ASSERT_TRUE(sp_matrix_yale_symbolic_save(&symb,&yale,"test_chol.sps"));
+  ASSERT_TRUE(sp_matrix_yale_chol_save(&L,&yale,"test_chol.spl"));
+
+  /* symbolic analysis reused for the numeric factorization */
+  ASSERT_TRUE(sp_matrix_yale_symbolic_load(&symb_loaded,&yale,
+                                           "test_chol.sps"));
+  ASSERT_TRUE(symb_loaded.nonzeros == symb.nonzeros);
+  ASSERT_TRUE(!memcmp(symb_loaded.etree,symb.etree,n*n*sizeof(int)));
+  ASSERT_TRUE(!memcmp(symb_loaded.post,symb.post,n*n*sizeof(int)));
+  ASSERT_TRUE(!memcmp(symb_loaded.crs_indicies,symb.crs_indicies,
+                      symb.nonzeros*sizeof(int)));
+  ASSERT_TRUE(sp_matrix_yale_chol_numeric(&yale,&symb_loaded,&loaded));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&L,&loaded) == MTX_SAME);
+  sp_matrix_yale_free(&loaded);
+  sp_matrix_yale_symbolic_free(&symb_loaded);
+
+  /* factor loaded and mapped */
+  ASSERT_TRUE(sp_matrix_yale_chol_load(&loaded,&yale,"test_chol.spl"));
+  ASSERT_TRUE(sp_matrix_yale_cmp(&L,&loaded) == MTX_SAME);
+  sp_matrix_yale_free(&loaded);
+  ASSERT_TRUE(sp_matrix_yale_chol_map(&mapped,&view,&yale,1,
+                                      "test_chol.spl"));
+  ASSERT_TRUE(sp_matrix_yale_chol_numeric_solve(&mapped,b,x));
+  for (i = 0; i < n*n; ++ i)
+    ASSERT_TRUE(fabs(x[i] - expected[i]) < 1e-10);
+  k = (int)((const char*)mapped.indicies - view.data);
+  sp_file_view_close(&view);
+
+  /* damaged factor: row index out of range */
+  f = fopen("test_chol.spl","r+b");
+  ASSERT_TRUE(f && fseek(f,k,SEEK_SET) == 0);
+  i = n*n;
+  fwrite(&i,sizeof(int),1,f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_chol_load(&loaded,&yale,"test_chol.spl"));
+  ASSERT_FALSE(sp_matrix_yale_chol_map(&mapped,&view,&yale,1,
+                                       "test_chol.spl"));
+  ASSERT_TRUE(sp_matrix_yale_chol_save(&L,&yale,"test_chol.spl"));
+
+  /* damaged symbolic analysis: postorder is not a permutation */
+  ASSERT_TRUE(sp_file_view_open(&view,"test_chol.sps"));
+  for (k = 0; k + n*n*sizeof(int) <= view.size; k += 64)
+    if (!memcmp(view.data + k,symb.post,n*n*sizeof(int)))
+      break;
+  ASSERT_TRUE(k + n*n*sizeof(int) <= view.size);
+  sp_file_view_close(&view);
+  f = fopen("test_chol.sps","r+b");
+  ASSERT_TRUE(f && fseek(f,k + sizeof(int),SEEK_SET) == 0);
+  fwrite(symb.post,sizeof(int),1,f);
+  fclose(f);
+  ASSERT_FALSE(sp_matrix_yale_symbolic_load(&symb_loaded,&yale,
+                                            "test_chol.sps"));
+  ASSERT_TRUE(sp_matrix_yale_symbolic_save(&symb,&yale,"test_chol.sps"));
+
+  /* another pattern is detected, values don't matter */
+  ASSERT_FALSE(sp_matrix_yale_chol_load(&loaded,&L,"test_chol.spl"));
+  ASSERT_FALSE(sp_matrix_yale_symbolic_load(&symb_loaded,&L,
+                                            "test_chol.sps"));
+  ASSERT_FALSE(sp_matrix_yale_chol_load(&loaded,&yale,"test_chol.sps"));
+  yale.values[0] *= 2;
+  ASSERT_TRUE(sp_matrix_yale_chol_load(&loaded,&yale,"test_chol.spl"));
+  sp_matrix_yale_free(&loaded);
+  remove("test_chol.sps");
+  remove("test_chol.spl");
+
+  spfree(b);
+  spfree(x);
+  spfree(expected);
+  sp_matrix_yale_free(&L);
+  sp_matrix_yale_symbolic_free(&symb);
+  sp_matrix_yale_free(&yale);
+  sp_matrix_free(&lapl);
+}
+
 static void yale_properties()
 {
   /* test sparse matrix properties: symmetricity,
@@ -1704,11 +3784,26 @@ int main(int argc, const char *argv[])
   SP_ADD_TEST(tfqmr_solver);  
   SP_ADD_TEST(ilu_and_skyline);
   SP_ADD_TEST(pcg_ilu_solver);
+  SP_ADD_TEST(ilu_level_schedule);
+  SP_ADD_TEST(ilu_fixed_point);
   SP_ADD_TEST(load_from_files);
   SP_ADD_TEST(stack_container);
   SP_ADD_TEST(queue_container);
   SP_ADD_TEST(tree_search);
   SP_ADD_TEST(yale_transpose_convert);
+  SP_ADD_TEST(yale_mult);
+  SP_ADD_TEST(yale_add);
+  SP_ADD_TEST(yale_mm);
+  SP_ADD_TEST(mm_fast_loader);
+  SP_ADD_TEST(parallel_loader);
+  SP_ADD_TEST(hb_fixed_width);
+  SP_ADD_TEST(matrix_vectors);
+  SP_ADD_TEST(fast_writer);
+  SP_ADD_TEST(binary_format);
+  SP_ADD_TEST(chol_persistence);
+  SP_ADD_TEST(compressed_format);
+  SP_ADD_TEST(vector_io);
+  SP_ADD_TEST(file_assembler);
   SP_ADD_TEST(yale_properties);
   SP_ADD_TEST(big_etree_postorder);
   /* SP_ADD_TEST(lower_solve); */
@@ -1720,6 +3815,15 @@ int main(int argc, const char *argv[])
   SP_ADD_SUITE_TEST(suite1,etree_rowcolcounts);
   /* SP_ADD_SUITE_TEST(suite1,etree_rowcount); */
   SP_ADD_TEST(cholesky);
+  SP_ADD_TEST(incomplete_cholesky);
+  SP_ADD_TEST(incomplete_lu);
+  SP_ADD_TEST(bicgstab_solvers);
+  SP_ADD_TEST(gmres_solvers);
+  SP_ADD_TEST(precond_interface);
+  SP_ADD_TEST(amg_preconditioner);
+  SP_ADD_TEST(simple_preconditioners);
+  SP_ADD_TEST(eigenvalue_estimates);
+  SP_ADD_TEST(block_cg_solvers);
   SP_ADD_TEST(big_matrix_from_file1);
   SP_ADD_TEST(big_matrix_from_file2);
   SP_ADD_TEST(big_matrix_from_file3);